@@ -0,0 +1,165 @@
+// compares walking all view actions of the flat document storage with the
+// previous layout of one heap allocation per action and string
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "../data/document.h"
+#include "synthetic_document.h"
+
+// document::view_actions before the structure of arrays storage
+namespace pointer_layout {
+    struct program_action {
+        std::vector<std::pair<std::string, uniform_value>> uniforms;
+
+        std::string vertex_shader, fragment_shader;
+        std::vector<std::pair<std::string, unsigned>> in;
+        std::vector<std::pair<std::string, unsigned>> out;
+        unsigned viewport_width, viewport_height;
+        unsigned vertex_count;
+    };
+
+    struct blit_action {
+        unsigned source_texture;
+        unsigned destination_texture;
+    };
+
+    typedef std::variant<
+        std::unique_ptr<program_action>, std::unique_ptr<blit_action>
+    > action;
+}
+
+static std::vector<pointer_layout::action> to_pointer_layout(
+    const document& document
+) {
+    std::vector<pointer_layout::action> actions;
+    auto& programs = document.programs;
+    for (auto action : document.view_actions) {
+        // the old layout only had programs, anything else counts as a blit
+        if (action.type != action_type::program) {
+            actions.push_back(std::make_unique<pointer_layout::blit_action>());
+            continue;
+        }
+        auto program = std::make_unique<pointer_layout::program_action>();
+        auto i = action.index;
+        program->vertex_shader = document.strings[programs.vertex_shaders[i]];
+        program->fragment_shader =
+            document.strings[programs.fragment_shaders[i]];
+        program->vertex_count = programs.vertex_counts[i];
+        auto uniforms = programs.uniforms[i];
+        for (auto j = uniforms.first; j < uniforms.first + uniforms.count; j++)
+            program->uniforms.push_back({
+                std::string(document.strings[document.uniforms.names[j]]),
+                document.uniforms.get(j)
+            });
+        actions.push_back(std::move(program));
+    }
+    return actions;
+}
+
+// touches what recording commands and uploading uniforms needs
+struct pointer_layout_functor {
+    double& sum;
+
+    void operator() (
+        const std::unique_ptr<pointer_layout::program_action>& action
+    ) {
+        sum += action->vertex_count + action->vertex_shader.size();
+        for (const auto& uniform : action->uniforms) {
+            auto span = get_data_pointer(uniform.second);
+            auto values = static_cast<const float*>(span.first);
+            for (auto i = 0u; i < span.second / 4; i++)
+                sum += values[i];
+        }
+    }
+    void operator() (const std::unique_ptr<pointer_layout::blit_action>&) {
+        sum += 1;
+    }
+};
+
+struct flat_visitor {
+    const document& document;
+    double& sum;
+
+    void program(uint32_t index) {
+        auto& programs = document.programs;
+        sum +=
+            programs.vertex_counts[index] +
+            document.strings[programs.vertex_shaders[index]].size();
+        auto uniforms = programs.uniforms[index];
+        if (uniforms.count == 0)
+            return;
+        auto& table = document.uniforms;
+        auto last = uniforms.first + uniforms.count - 1;
+        auto begin = table.data(uniforms.first);
+        auto end = table.data(last) + table.data_size(last) / 4;
+        for (auto value = begin; value != end; value++)
+            sum += *value;
+    }
+    void blit(uint32_t) {
+        sum += 1;
+    }
+    void compute(uint32_t) {
+        sum += 1;
+    }
+};
+
+template<typename function_type>
+static double nanoseconds_per_action(
+    size_t action_count, unsigned repetitions, function_type function
+) {
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = 0u; i < repetitions; i++)
+        function();
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start
+    ).count() / (double(action_count) * repetitions);
+}
+
+int main(int argc, char** argv) {
+    std::vector<unsigned> sizes = {1000, 10000, 100000};
+    if (argc > 1) {
+        sizes.clear();
+        for (auto i = 1; i < argc; i++)
+            sizes.push_back(std::stoul(argv[i]));
+    }
+
+    printf("actions  pointers ns/action  flat ns/action\n");
+    for (auto size : sizes) {
+        auto path =
+            std::filesystem::temp_directory_path() /
+            ("material_traversal_" + std::to_string(size) + ".json");
+        write_document(path, {
+            .action_count = size,
+            .uniform_count = 2,
+            .scalar_uniform_count = 1,
+        });
+        auto document = from_file(path.string().c_str());
+        std::filesystem::remove(path);
+        auto actions = to_pointer_layout(document);
+
+        // the sums keep the loops from being optimized away
+        double pointer_sum = 0, flat_sum = 0;
+        auto repetitions = std::max(1u, 10000000u / size);
+        auto pointer_time = nanoseconds_per_action(size, repetitions, [&]() {
+            for (const auto& action : actions)
+                std::visit(pointer_layout_functor{pointer_sum}, action);
+        });
+        auto flat_time = nanoseconds_per_action(size, repetitions, [&]() {
+            visit_view_actions(document, flat_visitor{document, flat_sum});
+        });
+        if (pointer_sum != flat_sum) {
+            fprintf(stderr, "traversals disagree\n");
+            return 1;
+        }
+
+        printf("%7u  %18.2f  %14.2f\n", size, pointer_time, flat_time);
+    }
+    return 0;
+}
@@ -0,0 +1,380 @@
+// compares load time and peak memory of the SAX, DOM and binary document
+// loaders on synthetic documents of growing size
+//
+// every load runs in its own process, so that peak RSS isn't shared
+// between loaders, the documents of all loaders and of a round trip
+// through to_json_file are compared first
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#define popen _popen
+#define pclose _pclose
+#else
+#include <sys/resource.h>
+#endif
+
+#include "../data/document.h"
+#include "../data/binary_document.h"
+#include "synthetic_document.h"
+
+// in KiB
+static long peak_resident_set_size() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return long(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#endif
+}
+
+static double milliseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+}
+
+// the tables of document with names instead of ids and indices, and the
+// members of JSON objects sorted, since the loaders intern and add them in
+// different orders, floats are written exactly
+static std::string describe(const document& document) {
+    auto& strings = document.strings;
+    auto name = [&](string_id id) {
+        return id == -1u ? std::string("-") : std::string(strings[id]);
+    };
+    auto texture_name = [&](unsigned texture) {
+        if (texture == built_in_window)
+            return std::string("built_in_window");
+        if (texture >= document.textures.size())
+            return std::string("-");
+        return name(document.textures.names[texture]);
+    };
+    auto floats = [](const float* values, size_t count) {
+        std::ostringstream stream;
+        stream << std::hexfloat;
+        for (size_t i = 0; i < count; i++)
+            stream << " " << values[i];
+        return stream.str();
+    };
+    auto sorted = [](std::vector<std::string> lines) {
+        std::sort(lines.begin(), lines.end());
+        std::string joined;
+        for (auto& line : lines)
+            joined += line + "\n";
+        return joined;
+    };
+
+    auto& uniforms = document.uniforms;
+    auto describe_uniforms = [&](range range) {
+        std::vector<std::string> lines;
+        for (auto i = range.first; i < range.first + range.count; i++)
+            lines.push_back(
+                "  uniform " + name(uniforms.names[i]) + " " +
+                std::to_string(static_cast<unsigned>(uniforms.types[i])) +
+                floats(uniforms.data(i), uniforms.data_size(i) / 4)
+            );
+        return sorted(lines);
+    };
+    auto& bindings = document.bindings;
+    auto& meshes = document.meshes;
+    auto describe_bindings = [&](const char* kind, range range) {
+        std::vector<std::string> lines;
+        for (auto i = range.first; i < range.first + range.count; i++) {
+            auto buffer = bindings.buffers[i];
+            auto attribute = bindings.attributes[i];
+            lines.push_back(
+                std::string("  ") + kind + " " + name(bindings.names[i]) +
+                " " + name(bindings.values[i]) + " texture " +
+                texture_name(bindings.textures[i]) + " buffer " + (
+                    buffer == no_buffer ?
+                    "-" : name(document.buffers.names[buffer])
+                ) + " attribute " + (
+                    attribute == no_attribute ?
+                    "-" : name(meshes.attribute_names[attribute])
+                )
+            );
+        }
+        return sorted(lines);
+    };
+
+    std::vector<std::string> textures, buffers, mesh_lines;
+    for (size_t i = 0; i < document.textures.size(); i++) {
+        auto definition = document.textures.definitions[i];
+        textures.push_back(
+            "texture " + texture_name(unsigned(i)) + " " +
+            std::to_string(definition.width) + " " +
+            std::to_string(definition.height) + " " +
+            std::to_string(definition.depth) + " " +
+            std::to_string(static_cast<unsigned>(definition.format))
+        );
+    }
+    for (size_t i = 0; i < document.buffers.size(); i++)
+        buffers.push_back(
+            "buffer " + name(document.buffers.names[i]) + " " +
+            std::to_string(document.buffers.sizes[i])
+        );
+    for (size_t i = 0; i < meshes.size(); i++) {
+        auto attributes = meshes.attributes[i];
+        std::vector<std::string> lines;
+        for (
+            auto j = attributes.first;
+            j < attributes.first + attributes.count;
+            j++
+        )
+            lines.push_back(
+                "  attribute " + name(meshes.attribute_names[j]) + " " +
+                std::to_string(
+                    static_cast<unsigned>(meshes.attribute_sources[j])
+                ) + " " +
+                std::to_string(
+                    static_cast<unsigned>(meshes.attribute_formats[j])
+                ) + " " + name(meshes.names[meshes.attribute_meshes[j]])
+            );
+        mesh_lines.push_back(
+            "mesh " + name(meshes.names[i]) + " " +
+            name(meshes.file_names[i]) + "\n" + sorted(lines)
+        );
+    }
+
+    std::ostringstream stream;
+    stream <<
+        sorted(textures) << sorted(buffers) << sorted(mesh_lines) <<
+        "display " << texture_name(document.display_texture) << "\n";
+
+    auto& animations = document.animations;
+    auto& parameters = animations.parameters;
+    for (size_t i = 0; i < animations.size(); i++) {
+        auto scales = animations.scales[i], offsets = animations.offsets[i];
+        auto keys = animations.keys[i], values = animations.key_values[i];
+        stream <<
+            "animate " << name(animations.uniform_names[i]) << " " <<
+            animations.sources[i] << " " <<
+            static_cast<unsigned>(animations.functions[i]) <<
+            floats(&animations.frequencies[i], 1) <<
+            floats(&animations.phases[i], 1) << "\n  scales" <<
+            floats(parameters.data() + scales.first, scales.count) <<
+            "\n  offsets" <<
+            floats(parameters.data() + offsets.first, offsets.count) <<
+            "\n  keys" <<
+            floats(animations.key_times.data() + keys.first, keys.count) <<
+            "\n  key values" <<
+            floats(parameters.data() + values.first, values.count) << "\n";
+    }
+
+    auto& programs = document.programs;
+    auto& blits = document.blits;
+    auto& computes = document.computes;
+    for (auto action : document.view_actions) {
+        auto i = action.index;
+        switch (action.type) {
+        case action_type::program: {
+            auto mesh = programs.meshes[i];
+            stream <<
+                "program " << name(programs.vertex_shaders[i]) << " " <<
+                name(programs.fragment_shaders[i]) << " " <<
+                programs.viewport_widths[i] << " " <<
+                programs.viewport_heights[i] << " " <<
+                programs.vertex_counts[i] << " " <<
+                (mesh == no_mesh ? "-" : name(meshes.names[mesh])) << "\n" <<
+                describe_uniforms(programs.uniforms[i]) <<
+                describe_bindings("in", programs.ins[i]) <<
+                describe_bindings("out", programs.outs[i]);
+            break;
+        }
+        case action_type::blit:
+            stream <<
+                "blit " << name(blits.source_names[i]) << " " <<
+                name(blits.destination_names[i]) << " " <<
+                texture_name(blits.source_textures[i]) << " " <<
+                texture_name(blits.destination_textures[i]) << "\n";
+            break;
+        case action_type::compute:
+            stream <<
+                "compute " << name(computes.shaders[i]) << " " <<
+                computes.widths[i] << " " << computes.heights[i] << " " <<
+                computes.depths[i] << " " << name(computes.size_names[i]) <<
+                " " << texture_name(computes.size_textures[i]) << " " <<
+                unsigned(computes.async[i]) << "\n" <<
+                describe_uniforms(computes.uniforms[i]) <<
+                describe_bindings("in", computes.ins[i]) <<
+                describe_bindings("out", computes.outs[i]);
+            break;
+        }
+    }
+    return stream.str();
+}
+
+// the line of expected where actual first differs, empty if they are equal
+static std::string first_difference(
+    const std::string& expected, const std::string& actual
+) {
+    auto difference = std::mismatch(
+        expected.begin(), expected.end(), actual.begin(), actual.end()
+    );
+    if (
+        difference.first == expected.end() &&
+        difference.second == actual.end()
+    )
+        return "";
+    auto line_begin = expected.rfind(
+        '\n', size_t(difference.first - expected.begin())
+    );
+    line_begin = line_begin == std::string::npos ? 0 : line_begin + 1;
+    return expected.substr(
+        line_begin, expected.find('\n', line_begin) - line_begin
+    );
+}
+
+// child process, prints milliseconds, peak RSS before and after loading,
+// the action count and the milliseconds of copying binary documents,
+// from_file detects binary documents by itself
+static int load(const std::string& loader, const char* file_name) {
+    auto initial_peak = peak_resident_set_size();
+    double milliseconds;
+    size_t action_count;
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto document = loader == "dom" ?
+            from_file_dom(file_name) : from_file(file_name);
+        milliseconds = milliseconds_since(start);
+        action_count = document.view_actions.size();
+    }
+    auto peak = peak_resident_set_size();
+
+    // the sections are copied into the tables and the strings interned,
+    // timed again on a mapping whose pages are already resident, the rest
+    // of the load time is mapping and page faults
+    double copy_milliseconds = 0;
+    if (loader == "binary") {
+        mapped_file file(file_name);
+        auto pages = static_cast<const volatile std::byte*>(file.data());
+        for (size_t i = 0; i < file.size(); i += 4096)
+            (void)pages[i];
+        auto start = std::chrono::steady_clock::now();
+        auto document = from_binary(file);
+        copy_milliseconds = milliseconds_since(start);
+    }
+
+    std::cout <<
+        milliseconds << " " << initial_peak << " " << peak << " " <<
+        action_count << " " << copy_milliseconds << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 4 && std::string(argv[1]) == "--load")
+        return load(argv[2], argv[3]);
+
+    std::vector<unsigned> sizes = {1000, 10000, 100000};
+    if (argc > 1) {
+        sizes.clear();
+        for (auto i = 1; i < argc; i++)
+            sizes.push_back(std::stoul(argv[i]));
+    }
+
+    auto directory = std::filesystem::temp_directory_path();
+    std::cout <<
+        "actions    file MiB  loader  load ms  copy ms  peak KiB  "
+        "loader peak KiB" <<
+        std::endl;
+    for (auto size : sizes) {
+        auto name = "material_document_" + std::to_string(size);
+        auto path = directory / (name + ".json");
+        auto binary_path = directory / (name + ".bin");
+        write_document(path, {
+            .action_count = size,
+            .uniform_count = 2,
+            .scalar_uniform_count = 1,
+            .animated_count = 2,
+            .mesh_count = 4,
+        });
+        auto round_trip_path = directory / (name + "_round_trip.json");
+        {
+            auto sax = from_file(path.string().c_str());
+            to_binary_file(sax, binary_path.string().c_str());
+            to_json_file(
+                from_file_dom(path.string().c_str()),
+                round_trip_path.string().c_str()
+            );
+            auto expected = describe(sax);
+            std::pair<const char*, std::filesystem::path> loads[] = {
+                {"dom", path}, {"binary", binary_path},
+                {"round trip", round_trip_path},
+            };
+            for (auto& [loader, loader_path] : loads) {
+                auto difference = first_difference(
+                    expected, describe(
+                        std::string(loader) == "dom" ?
+                        from_file_dom(loader_path.string().c_str()) :
+                        from_file(loader_path.string().c_str())
+                    )
+                );
+                if (!difference.empty()) {
+                    std::cerr <<
+                        "sax and " << loader << " documents differ at: " <<
+                        difference << "\n";
+                    return 1;
+                }
+            }
+        }
+        std::filesystem::remove(round_trip_path);
+
+        for (auto loader : {"sax", "dom", "binary"}) {
+            auto& loader_path =
+                std::string(loader) == "binary" ? binary_path : path;
+            auto file_size = std::filesystem::file_size(loader_path);
+            auto command =
+                "\"" + std::string(argv[0]) + "\" --load " + loader +
+                " \"" + loader_path.string() + "\"";
+#ifdef _WIN32
+            // cmd.exe /c strips the first and last quote of commands with
+            // more than two
+            command = "\"" + command + "\"";
+#endif
+            double milliseconds = 0, copy_milliseconds = 0;
+            long initial_peak = 0, peak = 0;
+            unsigned action_count = 0;
+            auto pipe = popen(command.c_str(), "r");
+            if (pipe != nullptr) {
+                if (fscanf(
+                    pipe, "%lf %ld %ld %u %lf",
+                    &milliseconds, &initial_peak, &peak, &action_count,
+                    &copy_milliseconds
+                ) != 5)
+                    action_count = 0;
+                pclose(pipe);
+            }
+            if (action_count != size) {
+                std::cerr << "loading with " << loader << " failed\n";
+                return 1;
+            }
+
+            char copy_column[16] = "-";
+            if (std::string(loader) == "binary")
+                snprintf(
+                    copy_column, sizeof(copy_column), "%.1f",
+                    copy_milliseconds
+                );
+            printf(
+                "%7u  %10.2f  %6s  %7.1f  %7s  %8ld  %15ld\n",
+                size, file_size / (1024.0 * 1024.0), loader,
+                milliseconds, copy_column, peak, peak - initial_peak
+            );
+        }
+        std::filesystem::remove(path);
+        std::filesystem::remove(binary_path);
+    }
+    return 0;
+}
@@ -0,0 +1,396 @@
+// times the stages of the editor on a synthetic document: loading it,
+// animating its uniforms, compiling and reflecting a shader, building the
+// render document and rendering headless frames, results are printed as
+// JSON tagged with the git revision the benchmark was configured at
+//
+// for numbers that compare between machines run it on a software Vulkan
+// ICD like lavapipe or SwiftShader, by pointing VK_ICD_FILENAMES at its
+// manifest, CPU devices are preferred over all others
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <json/json.hpp>
+#include <vulkan/vulkan.h>
+
+#include "../data/animation.h"
+#include "../data/document.h"
+#include "../rendering/document.h"
+#include "../rendering/mesh.h"
+#include "../rendering/offscreen.h"
+#include "../rendering/renderer.h"
+#include "../rendering/shader.h"
+#include "synthetic_document.h"
+
+#ifndef EDITOR_GIT_REVISION
+#define EDITOR_GIT_REVISION "unknown"
+#endif
+
+// milliseconds of every repetition
+template<typename function_type>
+static std::vector<double> time_repetitions(
+    unsigned repetitions, function_type function
+) {
+    std::vector<double> milliseconds;
+    for (auto i = 0u; i < repetitions; i++) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        milliseconds.push_back(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start
+        ).count());
+    }
+    return milliseconds;
+}
+
+static nlohmann::json summary(std::vector<double> milliseconds) {
+    if (milliseconds.empty())
+        return {{"count", 0}};
+    std::sort(milliseconds.begin(), milliseconds.end());
+    auto count = milliseconds.size();
+    return {
+        {"count", count},
+        {"min_ms", milliseconds.front()},
+        {"median_ms", milliseconds[count / 2]},
+        {"mean_ms", std::accumulate(
+            milliseconds.begin(), milliseconds.end(), 0.0
+        ) / count},
+        {"p99_ms", milliseconds[std::min(count - 1, count * 99 / 100)]},
+        {"max_ms", milliseconds.back()},
+    };
+}
+
+static const char* device_type_name(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "cpu";
+    default:
+        return "other";
+    }
+}
+
+int main(int argc, char** argv) {
+    synthetic_document options;
+    unsigned repetitions = 10;
+    // frames before warm_up_frames aren't timed
+    unsigned frame_count = 200, warm_up_frames = 20;
+    unsigned width = 1280, height = 720;
+    const char* output_file_name = nullptr;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+        if (argument == "--actions" && has_value) {
+            options.action_count = std::stoul(argv[++i]);
+        } else if (argument == "--uniforms" && has_value) {
+            options.uniform_count = std::stoul(argv[++i]);
+        } else if (argument == "--scalars" && has_value) {
+            options.scalar_uniform_count = std::stoul(argv[++i]);
+        } else if (argument == "--textures" && has_value) {
+            options.texture_count = std::stoul(argv[++i]);
+        } else if (argument == "--shaders" && has_value) {
+            options.shader_count = std::stoul(argv[++i]);
+        } else if (argument == "--animated" && has_value) {
+            options.animated_count = std::stoul(argv[++i]);
+        } else if (argument == "--meshes" && has_value) {
+            options.mesh_count = std::stoul(argv[++i]);
+        } else if (argument == "--repetitions" && has_value) {
+            repetitions = std::stoul(argv[++i]);
+        } else if (argument == "--frames" && has_value) {
+            frame_count = std::stoul(argv[++i]);
+        } else if (argument == "--width" && has_value) {
+            width = std::stoul(argv[++i]);
+        } else if (argument == "--height" && has_value) {
+            height = std::stoul(argv[++i]);
+        } else if (argument == "--output" && has_value) {
+            output_file_name = argv[++i];
+        } else {
+            std::cerr <<
+                "usage: " << argv[0] << " [--actions n] [--uniforms n] "
+                "[--scalars n] [--textures n] [--shaders n] [--animated n] "
+                "[--meshes n] [--repetitions n] "
+                "[--frames n] [--width n] [--height n] "
+                "[--output file.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    // shaders are looked up next to the document, the inputs get a
+    // directory of their own
+    auto working_directory = std::filesystem::current_path();
+    auto directory =
+        std::filesystem::temp_directory_path() / "material_editor_bench";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    std::filesystem::current_path(directory);
+    write_shaders(".", options);
+    write_document("document.json", options);
+
+    nlohmann::json results = {
+        {"revision", EDITOR_GIT_REVISION},
+        {"document", {
+            {"actions", options.action_count},
+            {"uniforms", options.uniform_count},
+            {"scalars", options.scalar_uniform_count},
+            {"textures", options.texture_count},
+            {"shaders", options.shader_count},
+            {"animated", options.animated_count},
+            {"meshes", options.mesh_count},
+        }},
+        {"frames", {
+            {"width", width}, {"height", height},
+            {"warm_up", warm_up_frames},
+        }},
+    };
+    auto& stages = results["stages"];
+
+    stages["from_file"] = summary(time_repetitions(repetitions, [] {
+        from_file("document.json");
+    }));
+    auto document = from_file("document.json");
+
+    // one evaluation per frame, at 60 frames per second
+    uniform_animator animator(document);
+    auto animation_frame = 0u;
+    auto animate = [&] {
+        animator.evaluate(
+            {
+                .window_width = static_cast<float>(width),
+                .window_height = static_cast<float>(height),
+                .view_matrix = glm::mat4(1),
+                .projection_matrix = glm::mat4(1),
+                .elapsed_time = animation_frame++ / 60.f,
+            },
+            document.uniforms
+        );
+    };
+    stages["animate_uniforms"] = summary(
+        time_repetitions(warm_up_frames + frame_count, animate)
+    );
+    results["document"]["animated_components"] = animator.size();
+
+    // without layers, extensions or a surface
+    VkApplicationInfo application_info = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "material_editor_bench",
+        .apiVersion = VK_API_VERSION_1_0,
+    };
+    VkInstanceCreateInfo instance_info = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &application_info,
+    };
+    VkInstance instance;
+    check(vkCreateInstance(&instance_info, nullptr, &instance));
+
+    uint32_t device_count = 0;
+    vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
+    if (device_count == 0)
+        throw std::runtime_error("no Vulkan device found");
+    std::vector<VkPhysicalDevice> devices(device_count);
+    vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
+    VkPhysicalDevice physical_device = devices[0];
+    VkPhysicalDeviceProperties properties;
+    for (auto candidate : devices) {
+        vkGetPhysicalDeviceProperties(candidate, &properties);
+        if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU) {
+            physical_device = candidate;
+            break;
+        }
+    }
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    results["device"] = {
+        {"name", properties.deviceName},
+        {"type", device_type_name(properties.deviceType)},
+        {"driver_version", properties.driverVersion},
+        {"api_version", properties.apiVersion},
+    };
+
+    // everything runs on one graphics queue, so results don't depend on
+    // the families the device has
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device, &family_count, nullptr
+    );
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physical_device, &family_count, families.data()
+    );
+    uint32_t queue_family = -1u;
+    for (auto i = 0u; i < family_count && queue_family == -1u; i++)
+        if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            queue_family = i;
+    if (queue_family == -1u)
+        throw std::runtime_error("no graphics queue found");
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = queue_family,
+        .queueCount = 1,
+        .pQueuePriorities = &priority,
+    };
+    VkPhysicalDeviceFeatures features{};
+    VkDeviceCreateInfo device_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queue_info,
+        .pEnabledFeatures = &features,
+    };
+    VkDevice device;
+    check(vkCreateDevice(physical_device, &device_info, nullptr, &device));
+    current_device = &device;
+    VkQueue queue;
+    vkGetDeviceQueue(device, queue_family, 0, &queue);
+
+    {
+        // without shader or pipeline caches, every stage starts cold
+        renderer renderer;
+        renderer.physical_device = physical_device;
+        renderer.physical_device_properties = properties;
+        renderer.graphics_queue_family = queue_family;
+        renderer.present_queue_family = queue_family;
+        renderer.compute_queue_family = queue_family;
+        renderer.transfer_queue_family = queue_family;
+        vkGetPhysicalDeviceMemoryProperties(
+            physical_device, &renderer.physical_device_memory_properties
+        );
+        renderer.allocator = std::make_unique<device_allocator>(
+            device, renderer.physical_device_memory_properties
+        );
+
+        if (!document.programs.fragment_shaders.empty()) {
+            auto shader = referenced_file_name(
+                document, document.programs.fragment_shaders[0]
+            );
+            stages["reflected_shader_module"] = summary(time_repetitions(
+                repetitions, [&] {
+                    reflected_shader_module module(
+                        renderer, device, shader.c_str(),
+                        shaderc_glsl_fragment_shader
+                    );
+                }
+            ));
+        }
+
+        auto format = VK_FORMAT_R8G8B8A8_UNORM;
+        auto layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        stages["render_document"] = summary(time_repetitions(
+            repetitions, [&] {
+                render_document render_document(
+                    document, renderer, format, layout
+                );
+            }
+        ));
+        render_document render_document(document, renderer, format, layout);
+
+        // per number of frames in flight, frame times are from one
+        // finished frame to the next and latencies from submitting a frame
+        // until its fence was seen signalled, every frame in flight has an
+        // image of its own
+        render_meshes meshes;
+        auto& frame_stages = stages["frames"];
+        for (
+            auto in_flight = 1u; in_flight <= max_frames_in_flight;
+            in_flight++
+        ) {
+            std::vector<offscreen_target> outputs;
+            outputs.reserve(in_flight);
+            for (auto i = 0u; i < in_flight; i++)
+                outputs.emplace_back(renderer, format, width, height);
+            uniform_ring uniforms(
+                render_document, document.uniforms, renderer, in_flight
+            );
+            render_targets targets(
+                render_document.graph, renderer, width, height, queue
+            );
+            std::vector<render_image> images;
+            images.reserve(in_flight);
+            for (auto i = 0u; i < in_flight; i++)
+                images.emplace_back(
+                    render_document, targets, meshes, uniforms, i,
+                    outputs[i].image.get(), format, width, height, renderer
+                );
+            std::vector<frame_resources> frames(in_flight);
+
+            std::vector<double> frame_times, latencies;
+            std::vector<std::chrono::steady_clock::time_point> submitted(
+                in_flight
+            );
+            auto last_finished = std::chrono::steady_clock::now();
+            // waits for frame, which was submitted before
+            auto finish = [&](unsigned frame) {
+                auto slot = frame % in_flight;
+                VkFence fence = frames[slot].fence.get();
+                check(vkWaitForFences(device, 1, &fence, VK_TRUE, -1ul));
+                auto finished = std::chrono::steady_clock::now();
+                auto milliseconds = [](auto duration) {
+                    return std::chrono::duration<double, std::milli>(
+                        duration
+                    ).count();
+                };
+                if (frame >= warm_up_frames) {
+                    frame_times.push_back(
+                        milliseconds(finished - last_finished)
+                    );
+                    latencies.push_back(
+                        milliseconds(finished - submitted[slot])
+                    );
+                }
+                last_finished = finished;
+            };
+            auto total = warm_up_frames + frame_count;
+            for (auto frame = 0u; frame < total; frame++) {
+                auto slot = frame % in_flight;
+                if (frame >= in_flight)
+                    finish(frame - in_flight);
+                VkFence fence = frames[slot].fence.get();
+                check(vkResetFences(device, 1, &fence));
+                animate();
+                uniforms.upload(render_document, document.uniforms, slot);
+                VkSemaphore last_frame = frame == 0 ?
+                    VK_NULL_HANDLE :
+                    images[(frame - 1) % in_flight]
+                        .graphics_finished_semaphore.get();
+                submitted[slot] = std::chrono::steady_clock::now();
+                images[slot].submit(
+                    queue, queue, frame % 2, VK_NULL_HANDLE, 0, last_frame,
+                    VK_NULL_HANDLE, fence
+                );
+            }
+            auto first_unfinished = total - std::min(total, in_flight);
+            for (auto frame = first_unfinished; frame < total; frame++)
+                finish(frame);
+            frame_stages.push_back({
+                {"frames_in_flight", in_flight},
+                {"frame", summary(std::move(frame_times))},
+                {"latency", summary(std::move(latencies))},
+            });
+        }
+        vkDeviceWaitIdle(device);
+    }
+    vkDestroyDevice(device, nullptr);
+    vkDestroyInstance(instance, nullptr);
+
+    std::filesystem::current_path(working_directory);
+    std::filesystem::remove_all(directory);
+    if (output_file_name != nullptr) {
+        std::ofstream output(output_file_name);
+        output << results.dump(4) << std::endl;
+    } else {
+        std::cout << results.dump(4) << std::endl;
+    }
+    return 0;
+}
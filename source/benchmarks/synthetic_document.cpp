@@ -0,0 +1,162 @@
+#include "synthetic_document.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+static std::string vertex_shader_name(unsigned shader) {
+    return "synthetic_vertex_shader_" + std::to_string(shader) + ".glsl";
+}
+
+static std::string fragment_shader_name(unsigned shader) {
+    return "synthetic_fragment_shader_" + std::to_string(shader) + ".glsl";
+}
+
+static const char* mesh_file_name = "synthetic_mesh.obj";
+
+void write_document(
+    const std::filesystem::path& path, const synthetic_document& options
+) {
+    auto blits = options.texture_count >= 2;
+    std::ofstream stream(path);
+    stream << "{\n    \"meshes\": {";
+    for (auto i = 0u; i < options.mesh_count; i++)
+        stream <<
+            (i > 0 ? "," : "") <<
+            "\n        \"mesh_" << i << "\": {\"file_name\": \"" <<
+                mesh_file_name << "\", "
+            "\"faces_vertices_position\": {\"name\": \"positions_" << i <<
+                "\", \"format\": \"A2B10G10R10_SNORM_PACK32\"}, "
+            "\"faces_vertices_normal\": {\"name\": \"normals_" << i <<
+                "\", \"format\": \"R8G8B8_SNORM\"}}";
+    stream << "\n    },\n    \"textures\": {";
+    for (auto i = 0u; blits && i < options.texture_count; i++)
+        stream <<
+            (i > 0 ? "," : "") <<
+            "\n        \"texture_" << i << "\": {\"size\": "
+            "[\"built_in_window_width\", \"built_in_window_height\"]}";
+    stream << "\n    },\n    \"frame_actions\": [";
+    auto animated = std::min(options.animated_count, options.uniform_count);
+    for (auto i = 0u; i < animated; i++) {
+        stream <<
+            (i > 0 ? "," : "") <<
+            "\n        {\"type\": \"animate\", \"uniform\": \"value_" << i <<
+            "\", ";
+        if (i % 2 == 0)
+            stream <<
+                "\"function\": \"sine\", \"frequency\": " << i + 1 <<
+                ", \"scale\": 0.5, \"offset\": 0.5}";
+        else
+            stream <<
+                "\"key_times\": [0, 0.5, 2], "
+                "\"key_values\": [0, 0, 0, 1, 1, 0.5, 0.25, 1, 0, 0, 0, 1]}";
+    }
+    stream <<
+        "\n    ],\n"
+        "    \"view_actions\": [\n";
+    for (auto i = 0u, blit = 0u, mesh = 0u; i < options.action_count; i++) {
+        if (i > 0)
+            stream << ",\n";
+        if (blits && i % 8 == 7) {
+            stream <<
+                "        {\"type\": \"blit\", \"source\": \"texture_" <<
+                blit % options.texture_count <<
+                "\", \"destination\": \"texture_" <<
+                (blit + 1) % options.texture_count << "\"}";
+            blit++;
+            continue;
+        }
+        auto shader = i % std::max(options.shader_count, 1u);
+        stream <<
+            "        {\n"
+            "            \"type\": \"program\",\n"
+            "            \"shaders\": {\n"
+            "                \"vertex\": \"" << vertex_shader_name(shader) <<
+                "\",\n"
+            "                \"fragment\": \"" <<
+                fragment_shader_name(shader) << "\"\n"
+            "            },\n"
+            "            \"vertex_count\": 4,\n";
+        if (options.mesh_count > 0 && i % 8 == 3) {
+            stream <<
+                "            \"in\": {\"position\": \"positions_" <<
+                mesh % options.mesh_count << "\", \"normal\": \"normals_" <<
+                mesh % options.mesh_count << "\"},\n";
+            mesh++;
+        }
+        stream <<
+            "            \"out\": {\"color\": \"built_in_window\"},\n"
+            "            \"uniforms\": {";
+        float value = float(i % 100) / 100.0f + 0.005f;
+        for (auto j = 0u; j < options.uniform_count; j++)
+            stream <<
+                (j > 0 ? "," : "") <<
+                "\n                \"value_" << j << "\": [" << value <<
+                ", 0.5, 0.25, 1.0]";
+        for (auto j = 0u; j < options.scalar_uniform_count; j++)
+            stream <<
+                (j > 0 || options.uniform_count > 0 ? "," : "") <<
+                "\n                \"scale_" << j << "\": " << value;
+        stream << "\n            }\n        }";
+    }
+    stream << "\n    ]\n}\n";
+}
+
+void write_shaders(
+    const std::filesystem::path& directory,
+    const synthetic_document& options
+) {
+    std::filesystem::create_directories(directory);
+    if (options.mesh_count > 0) {
+        std::ofstream mesh(directory / mesh_file_name);
+        mesh <<
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+            "vn 0 0 1\n"
+            "f 1//1 2//1 3//1\n";
+    }
+    for (auto i = 0u; i < std::max(options.shader_count, 1u); i++) {
+        std::ofstream vertex(directory / vertex_shader_name(i));
+        vertex <<
+            "#version 450\n"
+            "\n"
+            "out vec2 vertex_position;\n"
+            "\n"
+            "vec2 positions[4] = vec2[](\n"
+            "    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), "
+                "vec2(1.0, 1.0)\n"
+            ");\n"
+            "\n"
+            "void main() {\n"
+            "    vertex_position = positions[gl_VertexIndex];\n"
+            "    gl_Position = vec4(vertex_position * 2.0 - 1.0, 0.0, 1.0);\n"
+            "}\n";
+
+        // every shader is different, so none are deduplicated
+        std::ofstream fragment(directory / fragment_shader_name(i));
+        fragment <<
+            "#version 450\n"
+            "\n"
+            "in vec2 vertex_position;\n"
+            "\n"
+            "layout(location = 0) out vec4 fragment_color;\n"
+            "\n";
+        if (options.uniform_count + options.scalar_uniform_count > 0) {
+            fragment << "uniform UniformBufferObject {\n";
+            for (auto j = 0u; j < options.uniform_count; j++)
+                fragment << "    vec4 value_" << j << ";\n";
+            for (auto j = 0u; j < options.scalar_uniform_count; j++)
+                fragment << "    float scale_" << j << ";\n";
+            fragment << "};\n\n";
+        }
+        fragment <<
+            "void main() {\n"
+            "    vec4 color = vec4(vertex_position, " << i << ".0, 1.0);\n";
+        for (auto j = 0u; j < options.uniform_count; j++)
+            fragment << "    color *= value_" << j << ";\n";
+        for (auto j = 0u; j < options.scalar_uniform_count; j++)
+            fragment << "    color *= scale_" << j << ";\n";
+        fragment <<
+            "    fragment_color = color;\n"
+            "}\n";
+    }
+}
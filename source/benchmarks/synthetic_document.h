@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+
+// JSON document of action_count actions, every 8th is a blit between two
+// of texture_count window sized textures if there are at least two,
+// programs draw into the window with shader_count different shader pairs,
+// uniform_count vector and scalar_uniform_count scalar uniforms each, frame
+// actions animate the first animated_count vector uniforms in all
+// programs, alternating between sines of the time and keyframes, every 8th
+// program from the 4th on binds the attributes of one of mesh_count meshes
+// of the same triangle
+struct synthetic_document {
+    unsigned action_count = 1000;
+    unsigned uniform_count = 4;
+    unsigned scalar_uniform_count = 0;
+    unsigned texture_count = 8;
+    unsigned shader_count = 16;
+    unsigned animated_count = 0;
+    unsigned mesh_count = 0;
+};
+
+void write_document(
+    const std::filesystem::path& path, const synthetic_document& options
+);
+// writes the shaders and the mesh the document refers to into directory
+void write_shaders(
+    const std::filesystem::path& directory,
+    const synthetic_document& options
+);
@@ -0,0 +1,177 @@
+#include "animation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "instrumentation.h"
+
+// first float of each built in variable, matrices take 16
+static const uint32_t built_in_floats[] = {0, 1, 2, 18, 34};
+static const uint32_t built_in_float_count = 35;
+
+void uniform_animator::channels::add(
+    uint32_t source, uint32_t target, float frequency, float phase,
+    float scale, float offset
+) {
+    sources.push_back(source);
+    targets.push_back(target);
+    frequencies.push_back(frequency);
+    phases.push_back(phase);
+    scales.push_back(scale);
+    offsets.push_back(offset);
+    arguments.push_back(0);
+}
+
+uniform_animator::uniform_animator(const document& document) {
+    auto& animations = document.animations;
+    // later actions replace earlier ones of the same name
+    std::unordered_map<string_id, uint32_t> by_name;
+    for (uint32_t i = 0; i < animations.size(); i++)
+        by_name[animations.uniform_names[i]] = i;
+    if (by_name.empty())
+        return;
+
+    auto& uniforms = document.uniforms;
+    for (uint32_t i = 0; i < uniforms.size(); i++) {
+        auto found = by_name.find(uniforms.names[i]);
+        if (found == by_name.end())
+            continue;
+        auto animation = found->second;
+        auto function = animations.functions[animation];
+        auto& group =
+            function == animation_function::linear ? linear :
+            function == animation_function::sine ? sine :
+            keyframes;
+        auto source = animations.sources[animation];
+        auto matrix = source == view_matrix || source == projection_matrix;
+        auto keys = animations.keys[animation];
+        auto values = animations.key_values[animation];
+
+        auto components = uniforms.data_size(i) / 4;
+        for (auto j = 0u; j < components; j++) {
+            // missing components repeat the last value
+            auto parameter = [&](range range) {
+                return animations.parameters[
+                    range.first + std::min(j, range.count - 1)
+                ];
+            };
+            group.add(
+                built_in_floats[source] + (matrix ? j : 0),
+                uniforms.offsets[i] + j, animations.frequencies[animation],
+                animations.phases[animation],
+                parameter(animations.scales[animation]),
+                parameter(animations.offsets[animation])
+            );
+            if (function != animation_function::keyframes)
+                continue;
+            this->keys.push_back({
+                static_cast<uint32_t>(key_times.size()), keys.count
+            });
+            auto per_key = values.count / keys.count;
+            for (auto k = 0u; k < keys.count; k++) {
+                key_times.push_back(animations.key_times[keys.first + k]);
+                key_values.push_back(
+                    parameter({values.first + k * per_key, per_key})
+                );
+            }
+        }
+    }
+}
+
+// odd polynomial after reducing x to [-pi / 2, pi / 2], within 1e-5 of
+// std::sin for arguments up to 100, the reduction loses precision like
+// float arguments do, there are no branches or calls, so loops over it
+// vectorize
+static float approximate_sine(float x) {
+    const float pi = 3.14159265f;
+    // adding 1.5 * 2^23 rounds to the nearest integer, for fewer than 2^22
+    // turns
+    const float round = 12582912.f;
+    auto turns = x * (0.5f / pi);
+    x -= ((turns + round) - round) * (2 * pi);
+    // sin(x) = sin(pi - x)
+    x = std::copysign(std::min(std::fabs(x), pi - std::fabs(x)), x);
+    auto x2 = x * x;
+    return x * (
+        1 + x2 * (
+            -1 / 6.f + x2 * (
+                1 / 120.f + x2 * (
+                    -1 / 5040.f + x2 * (
+                        1 / 362880.f + x2 * (-1 / 39916800.f)
+                    )
+                )
+            )
+        )
+    );
+}
+
+// linear between the keys around time, which repeats after the last key
+static float interpolate(
+    const float* times, const float* values, range keys, float time
+) {
+    times += keys.first;
+    values += keys.first;
+    auto period = times[keys.count - 1];
+    if (period > 0)
+        time -= period * std::floor(time / period);
+    auto next = std::upper_bound(times, times + keys.count, time) - times;
+    if (next == 0)
+        return values[0];
+    if (next == keys.count)
+        return values[keys.count - 1];
+    auto t = (time - times[next - 1]) / (times[next] - times[next - 1]);
+    return values[next - 1] + t * (values[next] - values[next - 1]);
+}
+
+void uniform_animator::evaluate(
+    const animation_inputs& inputs, uniform_table& uniforms
+) {
+    if (size() == 0)
+        return;
+    INSTRUMENT_SCOPE("animate uniforms");
+    float built_ins[built_in_float_count];
+    built_ins[built_in_floats[window_width]] = inputs.window_width;
+    built_ins[built_in_floats[window_height]] = inputs.window_height;
+    memcpy(
+        built_ins + built_in_floats[view_matrix],
+        glm::value_ptr(inputs.view_matrix), 16 * 4
+    );
+    memcpy(
+        built_ins + built_in_floats[projection_matrix],
+        glm::value_ptr(inputs.projection_matrix), 16 * 4
+    );
+    built_ins[built_in_floats[elapsed_time]] = inputs.elapsed_time;
+
+    for (auto group : {&linear, &sine, &keyframes}) {
+        auto count = group->size();
+        auto sources = group->sources.data();
+        auto frequencies = group->frequencies.data();
+        auto phases = group->phases.data();
+        auto arguments = group->arguments.data();
+        for (size_t i = 0; i < count; i++)
+            arguments[i] = frequencies[i] * built_ins[sources[i]] + phases[i];
+    }
+    auto arguments = sine.arguments.data();
+    for (size_t i = 0; i < sine.size(); i++)
+        arguments[i] = approximate_sine(arguments[i]);
+    arguments = keyframes.arguments.data();
+    for (size_t i = 0; i < keyframes.size(); i++)
+        arguments[i] = interpolate(
+            key_times.data(), key_values.data(), keys[i], arguments[i]
+        );
+
+    auto values = uniforms.values.data();
+    for (auto group : {&linear, &sine, &keyframes}) {
+        auto count = group->size();
+        auto targets = group->targets.data();
+        auto scales = group->scales.data();
+        auto offsets = group->offsets.data();
+        auto arguments = group->arguments.data();
+        for (size_t i = 0; i < count; i++)
+            values[targets[i]] = offsets[i] + scales[i] * arguments[i];
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "document.h"
+
+// the built in variables of one frame
+struct animation_inputs {
+    float window_width, window_height;
+    glm::mat4 view_matrix, projection_matrix;
+    float elapsed_time;
+};
+
+// the animate frame actions of a document, expanded to one channel per
+// animated component of every uniform they name and grouped by function,
+// so that each function runs over contiguous arrays, which vectorizes
+// results are written to the uniform values, the uniform rings copy them
+// to their mapped frames, the recorded command buffers stay as they are
+struct uniform_animator {
+    uniform_animator() = default;
+    // channels refer to the uniform values of the document, it has to be
+    // rebuilt with the document
+    explicit uniform_animator(const document& document);
+
+    void evaluate(const animation_inputs& inputs, uniform_table& uniforms);
+
+    size_t size() const {
+        return linear.size() + sine.size() + keyframes.size();
+    }
+
+private:
+    struct channels {
+        size_t size() const {
+            return targets.size();
+        }
+        void add(
+            uint32_t source, uint32_t target, float frequency, float phase,
+            float scale, float offset
+        );
+
+        // in the floats of the built in variables
+        std::vector<uint32_t> sources;
+        // in uniform_table::values
+        std::vector<uint32_t> targets;
+        std::vector<float> frequencies, phases, scales, offsets;
+        // of the current frame, the function is applied in place
+        std::vector<float> arguments;
+    };
+
+    channels linear, sine, keyframes;
+    // one range per keyframed channel in key_times and key_values, which
+    // only hold the component of the channel
+    std::vector<range> keys;
+    std::vector<float> key_times, key_values;
+};
@@ -0,0 +1,486 @@
+#include "binary_document.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+static const uint32_t document_magic = 0x4244454d; // "MEDB"
+static const uint32_t document_version = 7;
+
+// one section per array of document, in this order
+enum section_index : uint32_t {
+    string_offsets, string_characters,
+    texture_names, texture_definitions,
+    buffer_names, buffer_sizes,
+    mesh_names, mesh_file_names, mesh_attributes,
+    mesh_attribute_names, mesh_attribute_sources, mesh_attribute_formats,
+    mesh_attribute_meshes,
+    view_actions,
+    program_vertex_shaders, program_fragment_shaders,
+    program_viewport_widths, program_viewport_heights,
+    program_vertex_counts,
+    program_uniforms, program_ins, program_outs, program_meshes,
+    blit_source_names, blit_destination_names,
+    blit_source_textures, blit_destination_textures,
+    compute_shaders, compute_widths, compute_heights, compute_depths,
+    compute_size_names, compute_size_textures, compute_async,
+    compute_uniforms, compute_ins, compute_outs,
+    uniform_names, uniform_types, uniform_offsets, uniform_values,
+    binding_names, binding_values, binding_textures, binding_buffers,
+    binding_attributes,
+    animation_uniform_names, animation_sources, animation_functions,
+    animation_frequencies, animation_phases, animation_scales,
+    animation_offsets, animation_keys, animation_key_values,
+    animation_key_times, animation_parameters,
+    section_count,
+};
+
+struct section {
+    uint32_t offset, size;
+};
+
+struct document_header {
+    uint32_t magic, version;
+    uint32_t display_texture;
+    section sections[section_count];
+};
+
+bool is_binary_document(const mapped_file& file) {
+    uint32_t magic;
+    if (file.size() < sizeof(magic))
+        return false;
+    memcpy(&magic, file.data(), sizeof(magic));
+    return magic == document_magic;
+}
+
+// bounds checked access to the sections of the mapping
+struct binary_reader {
+    const std::byte* data;
+    size_t size;
+    const document_header& header;
+
+    template<typename T>
+    std::pair<const T*, size_t> view(section_index index) const {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto section = header.sections[index];
+        if (
+            section.offset % alignof(T) != 0 || section.offset > size ||
+            size - section.offset < section.size ||
+            section.size % sizeof(T) != 0
+        )
+            throw std::runtime_error("Corrupt binary document");
+        return {
+            reinterpret_cast<const T*>(data + section.offset),
+            section.size / sizeof(T)
+        };
+    }
+
+    // the arrays are copied as a whole, no per element work
+    template<typename T>
+    void read(section_index index, std::vector<T>& result) const {
+        auto elements = view<T>(index);
+        result.assign(elements.first, elements.first + elements.second);
+    }
+};
+
+document from_binary(const mapped_file& file) {
+    document_header header;
+    if (file.size() < sizeof(header))
+        throw std::runtime_error("Corrupt binary document");
+    memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != document_magic)
+        throw std::runtime_error("Not a binary document");
+    if (header.version != document_version)
+        throw std::runtime_error("Unsupported binary document version");
+
+    binary_reader reader{file.data(), file.size(), header};
+    document document;
+    document.display_texture = header.display_texture;
+
+    // strings are unique in the file, so interning them in order keeps ids
+    auto offsets = reader.view<uint32_t>(string_offsets);
+    auto characters = reader.view<char>(string_characters);
+    for (size_t i = 0; i + 1 < offsets.second; i++) {
+        auto begin = offsets.first[i], end = offsets.first[i + 1];
+        if (begin > end || end > characters.second)
+            throw std::runtime_error("Corrupt binary document");
+        auto id = document.strings.intern(
+            {characters.first + begin, end - begin}
+        );
+        if (id != i)
+            throw std::runtime_error("Corrupt binary document");
+    }
+    auto valid_string = [&](const std::vector<string_id>& ids) {
+        for (auto id : ids)
+            if (id >= document.strings.size())
+                throw std::runtime_error("Corrupt binary document");
+    };
+
+    auto& textures = document.textures;
+    reader.read(texture_names, textures.names);
+    reader.read(texture_definitions, textures.definitions);
+
+    auto& buffers = document.buffers;
+    reader.read(buffer_names, buffers.names);
+    reader.read(buffer_sizes, buffers.sizes);
+
+    auto& meshes = document.meshes;
+    reader.read(mesh_names, meshes.names);
+    reader.read(mesh_file_names, meshes.file_names);
+    reader.read(mesh_attributes, meshes.attributes);
+    reader.read(mesh_attribute_names, meshes.attribute_names);
+    reader.read(mesh_attribute_sources, meshes.attribute_sources);
+    reader.read(mesh_attribute_formats, meshes.attribute_formats);
+    reader.read(mesh_attribute_meshes, meshes.attribute_meshes);
+
+    reader.read(view_actions, document.view_actions);
+
+    auto& programs = document.programs;
+    reader.read(program_vertex_shaders, programs.vertex_shaders);
+    reader.read(program_fragment_shaders, programs.fragment_shaders);
+    reader.read(program_viewport_widths, programs.viewport_widths);
+    reader.read(program_viewport_heights, programs.viewport_heights);
+    reader.read(program_vertex_counts, programs.vertex_counts);
+    reader.read(program_uniforms, programs.uniforms);
+    reader.read(program_ins, programs.ins);
+    reader.read(program_outs, programs.outs);
+    reader.read(program_meshes, programs.meshes);
+
+    auto& blits = document.blits;
+    reader.read(blit_source_names, blits.source_names);
+    reader.read(blit_destination_names, blits.destination_names);
+    reader.read(blit_source_textures, blits.source_textures);
+    reader.read(blit_destination_textures, blits.destination_textures);
+
+    auto& computes = document.computes;
+    reader.read(compute_shaders, computes.shaders);
+    reader.read(compute_widths, computes.widths);
+    reader.read(compute_heights, computes.heights);
+    reader.read(compute_depths, computes.depths);
+    reader.read(compute_size_names, computes.size_names);
+    reader.read(compute_size_textures, computes.size_textures);
+    reader.read(compute_async, computes.async);
+    reader.read(compute_uniforms, computes.uniforms);
+    reader.read(compute_ins, computes.ins);
+    reader.read(compute_outs, computes.outs);
+
+    auto& uniforms = document.uniforms;
+    reader.read(uniform_names, uniforms.names);
+    reader.read(uniform_types, uniforms.types);
+    reader.read(uniform_offsets, uniforms.offsets);
+    reader.read(uniform_values, uniforms.values);
+
+    auto& bindings = document.bindings;
+    reader.read(binding_names, bindings.names);
+    reader.read(binding_values, bindings.values);
+    reader.read(binding_textures, bindings.textures);
+    reader.read(binding_buffers, bindings.buffers);
+    reader.read(binding_attributes, bindings.attributes);
+
+    auto& animations = document.animations;
+    reader.read(animation_uniform_names, animations.uniform_names);
+    reader.read(animation_sources, animations.sources);
+    reader.read(animation_functions, animations.functions);
+    reader.read(animation_frequencies, animations.frequencies);
+    reader.read(animation_phases, animations.phases);
+    reader.read(animation_scales, animations.scales);
+    reader.read(animation_offsets, animations.offsets);
+    reader.read(animation_keys, animations.keys);
+    reader.read(animation_key_values, animations.key_values);
+    reader.read(animation_key_times, animations.key_times);
+    reader.read(animation_parameters, animations.parameters);
+
+    // everything the rest of the editor indexes without checks
+    valid_string(programs.vertex_shaders);
+    valid_string(programs.fragment_shaders);
+    valid_string(uniforms.names);
+    valid_string(bindings.names);
+    valid_string(bindings.values);
+    valid_string(textures.names);
+    valid_string(blits.source_names);
+    valid_string(blits.destination_names);
+    valid_string(buffers.names);
+    valid_string(computes.shaders);
+    valid_string(meshes.names);
+    valid_string(meshes.file_names);
+    valid_string(meshes.attribute_names);
+    valid_string(animations.uniform_names);
+    for (auto name : computes.size_names)
+        if (name != -1u && name >= document.strings.size())
+            throw std::runtime_error("Corrupt binary document");
+    auto program_count = programs.size();
+    auto compute_count = computes.size();
+    auto in_table = [](range range, size_t size) {
+        return range.first <= size && size - range.first >= range.count;
+    };
+    bool valid =
+        programs.fragment_shaders.size() == program_count &&
+        programs.viewport_widths.size() == program_count &&
+        programs.viewport_heights.size() == program_count &&
+        programs.vertex_counts.size() == program_count &&
+        programs.uniforms.size() == program_count &&
+        programs.ins.size() == program_count &&
+        programs.outs.size() == program_count &&
+        programs.meshes.size() == program_count &&
+        blits.source_names.size() == blits.size() &&
+        blits.destination_names.size() == blits.size() &&
+        blits.destination_textures.size() == blits.size() &&
+        computes.widths.size() == compute_count &&
+        computes.heights.size() == compute_count &&
+        computes.depths.size() == compute_count &&
+        computes.size_names.size() == compute_count &&
+        computes.size_textures.size() == compute_count &&
+        computes.async.size() == compute_count &&
+        computes.uniforms.size() == compute_count &&
+        computes.ins.size() == compute_count &&
+        computes.outs.size() == compute_count &&
+        buffers.sizes.size() == buffers.size() &&
+        uniforms.types.size() == uniforms.size() &&
+        uniforms.offsets.size() == uniforms.size() &&
+        textures.definitions.size() == textures.size() &&
+        bindings.values.size() == bindings.names.size() &&
+        bindings.textures.size() == bindings.names.size() &&
+        bindings.buffers.size() == bindings.names.size() &&
+        bindings.attributes.size() == bindings.names.size() &&
+        meshes.file_names.size() == meshes.size() &&
+        meshes.attributes.size() == meshes.size() &&
+        meshes.attribute_sources.size() == meshes.attribute_names.size() &&
+        meshes.attribute_formats.size() == meshes.attribute_names.size() &&
+        meshes.attribute_meshes.size() == meshes.attribute_names.size() &&
+        animations.sources.size() == animations.size() &&
+        animations.functions.size() == animations.size() &&
+        animations.frequencies.size() == animations.size() &&
+        animations.phases.size() == animations.size() &&
+        animations.scales.size() == animations.size() &&
+        animations.offsets.size() == animations.size() &&
+        animations.keys.size() == animations.size() &&
+        animations.key_values.size() == animations.size();
+    auto valid_texture = [&](unsigned texture) {
+        return texture < textures.size() || texture == built_in_window;
+    };
+    for (size_t i = 0; valid && i < program_count; i++) {
+        valid =
+            in_table(programs.uniforms[i], uniforms.size()) &&
+            in_table(programs.ins[i], bindings.names.size()) &&
+            in_table(programs.outs[i], bindings.names.size()) &&
+            (
+                programs.meshes[i] < meshes.size() ||
+                programs.meshes[i] == no_mesh
+            );
+    }
+    for (size_t i = 0; valid && i < program_count; i++) {
+        auto outs = programs.outs[i];
+        for (auto j = outs.first; valid && j < outs.first + outs.count; j++)
+            valid = valid_texture(bindings.textures[j]);
+    }
+    for (size_t i = 0; valid && i < compute_count; i++) {
+        valid =
+            in_table(computes.uniforms[i], uniforms.size()) &&
+            in_table(computes.ins[i], bindings.names.size()) &&
+            in_table(computes.outs[i], bindings.names.size()) &&
+            (
+                valid_texture(computes.size_textures[i]) ||
+                computes.size_textures[i] == no_texture
+            );
+    }
+    for (size_t i = 0; valid && i < bindings.textures.size(); i++)
+        valid =
+            (
+                valid_texture(bindings.textures[i]) ||
+                bindings.textures[i] == no_texture
+            ) && (
+                bindings.buffers[i] < buffers.size() ||
+                bindings.buffers[i] == no_buffer
+            ) && (
+                bindings.attributes[i] < meshes.attribute_names.size() ||
+                bindings.attributes[i] == no_attribute
+            );
+    for (size_t i = 0; valid && i < blits.size(); i++)
+        valid =
+            blits.source_textures[i] < textures.size() &&
+            blits.destination_textures[i] < textures.size();
+    for (size_t i = 0; valid && i < textures.size(); i++)
+        valid =
+            static_cast<unsigned>(textures.definitions[i].format) <= 3 &&
+            textures.definitions[i].depth == 1;
+    for (size_t i = 0; valid && i < meshes.size(); i++)
+        valid = in_table(meshes.attributes[i], meshes.attribute_names.size());
+    for (size_t i = 0; valid && i < meshes.attribute_names.size(); i++) {
+        auto format = meshes.attribute_formats[i];
+        valid =
+            static_cast<unsigned>(meshes.attribute_sources[i]) <= 2 &&
+            static_cast<unsigned>(format) <= 4 &&
+            format != format::b8g8r8a8_srgb &&
+            meshes.attribute_meshes[i] < meshes.size();
+    }
+    for (size_t i = 0; valid && i < uniforms.size(); i++) {
+        valid =
+            static_cast<unsigned>(uniforms.types[i]) <= 2 &&
+            uniforms.offsets[i] <= uniforms.values.size() &&
+            uniforms.values.size() - uniforms.offsets[i] >=
+            uniforms.data_size(i) / 4;
+    }
+    // evaluating indexes the parameters of every component
+    auto parameters = animations.parameters.size();
+    auto valid_components = [&](range range) {
+        return range.count >= 1 && range.count <= 16;
+    };
+    for (size_t i = 0; valid && i < animations.size(); i++) {
+        auto keys = animations.keys[i], values = animations.key_values[i];
+        valid =
+            static_cast<unsigned>(animations.sources[i]) <= elapsed_time &&
+            static_cast<unsigned>(animations.functions[i]) <= 2 &&
+            in_table(animations.scales[i], parameters) &&
+            valid_components(animations.scales[i]) &&
+            in_table(animations.offsets[i], parameters) &&
+            valid_components(animations.offsets[i]) &&
+            in_table(keys, animations.key_times.size()) &&
+            in_table(values, parameters);
+        if (
+            valid &&
+            animations.functions[i] == animation_function::keyframes
+        ) {
+            auto times = animations.key_times.begin() + keys.first;
+            valid =
+                keys.count > 0 && values.count % keys.count == 0 &&
+                valid_components({0, values.count / keys.count}) &&
+                std::is_sorted(times, times + keys.count);
+        }
+    }
+    for (auto action : document.view_actions) {
+        switch (action.type) {
+        case action_type::program:
+            valid = valid && action.index < program_count;
+            break;
+        case action_type::blit:
+            valid = valid && action.index < blits.size();
+            break;
+        case action_type::compute:
+            valid = valid && action.index < compute_count;
+            break;
+        default:
+            valid = false;
+        }
+    }
+    if (!valid)
+        throw std::runtime_error("Corrupt binary document");
+
+    return document;
+}
+
+static size_t padded(size_t size) {
+    return (size + 3) & ~size_t(3);
+}
+
+void to_binary_file(const document& document, const char* file_name) {
+    document_header header = {
+        .magic = document_magic,
+        .version = document_version,
+        .display_texture = document.display_texture,
+        .sections = {},
+    };
+    std::vector<char> content(sizeof(header));
+    auto write = [&](section_index index, const auto* data, size_t count) {
+        auto size = count * sizeof(*data);
+        header.sections[index] = {
+            static_cast<uint32_t>(content.size()),
+            static_cast<uint32_t>(size)
+        };
+        auto bytes = reinterpret_cast<const char*>(data);
+        content.insert(content.end(), bytes, bytes + size);
+        content.resize(padded(content.size()));
+    };
+    auto write_vector = [&](section_index index, const auto& vector) {
+        write(index, vector.data(), vector.size());
+    };
+
+    std::vector<uint32_t> offsets = {0};
+    std::string characters;
+    for (size_t i = 0; i < document.strings.size(); i++) {
+        characters += document.strings[i];
+        offsets.push_back(static_cast<uint32_t>(characters.size()));
+    }
+    write_vector(string_offsets, offsets);
+    write_vector(string_characters, characters);
+    write_vector(texture_names, document.textures.names);
+    write_vector(texture_definitions, document.textures.definitions);
+    write_vector(buffer_names, document.buffers.names);
+    write_vector(buffer_sizes, document.buffers.sizes);
+
+    auto& meshes = document.meshes;
+    write_vector(mesh_names, meshes.names);
+    write_vector(mesh_file_names, meshes.file_names);
+    write_vector(mesh_attributes, meshes.attributes);
+    write_vector(mesh_attribute_names, meshes.attribute_names);
+    write_vector(mesh_attribute_sources, meshes.attribute_sources);
+    write_vector(mesh_attribute_formats, meshes.attribute_formats);
+    write_vector(mesh_attribute_meshes, meshes.attribute_meshes);
+
+    write_vector(view_actions, document.view_actions);
+
+    auto& programs = document.programs;
+    write_vector(program_vertex_shaders, programs.vertex_shaders);
+    write_vector(program_fragment_shaders, programs.fragment_shaders);
+    write_vector(program_viewport_widths, programs.viewport_widths);
+    write_vector(program_viewport_heights, programs.viewport_heights);
+    write_vector(program_vertex_counts, programs.vertex_counts);
+    write_vector(program_uniforms, programs.uniforms);
+    write_vector(program_ins, programs.ins);
+    write_vector(program_outs, programs.outs);
+    write_vector(program_meshes, programs.meshes);
+
+    write_vector(blit_source_names, document.blits.source_names);
+    write_vector(blit_destination_names, document.blits.destination_names);
+    write_vector(blit_source_textures, document.blits.source_textures);
+    write_vector(
+        blit_destination_textures, document.blits.destination_textures
+    );
+
+    auto& computes = document.computes;
+    write_vector(compute_shaders, computes.shaders);
+    write_vector(compute_widths, computes.widths);
+    write_vector(compute_heights, computes.heights);
+    write_vector(compute_depths, computes.depths);
+    write_vector(compute_size_names, computes.size_names);
+    write_vector(compute_size_textures, computes.size_textures);
+    write_vector(compute_async, computes.async);
+    write_vector(compute_uniforms, computes.uniforms);
+    write_vector(compute_ins, computes.ins);
+    write_vector(compute_outs, computes.outs);
+
+    auto& uniforms = document.uniforms;
+    write_vector(uniform_names, uniforms.names);
+    write_vector(uniform_types, uniforms.types);
+    write_vector(uniform_offsets, uniforms.offsets);
+    write_vector(uniform_values, uniforms.values);
+
+    write_vector(binding_names, document.bindings.names);
+    write_vector(binding_values, document.bindings.values);
+    write_vector(binding_textures, document.bindings.textures);
+    write_vector(binding_buffers, document.bindings.buffers);
+    write_vector(binding_attributes, document.bindings.attributes);
+
+    auto& animations = document.animations;
+    write_vector(animation_uniform_names, animations.uniform_names);
+    write_vector(animation_sources, animations.sources);
+    write_vector(animation_functions, animations.functions);
+    write_vector(animation_frequencies, animations.frequencies);
+    write_vector(animation_phases, animations.phases);
+    write_vector(animation_scales, animations.scales);
+    write_vector(animation_offsets, animations.offsets);
+    write_vector(animation_keys, animations.keys);
+    write_vector(animation_key_values, animations.key_values);
+    write_vector(animation_key_times, animations.key_times);
+    write_vector(animation_parameters, animations.parameters);
+
+    memcpy(content.data(), &header, sizeof(header));
+
+    std::ofstream file(file_name, std::ios::binary);
+    if (!file.write(content.data(), content.size()))
+        throw std::runtime_error(
+            std::string("Couldn't write ") + file_name
+        );
+}
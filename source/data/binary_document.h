@@ -0,0 +1,21 @@
+#pragma once
+
+#include "document.h"
+#include "mapped_file.h"
+
+// versioned binary form of document, meant to be mapped and copied without
+// parsing
+//
+// the header is followed by one 4 byte aligned section per array of
+// document, so loading copies whole arrays, strings are stored once and
+// referenced by their id, integers are little endian
+//
+// the tables aren't views into the mapping, because editing and reloading
+// change them, the cost of the copy is reported by the load benchmark
+
+bool is_binary_document(const mapped_file& file);
+
+// throws std::runtime_error if the file is truncated or from another version
+document from_binary(const mapped_file& file);
+
+void to_binary_file(const document& document, const char* file_name);
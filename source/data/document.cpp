@@ -1,10 +1,17 @@
 #include "document.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
+#include <stdexcept>
 
 #include <glm/gtc/type_ptr.hpp>
 #include <json/json.hpp>
 
+#include "mapped_file.h"
+#include "binary_document.h"
+#include "instrumentation.h"
+
 uniform_value from_json(nlohmann::json json) {
     if (json.is_array()) {
         if (json.size() > 4)
@@ -65,67 +72,1292 @@ std::pair<const void*, unsigned> get_data_pointer(
     return std::visit(get_data_pointer_functor{}, value);
 }
 
-document from_file(const char* file_name) {
+string_id string_pool::intern(std::string_view string) {
+    auto found = ids.find(string);
+    if (found != ids.end())
+        return found->second;
+
+    if (chunk_size - chunk_used < string.size()) {
+        chunk_size = std::max<size_t>(64 * 1024, string.size());
+        chunks.push_back(std::make_unique<char[]>(chunk_size));
+        chunk_used = 0;
+    }
+    auto characters = chunks.back().get() + chunk_used;
+    std::copy(string.begin(), string.end(), characters);
+    chunk_used += string.size();
+
+    auto id = static_cast<string_id>(strings.size());
+    strings.push_back({characters, string.size()});
+    ids.insert({strings.back(), id});
+    return id;
+}
+
+string_id string_pool::find(std::string_view string) const {
+    auto found = ids.find(string);
+    return found == ids.end() ? -1u : found->second;
+}
+
+static const unsigned uniform_components[] = {1, 4, 16};
+
+uint32_t uniform_table::add(string_id name, const uniform_value& value) {
+    auto span = get_data_pointer(value);
+    auto data = static_cast<const float*>(span.first);
+    names.push_back(name);
+    types.push_back(static_cast<uniform_type>(value.index()));
+    offsets.push_back(static_cast<uint32_t>(values.size()));
+    values.insert(values.end(), data, data + span.second / 4);
+    return static_cast<uint32_t>(names.size() - 1);
+}
+
+uniform_value uniform_table::get(uint32_t index) const {
+    auto value = data(index);
+    switch (types[index]) {
+    case uniform_type::scalar:
+        return *value;
+    case uniform_type::vector:
+        return glm::make_vec4(value);
+    case uniform_type::matrix:
+        return glm::make_mat4(value);
+    }
+    throw std::runtime_error("Unknown uniform type");
+}
+
+void uniform_table::set(uint32_t index, const uniform_value& value) {
+    if (static_cast<uniform_type>(value.index()) != types[index])
+        throw std::runtime_error("Uniform type mismatch");
+    auto span = get_data_pointer(value);
+    memcpy(values.data() + offsets[index], span.first, span.second);
+}
+
+unsigned uniform_table::data_size(uint32_t index) const {
+    return uniform_components[static_cast<int>(types[index])] * 4;
+}
+
+void uniform_table::truncate(uint32_t index) {
+    if (index >= names.size())
+        return;
+    values.resize(offsets[index]);
+    names.resize(index);
+    types.resize(index);
+    offsets.resize(index);
+}
+
+void document::add_program(
+    string_id vertex_shader, string_id fragment_shader,
+    unsigned viewport_width, unsigned viewport_height,
+    unsigned vertex_count, range uniforms, range ins, range outs
+) {
+    view_actions.push_back({
+        action_type::program, static_cast<uint32_t>(programs.size())
+    });
+    programs.vertex_shaders.push_back(vertex_shader);
+    programs.fragment_shaders.push_back(fragment_shader);
+    programs.viewport_widths.push_back(viewport_width);
+    programs.viewport_heights.push_back(viewport_height);
+    programs.vertex_counts.push_back(vertex_count);
+    programs.uniforms.push_back(uniforms);
+    programs.ins.push_back(ins);
+    programs.outs.push_back(outs);
+    programs.meshes.push_back(no_mesh);
+}
+
+void document::add_blit(string_id source, string_id destination) {
+    view_actions.push_back({
+        action_type::blit, static_cast<uint32_t>(blits.size())
+    });
+    blits.source_names.push_back(source);
+    blits.destination_names.push_back(destination);
+    blits.source_textures.push_back(no_texture);
+    blits.destination_textures.push_back(no_texture);
+}
+
+void document::add_compute(
+    string_id shader, unsigned width, unsigned height, unsigned depth,
+    string_id size_name, bool async, range uniforms, range ins, range outs
+) {
+    view_actions.push_back({
+        action_type::compute, static_cast<uint32_t>(computes.size())
+    });
+    computes.shaders.push_back(shader);
+    computes.widths.push_back(width);
+    computes.heights.push_back(height);
+    computes.depths.push_back(depth);
+    computes.size_names.push_back(size_name);
+    computes.size_textures.push_back(no_texture);
+    computes.async.push_back(async);
+    computes.uniforms.push_back(uniforms);
+    computes.ins.push_back(ins);
+    computes.outs.push_back(outs);
+}
+
+uint32_t animation_table::add(
+    string_id uniform_name, built_in_variables source,
+    animation_function function, float frequency, float phase,
+    range scales, range offsets, range keys, range key_values
+) {
+    // components are those of a matrix at most
+    auto components = [](range parameters) {
+        return parameters.count >= 1 && parameters.count <= 16;
+    };
+    if (!components(scales) || !components(offsets))
+        throw std::runtime_error("Animations need 1 to 16 scales and offsets");
+    if (function == animation_function::keyframes) {
+        if (
+            keys.count == 0 || key_values.count % keys.count != 0 ||
+            !components({0, key_values.count / keys.count})
+        )
+            throw std::runtime_error(
+                "Keyframes need 1 to 16 values for each of their keys"
+            );
+        auto times = key_times.begin() + keys.first;
+        if (!std::is_sorted(times, times + keys.count))
+            throw std::runtime_error("Keyframe times have to ascend");
+    }
+    uniform_names.push_back(uniform_name);
+    sources.push_back(source);
+    functions.push_back(function);
+    frequencies.push_back(frequency);
+    phases.push_back(phase);
+    this->scales.push_back(scales);
+    this->offsets.push_back(offsets);
+    this->keys.push_back(keys);
+    this->key_values.push_back(key_values);
+    return static_cast<uint32_t>(uniform_names.size() - 1);
+}
+
+unsigned buffer_table::find(
+    std::string_view name, const string_pool& strings
+) const {
+    auto id = strings.find(name);
+    auto buffer = std::find(names.begin(), names.end(), id);
+    if (id == -1u || buffer == names.end())
+        return no_buffer;
+    return static_cast<unsigned>(buffer - names.begin());
+}
+
+unsigned mesh_table::find_attribute(
+    std::string_view name, const string_pool& strings
+) const {
+    auto id = strings.find(name);
+    auto attribute = std::find(
+        attribute_names.begin(), attribute_names.end(), id
+    );
+    if (id == -1u || attribute == attribute_names.end())
+        return no_attribute;
+    return static_cast<unsigned>(attribute - attribute_names.begin());
+}
+
+unsigned texture_table::find(
+    std::string_view name, const string_pool& strings
+) const {
+    if (name == "built_in_window")
+        return built_in_window;
+    auto id = strings.find(name);
+    auto texture = std::find(names.begin(), names.end(), id);
+    if (id == -1u || texture == names.end())
+        return no_texture;
+    return static_cast<unsigned>(texture - names.begin());
+}
+
+static const char* format_names[] = {
+    "A2B10G10R10_UNORM_PACK32", "A2B10G10R10_SNORM_PACK32",
+    "R8G8B8A8_UNORM", "B8G8R8A8_SRGB", "R8G8B8_SNORM",
+};
+
+// three component formats are rarely supported for images, sRGB isn't used
+// for vertices
+static format format_from_name(std::string_view name, bool attribute) {
+    auto excluded = attribute ? format::b8g8r8a8_srgb : format::r8g8b8_snorm;
+    for (auto i = 0u; i < std::size(format_names); i++)
+        if (name == format_names[i] && static_cast<format>(i) != excluded)
+            return static_cast<format>(i);
+    throw std::runtime_error(
+        (attribute ? "Unknown vertex format " : "Unknown texture format ") +
+        std::string(name)
+    );
+}
+
+// attributes are keyed by where their values come from in the file
+static const char* mesh_source_names[] = {
+    "faces_vertices_position", "faces_vertices_normal",
+    "faces_vertices_texture_coordinate",
+};
+
+// false if the key isn't an attribute
+static bool mesh_source_from_name(std::string_view name, mesh_source& source) {
+    for (auto i = 0u; i < std::size(mesh_source_names); i++) {
+        if (name == mesh_source_names[i]) {
+            source = static_cast<mesh_source>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char* window_size_names[] = {
+    "built_in_window_width", "built_in_window_height",
+};
+
+// only the size of the window can be referenced by name, also used for the
+// dispatch size of compute actions
+static unsigned texture_size_from_name(std::string_view name, unsigned index) {
+    if (index >= 2 || name != window_size_names[index])
+        throw std::runtime_error("Unknown texture size " + std::string(name));
+    return 0;
+}
+
+static const char* built_in_variable_names[] = {
+    "built_in_window_width", "built_in_window_height",
+    "built_in_view_matrix", "built_in_projection_matrix", "built_in_time",
+};
+
+static built_in_variables built_in_variable_from_name(std::string_view name) {
+    for (auto i = 0u; i < std::size(built_in_variable_names); i++)
+        if (name == built_in_variable_names[i])
+            return static_cast<built_in_variables>(i);
+    throw std::runtime_error("Unknown built in variable " + std::string(name));
+}
+
+static const char* animation_function_names[] = {
+    "linear", "sine", "keyframes",
+};
+
+static animation_function animation_function_from_name(
+    std::string_view name
+) {
+    for (auto i = 0u; i < std::size(animation_function_names); i++)
+        if (name == animation_function_names[i])
+            return static_cast<animation_function>(i);
+    throw std::runtime_error("Unknown animation function " + std::string(name));
+}
+
+// render targets are 2D images
+static void add_texture(
+    document& document, string_id name, const texture_definition& texture
+) {
+    if (texture.depth != 1)
+        throw std::runtime_error(
+            "Textures can't have a depth other than 1: " +
+            std::string(document.strings[name])
+        );
+    document.textures.add(name, texture);
+}
+
+static const texture_definition default_texture = {
+    0, 0, 1, format::r8g8b8a8_unorm,
+};
+
+// programs without outs draw to the window
+static range default_outs(document& document) {
+    range outs = {static_cast<uint32_t>(document.bindings.names.size()), 1};
+    document.bindings.add(
+        document.strings.intern("outColor"),
+        document.strings.intern("built_in_window"), built_in_window
+    );
+    return outs;
+}
+
+// textures may follow the actions in the file, so bindings are resolved
+// once everything is parsed, outs and blits have to be textures, compute
+// actions bind textures other than the window or buffers, the ins of
+// programs may bind the attributes of one mesh
+static void resolve_bindings(document& document) {
+    auto blit_texture = [&](string_id name) {
+        auto texture = document.textures.find(
+            document.strings[name], document.strings
+        );
+        if (texture == no_texture || texture == built_in_window)
+            throw std::runtime_error(
+                "Blits need textures, not " +
+                std::string(document.strings[name])
+            );
+        return texture;
+    };
+    auto& blits = document.blits;
+    for (size_t i = 0; i < blits.size(); i++) {
+        blits.source_textures[i] = blit_texture(blits.source_names[i]);
+        blits.destination_textures[i] =
+            blit_texture(blits.destination_names[i]);
+    }
+
+    auto& bindings = document.bindings;
+    for (size_t i = 0; i < bindings.names.size(); i++) {
+        auto value = document.strings[bindings.values[i]];
+        bindings.textures[i] = document.textures.find(value, document.strings);
+        bindings.buffers[i] = bindings.textures[i] != no_texture ?
+            no_buffer : document.buffers.find(value, document.strings);
+        bindings.attributes[i] =
+            bindings.textures[i] != no_texture ||
+            bindings.buffers[i] != no_buffer ?
+            no_attribute :
+            document.meshes.find_attribute(value, document.strings);
+    }
+    auto& programs = document.programs;
+    for (size_t i = 0; i < programs.size(); i++) {
+        auto ins = programs.ins[i];
+        programs.meshes[i] = no_mesh;
+        for (auto j = ins.first; j < ins.first + ins.count; j++) {
+            if (bindings.attributes[j] == no_attribute)
+                continue;
+            auto mesh =
+                document.meshes.attribute_meshes[bindings.attributes[j]];
+            if (programs.meshes[i] != no_mesh && programs.meshes[i] != mesh)
+                throw std::runtime_error(
+                    "Programs can only draw one mesh"
+                );
+            programs.meshes[i] = mesh;
+        }
+    }
+    for (auto outs : document.programs.outs) {
+        for (auto i = outs.first; i < outs.first + outs.count; i++)
+            if (bindings.textures[i] == no_texture)
+                throw std::runtime_error(
+                    "Unknown texture " +
+                    std::string(document.strings[bindings.values[i]])
+                );
+    }
+
+    auto& computes = document.computes;
+    for (size_t i = 0; i < computes.size(); i++) {
+        if (computes.size_names[i] != -1u) {
+            auto name = document.strings[computes.size_names[i]];
+            computes.size_textures[i] =
+                document.textures.find(name, document.strings);
+            if (computes.size_textures[i] == no_texture)
+                throw std::runtime_error(
+                    "Unknown texture " + std::string(name)
+                );
+        }
+        for (auto bound : {computes.ins[i], computes.outs[i]}) {
+            for (auto j = bound.first; j < bound.first + bound.count; j++) {
+                if (bindings.textures[j] == built_in_window)
+                    throw std::runtime_error(
+                        "Compute actions can't use the window"
+                    );
+                if (
+                    bindings.textures[j] == no_texture &&
+                    bindings.buffers[j] == no_buffer
+                )
+                    throw std::runtime_error(
+                        "Unknown texture or buffer " +
+                        std::string(document.strings[bindings.values[j]])
+                    );
+            }
+        }
+    }
+}
+
+static range add_uniforms(document& document, const nlohmann::json& json) {
+    range uniforms = {static_cast<uint32_t>(document.uniforms.size()), 0};
+    auto json_uniforms = json.find("uniforms");
+    if (json_uniforms == json.end())
+        return uniforms;
+    // object iteration not supported with this version of nlohmann
+    auto json_uniform = json_uniforms->begin();
+    for (; json_uniform != json_uniforms->end(); ++json_uniform) {
+        document.uniforms.add(
+            document.strings.intern(json_uniform.key()),
+            from_json(json_uniform.value())
+        );
+        uniforms.count++;
+    }
+    return uniforms;
+}
+
+static range add_bindings(document& document, const nlohmann::json& json) {
+    range bindings = {
+        static_cast<uint32_t>(document.bindings.names.size()), 0
+    };
+    auto binding = json.begin();
+    for (; binding != json.end(); ++binding) {
+        document.bindings.add(
+            document.strings.intern(binding.key()),
+            document.strings.intern(binding.value().get<std::string>()),
+            no_texture
+        );
+        bindings.count++;
+    }
+    return bindings;
+}
+
+// parameters of frame actions are numbers or flat arrays of them
+static range add_floats(
+    std::vector<float>& values, const nlohmann::json& json, const char* key
+) {
+    range added = {static_cast<uint32_t>(values.size()), 0};
+    auto value = json.find(key);
+    if (value == json.end())
+        return added;
+    if (value->is_array()) {
+        for (const auto& component : *value)
+            values.push_back(component.get<float>());
+    } else {
+        values.push_back(value->get<float>());
+    }
+    added.count = static_cast<uint32_t>(values.size()) - added.first;
+    return added;
+}
+
+static void add_frame_action(document& document, const nlohmann::json& json) {
+    if (json.at("type").get<std::string>() != "animate")
+        throw std::runtime_error("unsupported frame action type");
+    auto& animations = document.animations;
+    auto defaulted = [&](const char* key, float value) {
+        auto added = add_floats(animations.parameters, json, key);
+        if (added.count == 0) {
+            animations.parameters.push_back(value);
+            added.count = 1;
+        }
+        return added;
+    };
+    auto scales = defaulted("scale", 1), offsets = defaulted("offset", 0);
+    auto keys = add_floats(animations.key_times, json, "key_times");
+    auto key_values = add_floats(animations.parameters, json, "key_values");
+    auto source = json.find("source");
+    auto function = json.find("function");
+    animations.add(
+        document.strings.intern(json.at("uniform").get<std::string>()),
+        source == json.end() ?
+            elapsed_time :
+            built_in_variable_from_name(source->get<std::string>()),
+        function != json.end() ?
+            animation_function_from_name(function->get<std::string>()) :
+            keys.count > 0 ?
+            animation_function::keyframes :
+            animation_function::linear,
+        json.value("frequency", 1.0f), json.value("phase", 0.0f),
+        scales, offsets, keys, key_values
+    );
+}
+
+document from_file_dom(const char* file_name) {
     std::ifstream i(file_name);
     nlohmann::json j;
     i >> j;
 
     document d;
+    d.directory = std::filesystem::path(file_name).parent_path().string();
 
+    auto json_meshes = j.find("meshes");
+    if (json_meshes != j.end()) {
+        auto json_mesh = json_meshes->begin();
+        for (; json_mesh != json_meshes->end(); ++json_mesh) {
+            auto& json_definition = json_mesh.value();
+            range attributes = {
+                static_cast<uint32_t>(d.meshes.attribute_names.size()), 0
+            };
+            auto json_attribute = json_definition.begin();
+            for (; json_attribute != json_definition.end(); ++json_attribute) {
+                mesh_source source;
+                if (!mesh_source_from_name(json_attribute.key(), source))
+                    continue;
+                auto& attribute = json_attribute.value();
+                d.meshes.add_attribute(
+                    d.strings.intern(attribute.at("name").get<std::string>()),
+                    source,
+                    format_from_name(
+                        attribute.at("format").get<std::string>(), true
+                    )
+                );
+                attributes.count++;
+            }
+            d.meshes.add(
+                d.strings.intern(json_mesh.key()),
+                d.strings.intern(
+                    json_definition.at("file_name").get<std::string>()
+                ),
+                attributes
+            );
+        }
+    }
 
-    auto& actions = j.at("view_actions");
-    d.view_actions.resize(actions.size());
+    auto json_textures = j.find("textures");
+    if (json_textures != j.end()) {
+        auto json_texture = json_textures->begin();
+        for (; json_texture != json_textures->end(); ++json_texture) {
+            auto definition = default_texture;
+            auto& json_definition = json_texture.value();
+            auto size = json_definition.find("size");
+            unsigned* sizes[] = {
+                &definition.width, &definition.height, &definition.depth
+            };
+            for (auto i = 0u; size != json_definition.end() && i < 3; i++) {
+                if (i >= size->size())
+                    break;
+                auto& json_size = size->at(i);
+                *sizes[i] = json_size.is_string() ?
+                    texture_size_from_name(json_size.get<std::string>(), i) :
+                    json_size.get<unsigned>();
+            }
+            auto format = json_definition.find("format");
+            if (format != json_definition.end())
+                definition.format =
+                    format_from_name(format->get<std::string>(), false);
+            add_texture(d, d.strings.intern(json_texture.key()), definition);
+        }
+    }
+
+    auto json_buffers = j.find("buffers");
+    if (json_buffers != j.end()) {
+        auto json_buffer = json_buffers->begin();
+        for (; json_buffer != json_buffers->end(); ++json_buffer)
+            d.buffers.add(
+                d.strings.intern(json_buffer.key()),
+                json_buffer.value().at("size").get<uint32_t>()
+            );
+    }
 
-    auto json_call = actions.begin();
-    auto call = d.view_actions.begin();
+    auto json_frame_actions = j.find("frame_actions");
+    if (json_frame_actions != j.end())
+        for (const auto& json_action : *json_frame_actions)
+            add_frame_action(d, json_action);
+
+    auto& actions = j.at("view_actions");
+    d.view_actions.reserve(actions.size());
 
     for (auto& json_call : actions) {
         auto type = json_call.at("type").get<std::string>();
 
         if (type == "program") {
-            auto action = std::make_unique<program_action>();
-
             auto& shaders = json_call.at("shaders");
+            auto uniforms = add_uniforms(d, json_call);
 
-            action->vertex_shader = shaders.at("vertex").get<std::string>();
-            action->fragment_shader = shaders.at("fragment").get<std::string>();
-            action->viewport_width = 1280;
-            action->viewport_height = 720;
-            action->vertex_count =
-                json_call.at("vertex_count").get<int>();
-            action->out.push_back({"outColor", 0});
-
-            auto json_uniforms = json_call.find("uniforms");
-            if (json_uniforms != json_call.end()) {
-                action->uniforms.resize(json_uniforms->size());
-
-                // object iteration not supported with this version of nlohmann
-                auto uniform = action->uniforms.begin();
-                auto json_uniform = json_uniforms->begin();
-                for (
-                    ; json_uniform != json_uniforms->end();
-                    ++json_uniform, ++uniform
-                ) {
-                    uniform->first = json_uniform.key();
-                    uniform->second = from_json(json_uniform.value());
+            // ins may also name mesh attributes, outs are textures
+            auto json_ins = json_call.find("in");
+            range ins = json_ins == json_call.end() ?
+                range{static_cast<uint32_t>(d.bindings.names.size()), 0} :
+                add_bindings(d, *json_ins);
+            auto json_outs = json_call.find("out");
+            range outs = json_outs == json_call.end() ?
+                default_outs(d) : add_bindings(d, *json_outs);
+
+            d.add_program(
+                d.strings.intern(shaders.at("vertex").get<std::string>()),
+                d.strings.intern(shaders.at("fragment").get<std::string>()),
+                1280, 720, json_call.at("vertex_count").get<int>(),
+                uniforms, ins, outs
+            );
+
+        } else if (type == "blit") {
+            d.add_blit(
+                d.strings.intern(json_call.at("source").get<std::string>()),
+                d.strings.intern(
+                    json_call.at("destination").get<std::string>()
+                )
+            );
+
+        } else if (type == "compute") {
+            auto uniforms = add_uniforms(d, json_call);
+            auto json_ins = json_call.find("in");
+            range ins = json_ins == json_call.end() ?
+                range{static_cast<uint32_t>(d.bindings.names.size()), 0} :
+                add_bindings(d, *json_ins);
+            auto json_outs = json_call.find("out");
+            range outs = json_outs == json_call.end() ?
+                range{static_cast<uint32_t>(d.bindings.names.size()), 0} :
+                add_bindings(d, *json_outs);
+
+            // either the name of a texture or up to three sizes
+            auto& dispatch = json_call.at("dispatch");
+            unsigned sizes[] = {1, 1, 1};
+            string_id size_name = -1u;
+            if (dispatch.is_string()) {
+                size_name = d.strings.intern(dispatch.get<std::string>());
+            } else {
+                for (auto i = 0u; i < 3 && i < dispatch.size(); i++) {
+                    auto& json_size = dispatch.at(i);
+                    sizes[i] = json_size.is_string() ?
+                        texture_size_from_name(
+                            json_size.get<std::string>(), i
+                        ) :
+                        json_size.get<unsigned>();
                 }
             }
 
-            *call = std::move(action);
+            d.add_compute(
+                d.strings.intern(json_call.at("shader").get<std::string>()),
+                sizes[0], sizes[1], sizes[2], size_name,
+                json_call.value("async", false), uniforms, ins, outs
+            );
 
-        } else if (type == "blit") {
-            auto action = std::make_unique<blit_action>();
+        } else {
+            throw std::runtime_error("unsupported type");
+        }
+    }
 
+    resolve_bindings(d);
+    return d;
+}
 
+// builds the document while the parser emits tokens, no DOM is created and
+// uniforms go straight into the uniform table
+struct document_sax_handler : nlohmann::json_sax<nlohmann::json> {
+    enum struct context {
+        root, ignored, view_actions, action, shaders, uniforms,
+        uniform_vector, bindings, textures, texture, texture_size,
+        dispatch_size, buffers, buffer, meshes, mesh, mesh_attribute,
+        frame_actions, frame_action, animation_parameters,
+    };
 
-            *call = std::move(action);
+    document& document;
+    std::vector<context> contexts;
+    // reused, so that keys don't allocate after the first few
+    std::string key_name;
 
+    std::string type;
+    string_id shaders[2];
+    bool has_shaders[2], has_vertex_count;
+    // source and destination of blits
+    string_id blit_textures[2];
+    bool has_blit_textures[2];
+    // of compute actions, the dispatch is either sized or a texture name
+    string_id compute_shader, dispatch_name;
+    unsigned dispatch[3];
+    bool has_compute_shader, has_dispatch, async;
+    unsigned vertex_count;
+    range uniforms;
+    unsigned vector_index;
+    uint32_t first_binding;
+    range ins, outs;
+    range* bindings;
+    bool has_outs;
+    string_id texture_name;
+    texture_definition texture;
+    unsigned size_index;
+    string_id buffer_name;
+    uint32_t buffer_size;
+    string_id mesh_name, mesh_file_name;
+    bool has_mesh_file_name;
+    range mesh_attributes;
+    mesh_source attribute_source;
+    string_id attribute_name;
+    format attribute_format;
+    bool has_attribute_name, has_attribute_format;
+    // of animate frame actions, the array being read goes into
+    // parameter_values and parameter_range
+    string_id animation_uniform;
+    built_in_variables animation_source;
+    animation_function function;
+    float frequency, phase;
+    range scales, offsets, keys, key_values;
+    bool has_animation_uniform, has_function;
+    std::vector<float>* parameter_values;
+    range* parameter_range;
+    std::string error;
+
+    document_sax_handler(::document& document) : document(document) {}
+
+    context top() const {
+        return contexts.empty() ? context::ignored : contexts.back();
+    }
+
+    void begin_action() {
+        type.clear();
+        uniforms = {static_cast<uint32_t>(document.uniforms.size()), 0};
+        first_binding = static_cast<uint32_t>(document.bindings.names.size());
+        ins = outs = {first_binding, 0};
+        has_shaders[0] = has_shaders[1] = has_vertex_count = false;
+        has_blit_textures[0] = has_blit_textures[1] = false;
+        has_compute_shader = has_dispatch = async = false;
+        dispatch_name = -1u;
+        dispatch[0] = dispatch[1] = dispatch[2] = 1;
+        has_outs = false;
+    }
+
+    void end_action() {
+        if (type == "program") {
+            if (!has_shaders[0] || !has_shaders[1] || !has_vertex_count)
+                throw std::runtime_error("incomplete program action");
+            if (!has_outs)
+                outs = default_outs(document);
+            document.add_program(
+                shaders[0], shaders[1], 1280, 720, vertex_count,
+                uniforms, ins, outs
+            );
+        } else if (type == "blit") {
+            if (!has_blit_textures[0] || !has_blit_textures[1])
+                throw std::runtime_error("incomplete blit action");
+            // uniforms and bindings of other action types are ignored
+            document.uniforms.truncate(uniforms.first);
+            document.bindings.truncate(first_binding);
+            document.add_blit(blit_textures[0], blit_textures[1]);
+        } else if (type == "compute") {
+            if (!has_compute_shader || !has_dispatch)
+                throw std::runtime_error("incomplete compute action");
+            document.add_compute(
+                compute_shader, dispatch[0], dispatch[1], dispatch[2],
+                dispatch_name, async, uniforms, ins, outs
+            );
         } else {
             throw std::runtime_error("unsupported type");
         }
+    }
 
-        ++call;
+    void begin_frame_action() {
+        type.clear();
+        animation_source = elapsed_time;
+        frequency = 1;
+        phase = 0;
+        auto& animations = document.animations;
+        scales = offsets = key_values = {
+            static_cast<uint32_t>(animations.parameters.size()), 0
+        };
+        keys = {static_cast<uint32_t>(animations.key_times.size()), 0};
+        has_animation_uniform = has_function = false;
     }
 
+    void end_frame_action() {
+        if (type != "animate")
+            throw std::runtime_error("unsupported frame action type");
+        if (!has_animation_uniform)
+            throw std::runtime_error("incomplete animate action");
+        auto& parameters = document.animations.parameters;
+        for (auto [parameter, value] : {
+            std::pair{&scales, 1.0f}, std::pair{&offsets, 0.0f}
+        }) {
+            if (parameter->count == 0) {
+                *parameter = {static_cast<uint32_t>(parameters.size()), 1};
+                parameters.push_back(value);
+            }
+        }
+        if (!has_function)
+            function = keys.count > 0 ?
+                animation_function::keyframes : animation_function::linear;
+        document.animations.add(
+            animation_uniform, animation_source, function, frequency, phase,
+            scales, offsets, keys, key_values
+        );
+    }
+
+    void end_mesh_attribute() {
+        if (!has_attribute_name || !has_attribute_format)
+            throw std::runtime_error("incomplete mesh attribute");
+        document.meshes.add_attribute(
+            attribute_name, attribute_source, attribute_format
+        );
+        mesh_attributes.count++;
+    }
+
+    void end_mesh() {
+        if (!has_mesh_file_name)
+            throw std::runtime_error("incomplete mesh");
+        document.meshes.add(mesh_name, mesh_file_name, mesh_attributes);
+    }
+
+    bool number(double value, bool is_float) {
+        if (top() == context::texture_size) {
+            if (size_index < 3) {
+                unsigned* sizes[] = {
+                    &texture.width, &texture.height, &texture.depth
+                };
+                *sizes[size_index++] = unsigned(value);
+            }
+        } else if (top() == context::dispatch_size) {
+            if (size_index < 3)
+                dispatch[size_index++] = unsigned(value);
+        } else if (top() == context::buffer && key_name == "size") {
+            buffer_size = uint32_t(value);
+        } else if (top() == context::uniforms) {
+            if (!is_float)
+                throw std::runtime_error("Unknown uniform type");
+            document.uniforms.add(
+                document.strings.intern(key_name), float(value)
+            );
+            uniforms.count++;
+        } else if (top() == context::uniform_vector) {
+            if (vector_index >= 4)
+                throw std::runtime_error(
+                    "Vectors and matrices larger than 4 not supported"
+                );
+            auto& values = document.uniforms.values;
+            values[values.size() - 4 + vector_index++] = float(value);
+        } else if (top() == context::action && key_name == "vertex_count") {
+            vertex_count = unsigned(value);
+            has_vertex_count = true;
+        } else if (top() == context::animation_parameters) {
+            parameter_values->push_back(float(value));
+            parameter_range->count++;
+        } else if (top() == context::frame_action) {
+            if (key_name == "frequency") {
+                frequency = float(value);
+            } else if (key_name == "phase") {
+                phase = float(value);
+            } else if (key_name == "scale" || key_name == "offset") {
+                auto& parameters = document.animations.parameters;
+                (key_name == "scale" ? scales : offsets) = {
+                    static_cast<uint32_t>(parameters.size()), 1
+                };
+                parameters.push_back(float(value));
+            }
+        }
+        return true;
+    }
+
+    bool null() override {
+        return true;
+    }
+    bool boolean(bool value) override {
+        if (top() == context::action && key_name == "async")
+            async = value;
+        return true;
+    }
+    bool number_integer(number_integer_t value) override {
+        return number(double(value), false);
+    }
+    bool number_unsigned(number_unsigned_t value) override {
+        return number(double(value), false);
+    }
+    bool number_float(number_float_t value, const string_t&) override {
+        return number(value, true);
+    }
+    bool string(string_t& value) override {
+        if (top() == context::bindings) {
+            document.bindings.add(
+                document.strings.intern(key_name),
+                document.strings.intern(value), no_texture
+            );
+            bindings->count++;
+        } else if (top() == context::texture_size) {
+            if (size_index < 3) {
+                unsigned* sizes[] = {
+                    &texture.width, &texture.height, &texture.depth
+                };
+                *sizes[size_index] = texture_size_from_name(value, size_index);
+                size_index++;
+            }
+        } else if (top() == context::dispatch_size) {
+            if (size_index < 3) {
+                dispatch[size_index] =
+                    texture_size_from_name(value, size_index);
+                size_index++;
+            }
+        } else if (top() == context::texture && key_name == "format") {
+            texture.format = format_from_name(value, false);
+        } else if (top() == context::mesh && key_name == "file_name") {
+            mesh_file_name = document.strings.intern(value);
+            has_mesh_file_name = true;
+        } else if (top() == context::mesh_attribute && key_name == "name") {
+            attribute_name = document.strings.intern(value);
+            has_attribute_name = true;
+        } else if (
+            top() == context::mesh_attribute && key_name == "format"
+        ) {
+            attribute_format = format_from_name(value, true);
+            has_attribute_format = true;
+        } else if (top() == context::action && key_name == "type") {
+            type = std::move(value);
+        } else if (top() == context::action && key_name == "source") {
+            blit_textures[0] = document.strings.intern(value);
+            has_blit_textures[0] = true;
+        } else if (top() == context::action && key_name == "destination") {
+            blit_textures[1] = document.strings.intern(value);
+            has_blit_textures[1] = true;
+        } else if (top() == context::action && key_name == "shader") {
+            compute_shader = document.strings.intern(value);
+            has_compute_shader = true;
+        } else if (top() == context::action && key_name == "dispatch") {
+            dispatch_name = document.strings.intern(value);
+            has_dispatch = true;
+        } else if (top() == context::frame_action && key_name == "type") {
+            type = std::move(value);
+        } else if (top() == context::frame_action && key_name == "uniform") {
+            animation_uniform = document.strings.intern(value);
+            has_animation_uniform = true;
+        } else if (top() == context::frame_action && key_name == "source") {
+            animation_source = built_in_variable_from_name(value);
+        } else if (
+            top() == context::frame_action && key_name == "function"
+        ) {
+            function = animation_function_from_name(value);
+            has_function = true;
+        } else if (top() == context::shaders && key_name == "vertex") {
+            shaders[0] = document.strings.intern(value);
+            has_shaders[0] = true;
+        } else if (top() == context::shaders && key_name == "fragment") {
+            shaders[1] = document.strings.intern(value);
+            has_shaders[1] = true;
+        } else if (
+            top() == context::uniforms || top() == context::uniform_vector
+        ) {
+            throw std::runtime_error("Unknown uniform type");
+        }
+        return true;
+    }
+    bool binary(binary_t&) override {
+        return true;
+    }
+
+    bool start_object(std::size_t) override {
+        auto parent = top();
+        if (contexts.empty()) {
+            contexts.push_back(context::root);
+        } else if (parent == context::view_actions) {
+            begin_action();
+            contexts.push_back(context::action);
+        } else if (parent == context::frame_actions) {
+            begin_frame_action();
+            contexts.push_back(context::frame_action);
+        } else if (parent == context::action && key_name == "shaders") {
+            contexts.push_back(context::shaders);
+        } else if (parent == context::action && key_name == "uniforms") {
+            contexts.push_back(context::uniforms);
+        } else if (
+            parent == context::action &&
+            (key_name == "in" || key_name == "out")
+        ) {
+            // the bindings of an action are contiguous
+            auto binding_count =
+                static_cast<uint32_t>(document.bindings.names.size());
+            if (key_name == "out") {
+                has_outs = true;
+                bindings = &outs;
+            } else {
+                bindings = &ins;
+            }
+            *bindings = {binding_count, 0};
+            contexts.push_back(context::bindings);
+        } else if (parent == context::root && key_name == "textures") {
+            contexts.push_back(context::textures);
+        } else if (parent == context::textures) {
+            texture_name = document.strings.intern(key_name);
+            texture = default_texture;
+            contexts.push_back(context::texture);
+        } else if (parent == context::root && key_name == "meshes") {
+            contexts.push_back(context::meshes);
+        } else if (parent == context::meshes) {
+            mesh_name = document.strings.intern(key_name);
+            has_mesh_file_name = false;
+            mesh_attributes = {
+                static_cast<uint32_t>(document.meshes.attribute_names.size()),
+                0
+            };
+            contexts.push_back(context::mesh);
+        } else if (
+            parent == context::mesh &&
+            mesh_source_from_name(key_name, attribute_source)
+        ) {
+            has_attribute_name = has_attribute_format = false;
+            contexts.push_back(context::mesh_attribute);
+        } else if (parent == context::root && key_name == "buffers") {
+            contexts.push_back(context::buffers);
+        } else if (parent == context::buffers) {
+            buffer_name = document.strings.intern(key_name);
+            buffer_size = 0;
+            contexts.push_back(context::buffer);
+        } else if (
+            parent == context::uniforms || parent == context::uniform_vector
+        ) {
+            throw std::runtime_error("Unknown uniform type");
+        } else {
+            contexts.push_back(context::ignored);
+        }
+        return true;
+    }
+    bool key(string_t& value) override {
+        key_name = value;
+        return true;
+    }
+    bool end_object() override {
+        if (top() == context::action)
+            end_action();
+        else if (top() == context::frame_action)
+            end_frame_action();
+        else if (top() == context::texture)
+            add_texture(document, texture_name, texture);
+        else if (top() == context::buffer)
+            document.buffers.add(buffer_name, buffer_size);
+        else if (top() == context::mesh_attribute)
+            end_mesh_attribute();
+        else if (top() == context::mesh)
+            end_mesh();
+        contexts.pop_back();
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        auto parent = top();
+        if (parent == context::root && key_name == "view_actions") {
+            contexts.push_back(context::view_actions);
+        } else if (parent == context::root && key_name == "frame_actions") {
+            contexts.push_back(context::frame_actions);
+        } else if (
+            parent == context::frame_action && (
+                key_name == "scale" || key_name == "offset" ||
+                key_name == "key_times" || key_name == "key_values"
+            )
+        ) {
+            auto& animations = document.animations;
+            if (key_name == "key_times") {
+                parameter_values = &animations.key_times;
+                parameter_range = &keys;
+            } else {
+                parameter_values = &animations.parameters;
+                parameter_range =
+                    key_name == "scale" ? &scales :
+                    key_name == "offset" ? &offsets :
+                    &key_values;
+            }
+            *parameter_range = {
+                static_cast<uint32_t>(parameter_values->size()), 0
+            };
+            contexts.push_back(context::animation_parameters);
+        } else if (parent == context::animation_parameters) {
+            throw std::runtime_error("Animation parameters are flat arrays");
+        } else if (parent == context::texture && key_name == "size") {
+            size_index = 0;
+            contexts.push_back(context::texture_size);
+        } else if (parent == context::action && key_name == "dispatch") {
+            size_index = 0;
+            has_dispatch = true;
+            contexts.push_back(context::dispatch_size);
+        } else if (parent == context::uniforms) {
+            document.uniforms.add(
+                document.strings.intern(key_name), glm::vec4(0.0)
+            );
+            uniforms.count++;
+            vector_index = 0;
+            contexts.push_back(context::uniform_vector);
+        } else if (parent == context::uniform_vector) {
+            throw std::runtime_error(
+                "Matrices larger than 4 not supported"
+            );
+        } else {
+            contexts.push_back(context::ignored);
+        }
+        return true;
+    }
+    bool end_array() override {
+        contexts.pop_back();
+        return true;
+    }
+
+    bool parse_error(
+        std::size_t, const std::string&,
+        const nlohmann::detail::exception& exception
+    ) override {
+        error = exception.what();
+        return false;
+    }
+};
+
+document from_file(const char* file_name) {
+    INSTRUMENT_SCOPE("from_file");
+    // the parser reads straight from the mapping, the file isn't copied
+    mapped_file file(file_name);
+    auto directory = std::filesystem::path(file_name).parent_path();
+    if (is_binary_document(file)) {
+        auto d = from_binary(file);
+        d.directory = directory.string();
+        return d;
+    }
+
+    auto begin = reinterpret_cast<const char*>(file.data());
+
+    document d;
+    document_sax_handler handler(d);
+    if (!nlohmann::json::sax_parse(begin, begin + file.size(), &handler))
+        throw std::runtime_error(handler.error);
+    resolve_bindings(d);
+    d.directory = directory.string();
     return d;
 }
+
+std::string referenced_file_name(const document& document, string_id name) {
+    return (
+        std::filesystem::path(document.directory) / document.strings[name]
+    ).string();
+}
+
+struct to_json_functor {
+    nlohmann::json operator()(const float& value) const {
+        return value;
+    }
+    nlohmann::json operator()(const glm::vec4& value) const {
+        return {value[0], value[1], value[2], value[3]};
+    }
+    nlohmann::json operator()(const glm::mat4& value) const {
+        auto json = nlohmann::json::array();
+        for (auto i = 0; i < 4; i++)
+            json.push_back(operator()(value[i]));
+        return json;
+    }
+};
+
+static nlohmann::json to_json(const document& document, range bindings) {
+    auto json = nlohmann::json::object();
+    for (auto i = bindings.first; i < bindings.first + bindings.count; i++)
+        json[std::string(document.strings[document.bindings.names[i]])] =
+            document.strings[document.bindings.values[i]];
+    return json;
+}
+
+static nlohmann::json uniforms_to_json(
+    const document& document, range uniforms
+) {
+    auto json = nlohmann::json::object();
+    for (auto i = uniforms.first; i < uniforms.first + uniforms.count; i++) {
+        auto name = document.strings[document.uniforms.names[i]];
+        json[std::string(name)] =
+            std::visit(to_json_functor{}, document.uniforms.get(i));
+    }
+    return json;
+}
+
+// writes the actions in document order
+struct to_json_visitor {
+    const document& document;
+    nlohmann::json& actions;
+
+    void program(uint32_t index) {
+        auto& programs = document.programs;
+        auto uniforms = uniforms_to_json(document, programs.uniforms[index]);
+        actions.push_back({
+            {"type", "program"},
+            {"shaders", {
+                {"vertex", document.strings[programs.vertex_shaders[index]]},
+                {
+                    "fragment",
+                    document.strings[programs.fragment_shaders[index]]
+                },
+            }},
+            {"vertex_count", programs.vertex_counts[index]},
+            {"in", to_json(document, programs.ins[index])},
+            {"out", to_json(document, programs.outs[index])},
+            {"uniforms", uniforms},
+        });
+    }
+    void blit(uint32_t index) {
+        actions.push_back({
+            {"type", "blit"},
+            {"source", document.strings[document.blits.source_names[index]]},
+            {
+                "destination",
+                document.strings[document.blits.destination_names[index]]
+            },
+        });
+    }
+    void compute(uint32_t index) {
+        auto& computes = document.computes;
+        nlohmann::json dispatch;
+        if (computes.size_names[index] != -1u) {
+            dispatch = document.strings[computes.size_names[index]];
+        } else {
+            unsigned sizes[] = {
+                computes.widths[index], computes.heights[index],
+                computes.depths[index],
+            };
+            for (auto i = 0u; i < 3; i++) {
+                if (i < 2 && sizes[i] == 0)
+                    dispatch.push_back(window_size_names[i]);
+                else
+                    dispatch.push_back(sizes[i]);
+            }
+        }
+        actions.push_back({
+            {"type", "compute"},
+            {"shader", document.strings[computes.shaders[index]]},
+            {"dispatch", dispatch},
+            {"async", computes.async[index] != 0},
+            {"in", to_json(document, computes.ins[index])},
+            {"out", to_json(document, computes.outs[index])},
+            {"uniforms", uniforms_to_json(document, computes.uniforms[index])},
+        });
+    }
+};
+
+void to_json_file(const document& document, const char* file_name) {
+    nlohmann::json json;
+
+    auto& meshes = json["meshes"] = nlohmann::json::object();
+    for (size_t i = 0; i < document.meshes.size(); i++) {
+        auto& mesh = meshes[std::string(
+            document.strings[document.meshes.names[i]]
+        )] = {
+            {"file_name", document.strings[document.meshes.file_names[i]]},
+        };
+        auto attributes = document.meshes.attributes[i];
+        auto end = attributes.first + attributes.count;
+        for (auto j = attributes.first; j < end; j++) {
+            auto source = document.meshes.attribute_sources[j];
+            auto format = document.meshes.attribute_formats[j];
+            mesh[mesh_source_names[static_cast<int>(source)]] = {
+                {
+                    "name",
+                    document.strings[document.meshes.attribute_names[j]]
+                },
+                {"format", format_names[static_cast<int>(format)]},
+            };
+        }
+    }
+
+    auto& textures = json["textures"] = nlohmann::json::object();
+    for (size_t i = 0; i < document.textures.size(); i++) {
+        auto& definition = document.textures.definitions[i];
+        auto size = nlohmann::json::array();
+        for (auto j = 0u; j < 2; j++) {
+            auto value = j == 0 ? definition.width : definition.height;
+            if (value == 0)
+                size.push_back(window_size_names[j]);
+            else
+                size.push_back(value);
+        }
+        size.push_back(definition.depth);
+        textures[std::string(document.strings[document.textures.names[i]])] = {
+            {"size", size},
+            {"format", format_names[static_cast<int>(definition.format)]},
+        };
+    }
+    auto& buffers = json["buffers"] = nlohmann::json::object();
+    for (size_t i = 0; i < document.buffers.size(); i++)
+        buffers[std::string(document.strings[document.buffers.names[i]])] = {
+            {"size", document.buffers.sizes[i]},
+        };
+    auto& frame_actions = json["frame_actions"] = nlohmann::json::array();
+    auto& animations = document.animations;
+    auto floats = [](const std::vector<float>& values, range range) {
+        auto begin = values.begin() + range.first;
+        if (range.count == 1)
+            return nlohmann::json(*begin);
+        return nlohmann::json(std::vector<float>(begin, begin + range.count));
+    };
+    for (size_t i = 0; i < animations.size(); i++) {
+        auto function = animations.functions[i];
+        auto& action = frame_actions.emplace_back(nlohmann::json{
+            {"type", "animate"},
+            {
+                "uniform",
+                document.strings[animations.uniform_names[i]]
+            },
+            {"source", built_in_variable_names[animations.sources[i]]},
+            {
+                "function",
+                animation_function_names[static_cast<int>(function)]
+            },
+            {"frequency", animations.frequencies[i]},
+            {"phase", animations.phases[i]},
+            {"scale", floats(animations.parameters, animations.scales[i])},
+            {"offset", floats(animations.parameters, animations.offsets[i])},
+        });
+        if (function == animation_function::keyframes) {
+            auto keys = animations.keys[i];
+            auto times = animations.key_times.begin() + keys.first;
+            action["key_times"] = std::vector<float>(
+                times, times + keys.count
+            );
+            auto values = animations.key_values[i];
+            auto begin = animations.parameters.begin() + values.first;
+            action["key_values"] = std::vector<float>(
+                begin, begin + values.count
+            );
+        }
+    }
+
+    auto& actions = json["view_actions"] = nlohmann::json::array();
+    visit_view_actions(document, to_json_visitor{document, actions});
+
+    std::ofstream file(file_name);
+    if (!(file << json.dump(4) << std::endl))
+        throw std::runtime_error(
+            std::string("Couldn't write ") + file_name
+        );
+}
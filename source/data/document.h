@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <utility>
@@ -11,11 +14,16 @@
 
 enum built_in_textures : unsigned {
     built_in_window = 1024,
+    // bindings of names that aren't textures, like mesh attributes
+    no_texture = ~0u,
 };
 
+// matrices are 16 floats, column after column
 enum built_in_variables : unsigned {
     window_width, window_height,
     view_matrix, projection_matrix,
+    // seconds since the document was first shown
+    elapsed_time,
 };
 
 enum struct format {
@@ -23,6 +31,8 @@ enum struct format {
     a2b10g10r10_snorm_pack32,
     r8g8b8a8_unorm,
     b8g8r8a8_srgb,
+    // only for mesh attributes
+    r8g8b8_snorm,
 };
 
 enum struct texture_usage : unsigned {
@@ -31,6 +41,7 @@ enum struct texture_usage : unsigned {
     compute,
 };
 
+// a width or height of 0 follows the size of the window
 struct texture_definition {
     unsigned width, height, depth;
     format format;
@@ -42,30 +53,341 @@ typedef std::variant<
 
 std::pair<const void*, unsigned> get_data_pointer(const uniform_value& value);
 
-struct program_action {
-    std::vector<std::pair<std::string, uniform_value>> uniforms;
+typedef uint32_t string_id;
 
-    std::string vertex_shader, fragment_shader;
-    std::vector<std::pair<std::string, unsigned>> in;
-    std::vector<std::pair<std::string, unsigned>> out;
-    unsigned viewport_width, viewport_height;
-    unsigned vertex_count;
+// interned strings, equal strings share one id, views stay valid as the
+// characters live in chunks that are never reallocated
+struct string_pool {
+    string_id intern(std::string_view string);
+    // -1u if the string wasn't interned
+    string_id find(std::string_view string) const;
+
+    std::string_view operator[] (string_id id) const {
+        return strings[id];
+    }
+    size_t size() const {
+        return strings.size();
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunk_size = 0, chunk_used = 0;
+    std::vector<std::string_view> strings;
+    std::unordered_map<std::string_view, string_id> ids;
 };
 
-struct blit_action {
-    unsigned source_texture;
-    unsigned destination_texture;
+// first element and count in one of the tables of a document
+struct range {
+    uint32_t first, count;
 };
 
-typedef std::variant<
-    std::unique_ptr<program_action>, std::unique_ptr<blit_action>
-> action;
+// same order as the alternatives of uniform_value
+enum struct uniform_type : uint8_t {
+    scalar, vector, matrix,
+};
+
+// uniforms of all actions, values are packed into one block of floats
+struct uniform_table {
+    uint32_t add(string_id name, const uniform_value& value);
+    uniform_value get(uint32_t index) const;
+    void set(uint32_t index, const uniform_value& value);
+
+    const float* data(uint32_t index) const {
+        return values.data() + offsets[index];
+    }
+    // in bytes
+    unsigned data_size(uint32_t index) const;
+    size_t size() const {
+        return names.size();
+    }
+    // removes the uniforms from index on
+    void truncate(uint32_t index);
+
+    std::vector<string_id> names;
+    std::vector<uniform_type> types;
+    // in floats
+    std::vector<uint32_t> offsets;
+    std::vector<float> values;
+};
+
+// textures are referenced by their index in the table or built_in_window
+struct texture_table {
+    uint32_t add(string_id name, const texture_definition& definition) {
+        names.push_back(name);
+        definitions.push_back(definition);
+        return static_cast<uint32_t>(names.size() - 1);
+    }
+    // the built in texture or index of the texture named name, no_texture
+    // if there's none
+    unsigned find(std::string_view name, const string_pool& strings) const;
+    size_t size() const {
+        return names.size();
+    }
+
+    std::vector<string_id> names;
+    std::vector<texture_definition> definitions;
+};
+
+// bindings of names that aren't buffers
+inline constexpr unsigned no_buffer = ~0u;
+
+// storage buffers of compute actions, their content is kept over frames
+struct buffer_table {
+    uint32_t add(string_id name, uint32_t size) {
+        names.push_back(name);
+        sizes.push_back(size);
+        return static_cast<uint32_t>(names.size() - 1);
+    }
+    // index of the buffer named name, no_buffer if there's none
+    unsigned find(std::string_view name, const string_pool& strings) const;
+    size_t size() const {
+        return names.size();
+    }
+
+    std::vector<string_id> names;
+    // in bytes
+    std::vector<uint32_t> sizes;
+};
+
+// where the values of a mesh attribute come from in its file, there is one
+// value per vertex of every face
+enum struct mesh_source : uint8_t {
+    position, normal, texture_coordinate,
+};
+
+// bindings of names that aren't mesh attributes
+inline constexpr unsigned no_attribute = ~0u;
+// programs that don't draw a mesh
+inline constexpr unsigned no_mesh = ~0u;
+
+// meshes are loaded from OBJ files, the ins of programs bind their
+// attributes by name, each mesh has a contiguous range of attributes
+struct mesh_table {
+    // the attributes of the range have to be added first
+    uint32_t add(string_id name, string_id file_name, range attributes) {
+        names.push_back(name);
+        file_names.push_back(file_name);
+        this->attributes.push_back(attributes);
+        return static_cast<uint32_t>(names.size() - 1);
+    }
+    // belongs to the next mesh added
+    uint32_t add_attribute(string_id name, mesh_source source, format format) {
+        attribute_names.push_back(name);
+        attribute_sources.push_back(source);
+        attribute_formats.push_back(format);
+        attribute_meshes.push_back(static_cast<uint32_t>(names.size()));
+        return static_cast<uint32_t>(attribute_names.size() - 1);
+    }
+    // index of the attribute named name, no_attribute if there's none
+    unsigned find_attribute(
+        std::string_view name, const string_pool& strings
+    ) const;
+    size_t size() const {
+        return names.size();
+    }
+
+    std::vector<string_id> names, file_names;
+    // ranges in the attribute arrays
+    std::vector<range> attributes;
+
+    // one entry per attribute of all meshes
+    std::vector<string_id> attribute_names;
+    std::vector<mesh_source> attribute_sources;
+    // packed formats the values are quantized to
+    std::vector<format> attribute_formats;
+    std::vector<uint32_t> attribute_meshes;
+};
+
+// named texture, buffer and mesh attribute references of actions
+struct binding_table {
+    uint32_t add(string_id name, string_id value, unsigned texture) {
+        names.push_back(name);
+        values.push_back(value);
+        textures.push_back(texture);
+        buffers.push_back(no_buffer);
+        attributes.push_back(no_attribute);
+        return static_cast<uint32_t>(names.size() - 1);
+    }
+    // removes the bindings from index on
+    void truncate(uint32_t index) {
+        names.resize(std::min<size_t>(index, names.size()));
+        values.resize(names.size());
+        textures.resize(names.size());
+        buffers.resize(names.size());
+        attributes.resize(names.size());
+    }
+
+    std::vector<string_id> names;
+    // what the document binds, a texture, a buffer or a mesh attribute
+    std::vector<string_id> values;
+    // index of the texture named by value or no_texture
+    std::vector<unsigned> textures;
+    // index of the buffer named by value or no_buffer
+    std::vector<unsigned> buffers;
+    // index of the mesh attribute named by value if it's neither a texture
+    // nor a buffer, otherwise no_attribute
+    std::vector<unsigned> attributes;
+};
+
+// what animate frame actions apply to frequency * source + phase,
+// keyframes are interpolated linearly and repeat after the last key
+enum struct animation_function : uint8_t {
+    linear, sine, keyframes,
+};
+
+// the animate frame actions, they set every uniform of a name to
+// offset + scale * function(frequency * source + phase) before each frame,
+// the components of vectors and matrices separately, the uniforms keep the
+// type of their value in the view actions
+struct animation_table {
+    // the parameters of the ranges have to be added first
+    uint32_t add(
+        string_id uniform_name, built_in_variables source,
+        animation_function function, float frequency, float phase,
+        range scales, range offsets, range keys, range key_values
+    );
+    size_t size() const {
+        return uniform_names.size();
+    }
+
+    std::vector<string_id> uniform_names;
+    std::vector<built_in_variables> sources;
+    std::vector<animation_function> functions;
+    std::vector<float> frequencies, phases;
+    // ranges in parameters, one value per component, missing components
+    // repeat the last value
+    std::vector<range> scales, offsets;
+    // ranges in key_times and parameters, every key has the same number
+    // of values, which are components as for scales
+    std::vector<range> keys, key_values;
+    std::vector<float> key_times, parameters;
+};
+
+// one entry per action in each array
+struct program_actions {
+    size_t size() const {
+        return vertex_shaders.size();
+    }
+
+    std::vector<string_id> vertex_shaders, fragment_shaders;
+    std::vector<unsigned> viewport_widths, viewport_heights;
+    // ignored for programs that draw a mesh, which draw all its triangles
+    std::vector<unsigned> vertex_counts;
+    // ranges in document::uniforms and document::bindings
+    std::vector<range> uniforms, ins, outs;
+    // mesh whose attributes the ins bind, resolved once the document is
+    // parsed, no_mesh if they bind none
+    std::vector<unsigned> meshes;
+};
+
+struct blit_actions {
+    size_t size() const {
+        return source_textures.size();
+    }
+
+    // names of the textures as in the document
+    std::vector<string_id> source_names, destination_names;
+    // indices in document::textures, the window can't be blitted
+    std::vector<unsigned> source_textures;
+    std::vector<unsigned> destination_textures;
+};
 
+struct compute_actions {
+    size_t size() const {
+        return shaders.size();
+    }
+
+    std::vector<string_id> shaders;
+    // invocations in each dimension, 0 follows the size of the window
+    std::vector<unsigned> widths, heights, depths;
+    // texture whose size is dispatched instead, -1u if the size is given
+    std::vector<string_id> size_names;
+    // resolved from size_names, no_texture if the size is given
+    std::vector<unsigned> size_textures;
+    // non zero to run on a compute queue next to graphics, where the device
+    // has one
+    std::vector<uint8_t> async;
+    // ranges in document::uniforms and document::bindings, storage images
+    // and buffers, outs may also be read
+    std::vector<range> uniforms, ins, outs;
+};
+
+enum struct action_type : uint32_t {
+    program, blit, compute,
+};
+
+// index into the arrays of the type
+struct action {
+    action_type type;
+    uint32_t index;
+};
+
+// actions are stored as structure of arrays per type, so that walking them
+// doesn't chase pointers
 struct document {
-    std::unordered_map<std::string, texture_definition> textures;
+    string_pool strings;
+    texture_table textures;
+    buffer_table buffers;
+    mesh_table meshes;
+
+    // in document order
     std::vector<action> view_actions;
+    program_actions programs;
+    blit_actions blits;
+    compute_actions computes;
+    uniform_table uniforms;
+    binding_table bindings;
+    // run before the view actions of every frame, on the cpu
+    animation_table animations;
+
+    unsigned display_texture = 0;
+    // of the file the document was loaded from, empty for the working
+    // directory, shader and mesh file names are relative to it
+    std::string directory;
 
-    unsigned display_texture;
+    // the uniforms and bindings of the ranges have to be added first
+    void add_program(
+        string_id vertex_shader, string_id fragment_shader,
+        unsigned viewport_width, unsigned viewport_height,
+        unsigned vertex_count, range uniforms, range ins, range outs
+    );
+    // textures are resolved once the document is parsed
+    void add_blit(string_id source, string_id destination);
+    // size_name is -1u or a texture, resolved once the document is parsed
+    void add_compute(
+        string_id shader, unsigned width, unsigned height, unsigned depth,
+        string_id size_name, bool async, range uniforms, range ins,
+        range outs
+    );
 };
 
+// calls visitor.program(index), visitor.blit(index) or
+// visitor.compute(index) for every view action in document order
+template<typename visitor_type>
+void visit_view_actions(const document& document, visitor_type&& visitor) {
+    for (auto action : document.view_actions) {
+        switch (action.type) {
+        case action_type::program:
+            visitor.program(action.index);
+            break;
+        case action_type::blit:
+            visitor.blit(action.index);
+            break;
+        case action_type::compute:
+            visitor.compute(action.index);
+            break;
+        }
+    }
+}
+
+// copies the sections of binary documents as whole arrays and streams JSON
+// through a SAX parser
 document from_file(const char* file_name);
+// parses into a DOM first, kept as a reference for the loader benchmark
+document from_file_dom(const char* file_name);
+
+// file a shader or mesh name of the document refers to
+std::string referenced_file_name(const document& document, string_id name);
+
+// in the format read by from_file_dom
+void to_json_file(const document& document, const char* file_name);
@@ -0,0 +1,93 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static std::string absolute_name(const std::filesystem::path& file) {
+    return std::filesystem::absolute(file).lexically_normal().string();
+}
+
+#ifdef __linux__
+file_watcher::file_watcher() {
+    descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (descriptor == -1)
+        throw std::runtime_error("Couldn't initialize inotify");
+}
+
+file_watcher::~file_watcher() {
+    close(descriptor);
+}
+
+void file_watcher::watch(const std::filesystem::path& file) {
+    std::filesystem::path path = absolute_name(file);
+    if (!files.insert({path.string(), file}).second)
+        return;
+
+    // adding a directory twice returns the same watch descriptor
+    auto directory = path.parent_path();
+    auto watch = inotify_add_watch(
+        descriptor, directory.c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO
+    );
+    if (watch == -1)
+        throw std::runtime_error("Couldn't watch " + directory.string());
+    directories[watch] = directory;
+}
+
+std::vector<std::filesystem::path> file_watcher::poll() {
+    std::vector<std::filesystem::path> changed;
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        auto size = read(descriptor, buffer, sizeof(buffer));
+        if (size <= 0)
+            break;
+        for (auto event = buffer; event < buffer + size;) {
+            auto& header = *reinterpret_cast<const inotify_event*>(event);
+            event += sizeof(inotify_event) + header.len;
+
+            auto directory = directories.find(header.wd);
+            if (header.len == 0 || directory == directories.end())
+                continue;
+            auto file = files.find((directory->second / header.name).string());
+            if (
+                file != files.end() &&
+                std::find(changed.begin(), changed.end(), file->second) ==
+                changed.end()
+            )
+                changed.push_back(file->second);
+        }
+    }
+    return changed;
+}
+#else
+file_watcher::file_watcher() {}
+
+file_watcher::~file_watcher() {}
+
+void file_watcher::watch(const std::filesystem::path& file) {
+    std::error_code error;
+    files.insert({
+        absolute_name(file),
+        {file, std::filesystem::last_write_time(file, error)}
+    });
+}
+
+std::vector<std::filesystem::path> file_watcher::poll() {
+    std::vector<std::filesystem::path> changed;
+    for (auto& file : files) {
+        std::error_code error;
+        auto time = std::filesystem::last_write_time(file.second.name, error);
+        if (!error && time != file.second.time) {
+            file.second.time = time;
+            changed.push_back(file.second.name);
+        }
+    }
+    return changed;
+}
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// reports changes of a set of files without blocking
+// uses inotify on Linux, other platforms compare modification times
+struct file_watcher {
+    file_watcher();
+    file_watcher(const file_watcher&) = delete;
+    ~file_watcher();
+
+    file_watcher& operator= (const file_watcher&) = delete;
+
+    void watch(const std::filesystem::path& file);
+
+    // watched files that changed since the last call, each one once and
+    // named as passed to watch
+    std::vector<std::filesystem::path> poll();
+
+private:
+#ifdef __linux__
+    int descriptor = -1;
+    // editors replace files by renaming, so the directories are watched
+    std::unordered_map<int, std::filesystem::path> directories;
+    // from absolute paths to the names passed to watch
+    std::unordered_map<std::string, std::filesystem::path> files;
+#else
+    struct watched_file {
+        std::filesystem::path name;
+        std::filesystem::file_time_type time;
+    };
+    std::unordered_map<std::string, watched_file> files;
+#endif
+};
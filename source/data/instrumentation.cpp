@@ -0,0 +1,276 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include <json/json.hpp>
+
+uint32_t trace::intern(std::string_view name) {
+    auto found = name_indices.find(std::string(name));
+    if (found != name_indices.end())
+        return found->second;
+    auto index = static_cast<uint32_t>(names.size());
+    names.emplace_back(name);
+    name_indices.emplace(name, index);
+    return index;
+}
+
+void trace::add(
+    std::string_view name, uint32_t track,
+    std::chrono::steady_clock::time_point begin,
+    std::chrono::steady_clock::time_point end
+) {
+    if (events.size() >= maximum_events)
+        return;
+    events.push_back({intern(name), track, begin, end});
+}
+
+void trace::name_track(uint32_t track, std::string_view name) {
+    track_names[track] = name;
+}
+
+void trace::save(const char* file_name) const {
+    std::ofstream file(file_name);
+    if (!file)
+        throw std::runtime_error(
+            "Can't write trace to " + std::string(file_name)
+        );
+    // microseconds since the first span
+    auto start = std::chrono::steady_clock::time_point::max();
+    std::vector<uint32_t> tracks;
+    for (const auto& event : events) {
+        start = std::min(start, event.begin);
+        tracks.push_back(event.track);
+    }
+    std::sort(tracks.begin(), tracks.end());
+    tracks.erase(std::unique(tracks.begin(), tracks.end()), tracks.end());
+    auto microseconds = [&](std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+
+    file << std::fixed << std::setprecision(3) <<
+        "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    auto separator = "\n";
+    for (auto track : tracks) {
+        auto name = track_names.find(track);
+        file <<
+            separator <<
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" <<
+            track << ",\"args\":{\"name\":" <<
+            nlohmann::json(
+                name != track_names.end() ? name->second :
+                track == gpu_track ? "GPU" :
+                "thread " + std::to_string(track)
+            ).dump() << "}}";
+        separator = ",\n";
+    }
+    std::vector<std::string> escaped;
+    for (const auto& name : names)
+        escaped.push_back(nlohmann::json(name).dump());
+    for (const auto& event : events) {
+        file <<
+            separator << "{\"name\":" << escaped[event.name] <<
+            ",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.track <<
+            ",\"ts\":" << microseconds(event.begin - start) <<
+            ",\"dur\":" << microseconds(event.end - event.begin) << "}";
+        separator = ",\n";
+    }
+    file << "\n]}\n";
+}
+
+static const unsigned sub_bucket_bits = 4;
+static const uint64_t sub_bucket_count = 1 << sub_bucket_bits;
+
+// values below sub_bucket_count have a bucket each, larger ones are split
+// by their highest bit and the sub_bucket_bits below it
+static size_t bucket_index(uint64_t value) {
+    if (value < sub_bucket_count)
+        return value;
+    auto shift = std::bit_width(value) - sub_bucket_bits - 1;
+    return (shift + 1) * sub_bucket_count +
+        ((value >> shift) & (sub_bucket_count - 1));
+}
+
+static uint64_t bucket_upper_bound(size_t index) {
+    if (index < sub_bucket_count)
+        return index;
+    auto shift = index / sub_bucket_count - 1;
+    auto lower =
+        (sub_bucket_count + index % sub_bucket_count) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+void latency_histogram::add(uint64_t nanoseconds) {
+    buckets[bucket_index(nanoseconds)]++;
+    count++;
+    maximum = std::max(maximum, nanoseconds);
+}
+
+uint64_t latency_histogram::percentile(double fraction) const {
+    if (count == 0)
+        return 0;
+    auto rank = std::max<uint64_t>(
+        static_cast<uint64_t>(fraction * static_cast<double>(count) + 0.5),
+        1
+    );
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(bucket_upper_bound(i), maximum);
+    }
+    return maximum;
+}
+
+namespace {
+
+struct instrumented_span {
+    uint32_t site;
+    std::chrono::steady_clock::time_point begin, end;
+};
+
+// written by its thread and drained by collect_instrumentation, a single
+// producer and single consumer queue
+struct span_ring {
+    static const size_t capacity = 4096;
+
+    std::array<instrumented_span, capacity> spans;
+    std::atomic<uint64_t> head{0}, tail{0};
+    std::atomic<uint64_t> dropped{0};
+    uint32_t track;
+    std::string name;
+};
+
+struct instrumentation_registry {
+    // one collector at a time, also guards the sites
+    std::mutex mutex;
+    std::vector<std::string> site_names;
+    std::vector<latency_histogram> histograms;
+    // rings of exited threads are removed once drained
+    std::vector<std::shared_ptr<span_ring>> rings;
+    uint32_t next_track = gpu_track + 1;
+    uint64_t dropped = 0;
+};
+
+}
+
+static instrumentation_registry& registry() {
+    static instrumentation_registry registry;
+    return registry;
+}
+
+static span_ring& thread_ring() {
+    thread_local std::shared_ptr<span_ring> ring;
+    if (!ring) {
+        auto& registry = ::registry();
+        ring = std::make_shared<span_ring>();
+        std::lock_guard lock(registry.mutex);
+        ring->track = registry.next_track++;
+        registry.rings.push_back(ring);
+    }
+    return *ring;
+}
+
+uint32_t instrumentation_site(const char* name) {
+    auto& registry = ::registry();
+    std::lock_guard lock(registry.mutex);
+    registry.site_names.push_back(name);
+    registry.histograms.emplace_back();
+    return static_cast<uint32_t>(registry.site_names.size() - 1);
+}
+
+scoped_timer::~scoped_timer() {
+    auto end = std::chrono::steady_clock::now();
+    auto& ring = thread_ring();
+    auto head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == ring.capacity) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.spans[head % ring.capacity] = {site, begin, end};
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void name_instrumented_thread(std::string_view name) {
+    auto& ring = thread_ring();
+    std::lock_guard lock(registry().mutex);
+    ring.name = name;
+}
+
+void collect_instrumentation(trace* trace) {
+    auto& registry = ::registry();
+    std::lock_guard lock(registry.mutex);
+    for (const auto& ring : registry.rings) {
+        auto tail = ring->tail.load(std::memory_order_relaxed);
+        auto head = ring->head.load(std::memory_order_acquire);
+        if (trace != nullptr && !ring->name.empty())
+            trace->name_track(ring->track, ring->name);
+        for (; tail != head; tail++) {
+            auto& span = ring->spans[tail % ring->capacity];
+            registry.histograms[span.site].add(static_cast<uint64_t>(
+                std::chrono::nanoseconds(span.end - span.begin).count()
+            ));
+            if (trace != nullptr)
+                trace->add(
+                    registry.site_names[span.site], ring->track, span.begin,
+                    span.end
+                );
+        }
+        ring->tail.store(head, std::memory_order_release);
+        registry.dropped +=
+            ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    // only the registry refers to the rings of exited threads, which
+    // don't record anymore
+    registry.rings.erase(
+        std::remove_if(
+            registry.rings.begin(), registry.rings.end(),
+            [](const auto& ring) { return ring.use_count() == 1; }
+        ),
+        registry.rings.end()
+    );
+}
+
+std::vector<latency_summary> instrumentation_summaries() {
+    auto& registry = ::registry();
+    std::lock_guard lock(registry.mutex);
+    auto milliseconds = [](uint64_t nanoseconds) {
+        return static_cast<double>(nanoseconds) / 1e6;
+    };
+    std::vector<latency_summary> summaries;
+    for (size_t i = 0; i < registry.site_names.size(); i++) {
+        auto& histogram = registry.histograms[i];
+        if (histogram.count == 0)
+            continue;
+        summaries.push_back({
+            registry.site_names[i], histogram.count,
+            milliseconds(histogram.percentile(0.5)),
+            milliseconds(histogram.percentile(0.99)),
+            milliseconds(histogram.maximum),
+        });
+    }
+    return summaries;
+}
+
+void print_instrumentation(std::ostream& stream) {
+    auto summaries = instrumentation_summaries();
+    if (summaries.empty())
+        return;
+    stream << "cpu time per scope, p50 / p99 / max ms:" << std::endl;
+    for (const auto& summary : summaries)
+        stream <<
+            "  " << summary.name << ": " << summary.p50 << " / " <<
+            summary.p99 << " / " << summary.maximum << " (" <<
+            summary.count << " spans)" << std::endl;
+    std::lock_guard lock(registry().mutex);
+    if (registry().dropped > 0)
+        stream <<
+            "  " << registry().dropped << " spans dropped by full rings" <<
+            std::endl;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// spans on tracks, saved as Chrome trace events, which chrome://tracing and
+// Perfetto open, tracks are shown as threads
+struct trace {
+    // spans past maximum_events are dropped
+    void add(
+        std::string_view name, uint32_t track,
+        std::chrono::steady_clock::time_point begin,
+        std::chrono::steady_clock::time_point end
+    );
+    // tracks without a name are called by their number
+    void name_track(uint32_t track, std::string_view name);
+    void save(const char* file_name) const;
+
+    size_t maximum_events = 1 << 20;
+
+private:
+    struct event {
+        // into names
+        uint32_t name;
+        uint32_t track;
+        std::chrono::steady_clock::time_point begin, end;
+    };
+
+    uint32_t intern(std::string_view name);
+
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> name_indices;
+    std::unordered_map<uint32_t, std::string> track_names;
+    std::vector<event> events;
+};
+
+// the gpu has the first track, threads get the others in the order they
+// record their first span
+inline constexpr uint32_t gpu_track = 0;
+
+// log-linear buckets like HdrHistogram, 16 per power of two, so values are
+// kept to within 1/16 of themselves
+struct latency_histogram {
+    void add(uint64_t nanoseconds);
+    // upper bound of the bucket fraction of the values are in or below
+    uint64_t percentile(double fraction) const;
+
+    uint64_t count = 0, maximum = 0;
+    std::array<uint64_t, 64 * 16> buckets{};
+};
+
+// of the spans of one scope, in milliseconds
+struct latency_summary {
+    std::string name;
+    uint64_t count;
+    double p50, p99, maximum;
+};
+
+// scopes are timed by INSTRUMENT_SCOPE, which is empty unless the build
+// defines EDITOR_INSTRUMENTATION
+// spans go to a ring per thread without locking, which
+// collect_instrumentation drains into a histogram per scope, spans of a
+// thread whose ring is full until then are dropped
+
+// index of a timed scope, called once per scope
+uint32_t instrumentation_site(const char* name);
+
+// records the span of its lifetime for the site
+struct scoped_timer {
+    explicit scoped_timer(uint32_t site) :
+        site(site), begin(std::chrono::steady_clock::now()) {}
+    scoped_timer(const scoped_timer&) = delete;
+    ~scoped_timer();
+
+    scoped_timer& operator= (const scoped_timer&) = delete;
+
+    uint32_t site;
+    std::chrono::steady_clock::time_point begin;
+};
+
+#ifdef EDITOR_INSTRUMENTATION
+#define INSTRUMENT_CONCATENATE(a, b) a##b
+#define INSTRUMENT_NAME(prefix, line) INSTRUMENT_CONCATENATE(prefix, line)
+#define INSTRUMENT_SCOPE(name) \
+    static const uint32_t INSTRUMENT_NAME(instrumented_site_, __LINE__) = \
+        instrumentation_site(name); \
+    scoped_timer INSTRUMENT_NAME(instrumented_scope_, __LINE__)( \
+        INSTRUMENT_NAME(instrumented_site_, __LINE__) \
+    )
+#else
+#define INSTRUMENT_SCOPE(name) static_cast<void>(0)
+#endif
+
+// names the track of the calling thread in traces
+void name_instrumented_thread(std::string_view name);
+
+// drains the rings of all threads into the histograms and into trace
+// unless it's null, may be called from any thread
+void collect_instrumentation(trace* trace);
+
+// of all scopes with spans, in the order they were first timed
+std::vector<latency_summary> instrumentation_summaries();
+void print_instrumentation(std::ostream& stream);
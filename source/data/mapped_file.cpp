@@ -0,0 +1,124 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file(const char* file_name) {
+#ifdef _WIN32
+    file = CreateFileA(
+        file_name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        throw std::runtime_error(
+            std::string("Couldn't open file ") + file_name
+        );
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    length = static_cast<std::size_t>(file_size.QuadPart);
+
+    if (length > 0) {
+        mapping = CreateFileMappingA(
+            file, nullptr, PAGE_READONLY, 0, 0, nullptr
+        );
+        if (mapping == nullptr) {
+            unmap();
+            throw std::runtime_error(
+                std::string("Couldn't map file ") + file_name
+            );
+        }
+        begin = static_cast<const std::byte*>(
+            MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+        );
+        if (begin == nullptr) {
+            unmap();
+            throw std::runtime_error(
+                std::string("Couldn't map file ") + file_name
+            );
+        }
+    }
+#else
+    int descriptor = open(file_name, O_RDONLY);
+    if (descriptor == -1) {
+        throw std::runtime_error(
+            std::string("Couldn't open file ") + file_name
+        );
+    }
+
+    struct stat status;
+    if (fstat(descriptor, &status) == -1) {
+        close(descriptor);
+        throw std::runtime_error(
+            std::string("Couldn't read size of file ") + file_name
+        );
+    }
+    length = static_cast<std::size_t>(status.st_size);
+
+    if (length > 0) {
+        void* address = mmap(
+            nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0
+        );
+        if (address == MAP_FAILED) {
+            close(descriptor);
+            throw std::runtime_error(
+                std::string("Couldn't map file ") + file_name
+            );
+        }
+        begin = static_cast<const std::byte*>(address);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(descriptor);
+#endif
+}
+
+mapped_file::mapped_file(mapped_file&& o) {
+    *this = std::move(o);
+}
+
+mapped_file::~mapped_file() {
+    unmap();
+}
+
+mapped_file& mapped_file::operator= (mapped_file&& o) {
+    unmap();
+    std::swap(begin, o.begin);
+    std::swap(length, o.length);
+#ifdef _WIN32
+    std::swap(file, o.file);
+    std::swap(mapping, o.mapping);
+#endif
+    return *this;
+}
+
+void mapped_file::unmap() {
+#ifdef _WIN32
+    if (begin != nullptr)
+        UnmapViewOfFile(begin);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+    if (file != nullptr)
+        CloseHandle(file);
+    file = nullptr;
+    mapping = nullptr;
+#else
+    if (begin != nullptr)
+        munmap(const_cast<std::byte*>(begin), length);
+#endif
+    begin = nullptr;
+    length = 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+// read-only memory mapping of a whole file
+struct mapped_file {
+    mapped_file() = default;
+    mapped_file(const char* file_name);
+    mapped_file(const mapped_file&) = delete;
+    mapped_file(mapped_file&& o);
+    ~mapped_file();
+
+    mapped_file& operator= (const mapped_file&) = delete;
+    mapped_file& operator= (mapped_file&& o);
+
+    const std::byte* data() const { return begin; }
+    std::size_t size() const { return length; }
+
+private:
+    void unmap();
+
+    const std::byte* begin = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
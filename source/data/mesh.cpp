@@ -0,0 +1,335 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESH_SSE2
+#endif
+
+#include "mapped_file.h"
+
+[[noreturn]] static void malformed(const char* file_name, unsigned line) {
+    throw std::runtime_error(
+        std::string(file_name) + ":" + std::to_string(line) +
+        ": malformed OBJ statement"
+    );
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// the rest of a line in the mapping, tokens are parsed where they are
+struct obj_line {
+    const char* begin;
+    const char* end;
+
+    // false at the end of the line
+    bool skip_spaces() {
+        while (begin < end && is_space(*begin))
+            begin++;
+        return begin < end;
+    }
+
+    bool at_token_end() const {
+        return begin == end || is_space(*begin);
+    }
+
+    std::string_view token() {
+        auto start = begin;
+        while (begin < end && !is_space(*begin))
+            begin++;
+        return {start, static_cast<size_t>(begin - start)};
+    }
+
+    bool number(float& value) {
+        if (!skip_spaces())
+            return false;
+        // from_chars doesn't take the sign some exporters write
+        if (*begin == '+')
+            begin++;
+        auto result = std::from_chars(begin, end, value);
+        begin = result.ptr;
+        return result.ec == std::errc() && at_token_end();
+    }
+
+    // one based index into a pool of count values, negative indices count
+    // back from the last value read so far
+    bool index(size_t count, uint32_t& result) {
+        long long value;
+        auto parsed = std::from_chars(begin, end, value);
+        begin = parsed.ptr;
+        if (parsed.ec != std::errc())
+            return false;
+        auto size = static_cast<long long>(count);
+        if (value > 0 && value <= size)
+            result = static_cast<uint32_t>(value - 1);
+        else if (value < 0 && -value <= size)
+            result = static_cast<uint32_t>(size + value);
+        else
+            return false;
+        return true;
+    }
+
+    bool skip(char c) {
+        if (begin == end || *begin != c)
+            return false;
+        begin++;
+        return true;
+    }
+};
+
+struct obj_corner {
+    uint32_t position, texture_coordinate, normal;
+};
+
+// reads the corners of a face as v, v/t, v//n or v/t/n
+static bool read_face(
+    obj_line& line, const obj_mesh& mesh, std::vector<obj_corner>& face
+) {
+    face.clear();
+    while (line.skip_spaces()) {
+        obj_corner corner = {-1u, -1u, -1u};
+        if (!line.index(mesh.positions[0].size(), corner.position))
+            return false;
+        if (line.skip('/')) {
+            // v//n leaves the texture coordinate out
+            auto texture_coordinate = !line.skip('/');
+            if (texture_coordinate && !line.index(
+                mesh.texture_coordinates[0].size(), corner.texture_coordinate
+            ))
+                return false;
+            if (
+                (!texture_coordinate || line.skip('/')) &&
+                !line.index(mesh.normals[0].size(), corner.normal)
+            )
+                return false;
+        }
+        if (!line.at_token_end())
+            return false;
+        face.push_back(corner);
+    }
+    return face.size() >= 3;
+}
+
+obj_mesh load_obj(const char* file_name) {
+    mapped_file file(file_name);
+    auto data = reinterpret_cast<const char*>(file.data());
+    auto file_end = data + file.size();
+
+    obj_mesh mesh;
+    std::vector<obj_corner> face;
+    unsigned line_number = 0;
+    for (auto begin = data; begin < file_end;) {
+        auto end = static_cast<const char*>(
+            memchr(begin, '\n', file_end - begin)
+        );
+        if (end == nullptr)
+            end = file_end;
+        obj_line line = {begin, end};
+        begin = end + 1;
+        line_number++;
+
+        if (!line.skip_spaces())
+            continue;
+        auto keyword = line.token();
+        // further components, like w or vertex colors, are ignored
+        if (keyword == "v" || keyword == "vn") {
+            auto& pool = keyword == "v" ? mesh.positions : mesh.normals;
+            float values[3];
+            for (auto& value : values)
+                if (!line.number(value))
+                    malformed(file_name, line_number);
+            for (auto i = 0u; i < 3; i++)
+                pool[i].push_back(values[i]);
+
+        } else if (keyword == "vt") {
+            float values[2] = {0.0f, 0.0f};
+            if (!line.number(values[0]))
+                malformed(file_name, line_number);
+            if (line.skip_spaces() && !line.number(values[1]))
+                malformed(file_name, line_number);
+            for (auto i = 0u; i < 2; i++)
+                mesh.texture_coordinates[i].push_back(values[i]);
+
+        } else if (keyword == "f") {
+            if (!read_face(line, mesh, face))
+                malformed(file_name, line_number);
+            // fans keep the winding of the face
+            for (size_t i = 1; i + 1 < face.size(); i++) {
+                for (auto& corner : {face[0], face[i], face[i + 1]}) {
+                    mesh.corner_positions.push_back(corner.position);
+                    mesh.corner_normals.push_back(corner.normal);
+                    mesh.corner_texture_coordinates.push_back(
+                        corner.texture_coordinate
+                    );
+                }
+            }
+        }
+    }
+    return mesh;
+}
+
+// bit layout of a packed format, x, y and z are quantized, the fourth
+// component is 1
+struct packing {
+    unsigned bits[4], shifts[4];
+    bool is_signed;
+};
+
+static packing format_packing(format format) {
+    switch (format) {
+    case format::a2b10g10r10_unorm_pack32:
+        return {{10, 10, 10, 2}, {0, 10, 20, 30}, false};
+    case format::a2b10g10r10_snorm_pack32:
+        return {{10, 10, 10, 2}, {0, 10, 20, 30}, true};
+    case format::r8g8b8a8_unorm:
+        return {{8, 8, 8, 8}, {0, 8, 16, 24}, false};
+    // the padding byte makes it R8G8B8A8_SNORM
+    case format::r8g8b8_snorm:
+        return {{8, 8, 8, 8}, {0, 8, 16, 24}, true};
+    case format::b8g8r8a8_srgb:
+        break;
+    }
+    throw std::runtime_error("Format can't be used for mesh attributes");
+}
+
+unsigned attribute_size(format format) {
+    return format == format::r8g8b8_snorm ? 3 : 4;
+}
+
+// 1 maps to the largest value of a component
+static float component_max(unsigned bits, bool is_signed) {
+    return static_cast<float>((1u << (bits - is_signed)) - 1);
+}
+
+// rounds to nearest even like the vectorized version
+static uint32_t quantize(
+    float value, float scale, unsigned bits, bool is_signed
+) {
+    value = std::clamp(value * scale, is_signed ? -1.0f : 0.0f, 1.0f);
+    auto quantized = static_cast<int32_t>(
+        std::nearbyint(value * component_max(bits, is_signed))
+    );
+    return static_cast<uint32_t>(quantized) & ((1u << bits) - 1);
+}
+
+// packs count values whose components are in channels, which are null for
+// components the source doesn't have
+static void pack(
+    const float* const channels[3], size_t count, float scale,
+    const packing& packing, uint32_t* packed
+) {
+    auto one = quantize(1.0f, 1.0f, packing.bits[3], packing.is_signed) <<
+        packing.shifts[3];
+    size_t i = 0;
+#ifdef MESH_SSE2
+    // four values at a time from the structure of arrays
+    auto low = _mm_set1_ps(packing.is_signed ? -1.0f : 0.0f);
+    auto high = _mm_set1_ps(1.0f);
+    auto scales = _mm_set1_ps(scale);
+    __m128 maxima[3];
+    __m128i masks[3], shifts[3];
+    for (auto c = 0u; c < 3; c++) {
+        maxima[c] = _mm_set1_ps(
+            component_max(packing.bits[c], packing.is_signed)
+        );
+        masks[c] = _mm_set1_epi32((1 << packing.bits[c]) - 1);
+        shifts[c] = _mm_cvtsi32_si128(packing.shifts[c]);
+    }
+    for (; i + 4 <= count; i += 4) {
+        auto result = _mm_set1_epi32(static_cast<int>(one));
+        for (auto c = 0u; c < 3; c++) {
+            if (channels[c] == nullptr)
+                continue;
+            auto value = _mm_mul_ps(_mm_loadu_ps(channels[c] + i), scales);
+            value = _mm_min_ps(_mm_max_ps(value, low), high);
+            auto quantized = _mm_cvtps_epi32(_mm_mul_ps(value, maxima[c]));
+            quantized = _mm_and_si128(quantized, masks[c]);
+            result = _mm_or_si128(
+                result, _mm_sll_epi32(quantized, shifts[c])
+            );
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i), result);
+    }
+#endif
+    for (; i < count; i++) {
+        auto result = one;
+        for (auto c = 0u; c < 3; c++) {
+            if (channels[c] == nullptr)
+                continue;
+            result |= quantize(
+                channels[c][i], scale, packing.bits[c], packing.is_signed
+            ) << packing.shifts[c];
+        }
+        packed[i] = result;
+    }
+}
+
+void pack_attribute(
+    const obj_mesh& mesh, mesh_source source, format format,
+    std::byte* destination, unsigned stride
+) {
+    auto packing = format_packing(format);
+    if (stride < attribute_size(format))
+        throw std::runtime_error("Vertex stride smaller than its format");
+
+    const float* channels[3] = {};
+    const std::vector<uint32_t>* corners = nullptr;
+    size_t count = 0;
+    float scale = 1.0f;
+    switch (source) {
+    case mesh_source::position: {
+        float extent = 0.0f;
+        for (auto c = 0u; c < 3; c++) {
+            channels[c] = mesh.positions[c].data();
+            for (auto value : mesh.positions[c])
+                extent = std::max(extent, std::abs(value));
+        }
+        count = mesh.positions[0].size();
+        corners = &mesh.corner_positions;
+        scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+        break;
+    }
+    case mesh_source::normal:
+        for (auto c = 0u; c < 3; c++)
+            channels[c] = mesh.normals[c].data();
+        count = mesh.normals[0].size();
+        corners = &mesh.corner_normals;
+        break;
+    case mesh_source::texture_coordinate:
+        for (auto c = 0u; c < 2; c++)
+            channels[c] = mesh.texture_coordinates[c].data();
+        count = mesh.texture_coordinates[0].size();
+        corners = &mesh.corner_texture_coordinates;
+        break;
+    }
+
+    // the pools are smaller than the corners, so they are packed once and
+    // the corners copy packed values, the extra one is for missing values
+    std::vector<uint32_t> packed(count + 1);
+    pack(channels, count, scale, packing, packed.data());
+    const float* const none[3] = {};
+    pack(none, 1, 1.0f, packing, packed.data() + count);
+
+    auto gather = [&](auto size) {
+        auto target = destination;
+        for (auto index : *corners) {
+            auto value = packed.data() + std::min<size_t>(index, count);
+            memcpy(target, value, decltype(size)::value);
+            target += stride;
+        }
+    };
+    if (stride >= 4)
+        gather(std::integral_constant<size_t, 4>());
+    else
+        gather(std::integral_constant<size_t, 3>());
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "document.h"
+
+// vertices of an OBJ file, positions, normals and texture coordinates are
+// pooled as in the file and faces are split into fans of triangles, whose
+// corners index the pools
+struct obj_mesh {
+    // one value per vertex of every triangle
+    size_t vertex_count() const {
+        return corner_positions.size();
+    }
+
+    // structure of arrays, x, y and z or u and v
+    std::vector<float> positions[3], normals[3], texture_coordinates[2];
+    // per corner, -1u where the face has no normal or texture coordinate
+    std::vector<uint32_t> corner_positions, corner_normals;
+    std::vector<uint32_t> corner_texture_coordinates;
+};
+
+// streams the lines of the file from a mapping, throws std::runtime_error
+// with the line of the first malformed statement, statements other than
+// vertices and faces are skipped
+obj_mesh load_obj(const char* file_name);
+
+// bytes a vertex of the format takes as mesh attribute
+unsigned attribute_size(format format);
+
+// quantizes the values of source to format, one per corner of the mesh,
+// stride bytes apart from destination, which may be larger than the format
+// up to 4 bytes to pad three component formats to four, the extra
+// component is 1
+// positions are scaled into the unit cube by their largest coordinate,
+// missing values are 0
+void pack_attribute(
+    const obj_mesh& mesh, mesh_source source, format format,
+    std::byte* destination, unsigned stride
+);
@@ -2,6 +2,14 @@
 #include <cassert>
 #include <memory>
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <optional>
+#include <string>
+#include <vector>
 
 #define GLFW_INCLUDE_VULKAN
 #define GLFW_VULKAN_STATIC
@@ -11,10 +19,17 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "data/animation.h"
 #include "data/document.h"
+#include "data/file_watcher.h"
+#include "data/instrumentation.h"
 #include "rendering/document.h"
+#include "rendering/mesh.h"
 #include "rendering/resources.h"
 #include "rendering/renderer.h"
+#include "rendering/offscreen.h"
+#include "rendering/profiler.h"
+#include "rendering/pacing.h"
 
 using namespace std;
 
@@ -38,36 +53,67 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
     return VK_FALSE;
 }
 
+// only holds resolution dependent objects, pipelines are kept on resize
 struct view {
     view() = default;
     view(
-        unsigned width, unsigned heigh, renderer& renderer, document& document,
+        unsigned width, unsigned heigh, const render_document& document,
+        const render_meshes& meshes, const uniform_table& values,
+        const renderer& renderer,
         VkDevice device, VkPhysicalDevice physical_device,
-        VkCommandPool command_pool,
         uint32_t graphics_queue_family, uint32_t present_queue_family,
-        VkSurfaceKHR surface, VkSurfaceFormatKHR surface_format
+        VkQueue graphics_queue, VkSurfaceKHR surface,
+        VkSurfaceFormatKHR surface_format, VkPresentModeKHR present_mode,
+        VkSwapchainKHR old_swapchain
+    );
+
+    // creates the render targets and records the command buffers of all
+    // images again, after pipelines were rebuilt
+    // the device must be idle
+    void record(
+        const render_document& document, const render_meshes& meshes,
+        const renderer& renderer, VkFormat format, VkQueue graphics_queue
     );
 
     unsigned image_count;
     VkSurfaceCapabilitiesKHR capabilities;
     VkExtent2D extent;
-    VkViewport viewport;
-    VkRect2D scissors;
     unique_swapchain swapchain;
-    std::vector<render_document> documents;
+    // one frame of uniforms per swapchain image
+    uniform_ring uniforms;
+    // shared by all images, the barriers of the graph order frames in
+    // flight on the queue
+    render_targets targets;
+    std::vector<render_image> images;
+    // per image, the fence of the frame in flight that rendered it last,
+    // null before the first
+    std::vector<VkFence> image_fences;
+    // of the next frame, swapped textures start over with new targets
+    unsigned parity = 0;
+    // graphics_finished_semaphore of the last frame submitted, the async
+    // actions of the next one wait for it
+    VkSemaphore last_frame = VK_NULL_HANDLE;
 };
 
 view::view(
-    unsigned width, unsigned height, renderer& renderer, document& document,
+    unsigned width, unsigned height, const render_document& document,
+    const render_meshes& meshes, const uniform_table& values,
+    const renderer& renderer,
     VkDevice device, VkPhysicalDevice physical_device,
-    VkCommandPool command_pool,
     uint32_t graphics_queue_family, uint32_t present_queue_family,
-    VkSurfaceKHR surface, VkSurfaceFormatKHR surface_format
+    VkQueue graphics_queue, VkSurfaceKHR surface,
+    VkSurfaceFormatKHR surface_format, VkPresentModeKHR present_mode,
+    VkSwapchainKHR old_swapchain
 ) {
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
         physical_device, surface, &capabilities
     );
-    auto present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    // mailbox needs an image to render to while one is queued and one shown
+    auto min_image_count = capabilities.minImageCount;
+    if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR)
+        min_image_count++;
+    if (capabilities.maxImageCount != 0)
+        min_image_count = min(min_image_count, capabilities.maxImageCount);
 
     extent = {
         max(
@@ -87,7 +133,7 @@ view::view(
         VkSwapchainCreateInfoKHR create_info{
             .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
             .surface = surface,
-            .minImageCount = capabilities.minImageCount,
+            .minImageCount = min_image_count,
             .imageFormat = surface_format.format,
             .imageColorSpace = surface_format.colorSpace,
             .imageExtent = extent,
@@ -100,7 +146,7 @@ view::view(
             .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
             .presentMode = present_mode,
             .clipped = VK_TRUE,
-            .oldSwapchain = VK_NULL_HANDLE,
+            .oldSwapchain = old_swapchain,
         };
         check(vkCreateSwapchainKHR(
             device, &create_info, nullptr, out_ptr(swapchain)
@@ -112,32 +158,375 @@ view::view(
         device, swapchain.get(), &image_count, nullptr
     );
 
-    auto images = std::make_unique<VkImage[]>(image_count);
-    vkGetSwapchainImagesKHR(
-        device, swapchain.get(), &image_count, images.get()
+    auto start = chrono::steady_clock::now();
+
+    uniforms = uniform_ring(document, values, renderer, image_count);
+    record(
+        document, meshes, renderer, surface_format.format, graphics_queue
     );
 
-    documents.reserve(image_count);
+    cout <<
+        "built view with " << image_count << " images in " <<
+        chrono::duration<double, milli>(
+            chrono::steady_clock::now() - start
+        ).count() << " ms" << endl;
+    print_resource_counts(cout);
+}
 
+void view::record(
+    const render_document& document, const render_meshes& meshes,
+    const renderer& renderer, VkFormat format, VkQueue graphics_queue
+) {
+    images.clear();
+    image_fences.assign(image_count, VK_NULL_HANDLE);
+    parity = 0;
+    last_frame = VK_NULL_HANDLE;
+    targets = {};
+    targets = render_targets(
+        document.graph, renderer, extent.width, extent.height, graphics_queue
+    );
+    targets.print_statistics(cout);
+
+    auto swapchain_images = std::make_unique<VkImage[]>(image_count);
+    vkGetSwapchainImagesKHR(
+        *current_device, swapchain.get(), &image_count,
+        swapchain_images.get()
+    );
+
+    images.reserve(image_count);
     for (auto i = 0u; i < image_count; ++i) {
-        documents.push_back(render_document(
-            width, height, document, renderer, images[i],
-            surface_format.format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-            command_pool
-        ));
+        images.emplace_back(
+            document, targets, meshes, uniforms, i, swapchain_images[i],
+            format, extent.width, extent.height, renderer
+        );
     }
 }
 
-int main() {
-    glfwInit();
+// reloads changed shaders and the document and rebuilds only the pipelines
+// depending on them, returns false if nothing changed or the reload
+// failed, in which case the previous document, meshes and pipelines are
+// kept
+// meshes the document changes are loaded and uploaded right away, as the
+// pipelines depend on them, changed mesh files only set meshes_changed, so
+// they can be loaded next to the frame loop
+// the device must be idle
+static bool reload(
+    const vector<filesystem::path>& files,
+    const filesystem::path& document_file_name, document& document,
+    render_document& render_document, render_meshes& meshes,
+    const renderer& renderer, upload_queue& uploads, bool& uniforms_moved,
+    bool& meshes_changed
+) {
+    auto start = chrono::steady_clock::now();
+    std::optional<::document> reloaded;
+    vector<uint32_t> programs, computes;
+    // sorted and without duplicates, within the actions of the document
+    auto clean = [](vector<uint32_t>& indices, size_t size) {
+        indices.erase(
+            remove_if(
+                indices.begin(), indices.end(),
+                [&](uint32_t i) { return i >= size; }
+            ),
+            indices.end()
+        );
+        sort(indices.begin(), indices.end());
+        indices.erase(unique(indices.begin(), indices.end()), indices.end());
+    };
+    std::optional<render_meshes> reloaded_meshes;
+    try {
+        for (const auto& file : files) {
+            if (file == document_file_name) {
+                reloaded = from_file(document_file_name.string().c_str());
+                continue;
+            }
+            for (auto name : document.meshes.file_names)
+                if (file == referenced_file_name(document, name))
+                    meshes_changed = true;
+            auto users = render_document.shader_users.find(file.string());
+            if (users != render_document.shader_users.end())
+                programs.insert(
+                    programs.end(),
+                    users->second.begin(), users->second.end()
+                );
+            users = render_document.compute_shader_users.find(file.string());
+            if (users != render_document.compute_shader_users.end())
+                computes.insert(
+                    computes.end(),
+                    users->second.begin(), users->second.end()
+                );
+        }
+
+        // the document decides which actions exist, its changes are added
+        // to the ones of the shaders
+        auto& current = reloaded ? *reloaded : document;
+        if (reloaded) {
+            auto changed = changed_programs(document, *reloaded);
+            programs.insert(programs.end(), changed.begin(), changed.end());
+            changed = changed_computes(document, *reloaded);
+            computes.insert(computes.end(), changed.begin(), changed.end());
+        }
+        clean(programs, current.programs.size());
+        clean(computes, current.computes.size());
+        if (programs.empty() && computes.empty() && !reloaded)
+            return false;
 
-    unsigned initial_window_width = 1280, initial_window_height = 720;
+        // vertex counts are recorded, which is done again anyway
+        if (
+            reloaded &&
+            !same_meshes(mesh_sources(document), mesh_sources(current))
+        ) {
+            reloaded_meshes.emplace(
+                load_meshes(mesh_sources(current), renderer), renderer,
+                uploads
+            );
+            uploads.wait(reloaded_meshes->upload_ticket);
+            meshes_changed = false;
+        }
+
+        uniforms_moved = render_document.rebuild(
+            current, renderer, programs, computes
+        );
+    } catch (const exception& error) {
+        cerr << "reload failed: " << error.what() << endl;
+        return false;
+    }
+    if (reloaded)
+        document = std::move(*reloaded);
+    if (reloaded_meshes) {
+        meshes = std::move(*reloaded_meshes);
+        meshes.print_statistics(cout);
+        uploads.print_statistics(cout);
+    }
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-    GLFWwindow* window = glfwCreateWindow(
-        initial_window_width, initial_window_height, "Vulkan", nullptr, nullptr
+    cout <<
+        "reloaded " << files.size() << " files, rebuilt " <<
+        programs.size() + computes.size() << " of " <<
+        render_document.render_program_actions.size() +
+        render_document.render_compute_actions.size() << " pipelines in " <<
+        chrono::duration<double, milli>(
+            chrono::steady_clock::now() - start
+        ).count() << " ms" << endl;
+    return true;
+}
+
+// of the monitor most of the window is on, glfw only knows the monitor of
+// full screen windows, 60 Hz if no monitor reports a rate
+static chrono::steady_clock::duration refresh_interval(GLFWwindow* window) {
+    int x, y, width, height;
+    glfwGetWindowPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    int monitor_count;
+    auto monitors = glfwGetMonitors(&monitor_count);
+    int refresh_rate = 0;
+    long largest_overlap = -1;
+    for (auto i = 0; i < monitor_count; i++) {
+        auto mode = glfwGetVideoMode(monitors[i]);
+        if (mode == nullptr)
+            continue;
+        int monitor_x, monitor_y;
+        glfwGetMonitorPos(monitors[i], &monitor_x, &monitor_y);
+        auto overlap_x = max(
+            0, min(x + width, monitor_x + mode->width) - max(x, monitor_x)
+        );
+        auto overlap_y = max(
+            0, min(y + height, monitor_y + mode->height) - max(y, monitor_y)
+        );
+        auto overlap = long(overlap_x) * overlap_y;
+        if (overlap > largest_overlap) {
+            largest_overlap = overlap;
+            refresh_rate = mode->refreshRate;
+        }
+    }
+    if (refresh_rate <= 0)
+        refresh_rate = 60;
+    return chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(1.0 / refresh_rate)
     );
+}
+
+// the editor has no camera yet, animations see an identity view and a
+// perspective projection with the aspect of the window
+static animation_inputs frame_inputs(
+    unsigned width, unsigned height, float elapsed_time
+) {
+    return {
+        .window_width = static_cast<float>(width),
+        .window_height = static_cast<float>(height),
+        .view_matrix = glm::mat4(1),
+        .projection_matrix = glm::perspective(
+            glm::radians(60.f),
+            static_cast<float>(width) / static_cast<float>(max(height, 1u)),
+            0.1f, 100.f
+        ),
+        .elapsed_time = elapsed_time,
+    };
+}
+
+// renders into offscreen images instead of a window and reads the last
+// frame back, works without a display, trace is optional
+// every frame in flight has an image of its own, animations advance by
+// 1 / 60 s per frame, so that outputs are reproducible
+static void render_headless(
+    const render_document& document, const render_meshes& meshes,
+    uniform_animator& animator, uniform_table& values,
+    const renderer& renderer, VkQueue queue,
+    VkQueue compute_queue, VkFormat format, unsigned width, unsigned height,
+    unsigned frame_count, unsigned frames_in_flight,
+    const char* output_file_name, gpu_profiler& profiler, trace* trace
+) {
+    vector<offscreen_target> outputs;
+    outputs.reserve(frames_in_flight);
+    for (auto i = 0u; i < frames_in_flight; i++)
+        outputs.emplace_back(renderer, format, width, height);
+    uniform_ring uniforms(document, values, renderer, frames_in_flight);
+    render_targets targets(document.graph, renderer, width, height, queue);
+    targets.print_statistics(cout);
+    vector<render_image> images;
+    images.reserve(frames_in_flight);
+    for (auto i = 0u; i < frames_in_flight; i++)
+        images.emplace_back(
+            document, targets, meshes, uniforms, i, outputs[i].image.get(),
+            format, width, height, renderer
+        );
+    vector<frame_resources> frames(frames_in_flight);
+
+    vector<uint64_t> timestamps;
+    auto read_timestamps = [&](const render_image& image) {
+        if (auto submitted = image.read_timestamps(timestamps))
+            profiler.add_frame(timestamps, *submitted, trace);
+    };
+    auto start = chrono::steady_clock::now();
+    for (auto frame = 0u; frame < frame_count; frame++) {
+        collect_instrumentation(trace);
+        INSTRUMENT_SCOPE("frame");
+        auto slot = frame % frames_in_flight;
+        auto& image = images[slot];
+        VkFence fence = frames[slot].fence.get();
+        {
+            INSTRUMENT_SCOPE("wait for frame");
+            vkWaitForFences(*current_device, 1, &fence, VK_TRUE, -1ul);
+        }
+        read_timestamps(image);
+        vkResetFences(*current_device, 1, &fence);
+        animator.evaluate(frame_inputs(width, height, frame / 60.f), values);
+        uniforms.upload(document, values, slot);
+
+        // async actions wait for the graphics of the frame before
+        VkSemaphore last_frame = frame == 0 ?
+            VK_NULL_HANDLE :
+            images[(frame - 1) % frames_in_flight]
+                .graphics_finished_semaphore.get();
+        INSTRUMENT_SCOPE("submit");
+        image.submit(
+            queue, compute_queue, frame % 2, VK_NULL_HANDLE, 0, last_frame,
+            VK_NULL_HANDLE, fence, outputs[slot].readback_command_buffer
+        );
+    }
+    for (auto i = 0u; i < frames_in_flight; i++) {
+        VkFence fence = frames[i].fence.get();
+        vkWaitForFences(*current_device, 1, &fence, VK_TRUE, -1ul);
+        read_timestamps(images[i]);
+    }
+
+    auto milliseconds = chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start
+    ).count();
+    cout <<
+        "rendered " << frame_count << " frames at " << width << "x" <<
+        height << " with " << frames_in_flight << " in flight in " <<
+        milliseconds << " ms (" << milliseconds / max(frame_count, 1u) <<
+        " ms per frame)" << endl;
+
+    if (output_file_name != nullptr && frame_count > 0) {
+        ofstream output(output_file_name, ios::binary);
+        outputs[(frame_count - 1) % frames_in_flight].write_ppm(output);
+    }
+}
+
+// of the shader and pipeline caches, the same for every working directory
+static filesystem::path cache_directory() {
+    for (auto variable : {"LOCALAPPDATA", "XDG_CACHE_HOME"})
+        if (auto value = getenv(variable))
+            return filesystem::path(value) / "material_editor";
+    if (auto home = getenv("HOME"))
+        return filesystem::path(home) / ".cache" / "material_editor";
+    return filesystem::absolute("cache");
+}
+
+int main(int argc, char** argv) {
+    name_instrumented_thread("main");
+    std::string document_file_name = "examples/example.json";
+    auto pipeline_cache_file_name =
+        (cache_directory() / "pipelines.bin").string();
+
+    // headless mode renders a fixed number of frames without a window
+    bool headless = false;
+    unsigned headless_frames = 100;
+    unsigned initial_window_width = 1280, initial_window_height = 720;
+    const char* output_file_name = nullptr;
+    // cpu and gpu spans are saved as Chrome trace when given
+    const char* trace_file_name = nullptr;
+    // up to max_frames_in_flight, 1 for the lowest latency
+    unsigned frames_in_flight = 2;
+    // frames are paced unless presenting for throughput
+    auto preference = present_preference::latency;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+        if (argument == "--headless") {
+            headless = true;
+        } else if (argument == "--frames" && has_value) {
+            headless_frames = stoul(argv[++i]);
+        } else if (argument == "--width" && has_value) {
+            initial_window_width = stoul(argv[++i]);
+        } else if (argument == "--height" && has_value) {
+            initial_window_height = stoul(argv[++i]);
+        } else if (argument == "--output" && has_value) {
+            output_file_name = argv[++i];
+        } else if (argument == "--document" && has_value) {
+            document_file_name = argv[++i];
+        } else if (argument == "--trace" && has_value) {
+            trace_file_name = argv[++i];
+        } else if (
+            argument == "--frames-in-flight" && has_value &&
+            stoul(argv[i + 1]) >= 1 &&
+            stoul(argv[i + 1]) <= max_frames_in_flight
+        ) {
+            frames_in_flight = stoul(argv[++i]);
+        } else if (argument == "--present" && has_value) {
+            std::string value = argv[++i];
+            if (value == "latency") {
+                preference = present_preference::latency;
+            } else if (value == "throughput") {
+                preference = present_preference::throughput;
+            } else if (value == "vsync") {
+                preference = present_preference::vsync;
+            } else {
+                cerr << "unknown present preference " << value << endl;
+                return 1;
+            }
+        } else {
+            cerr <<
+                "usage: " << argv[0] << " [--document file] [--width n] "
+                "[--height n] [--trace file.json] [--frames-in-flight 1-" <<
+                max_frames_in_flight << "] "
+                "[--present latency|throughput|vsync] "
+                "[--headless [--frames n] [--output file.ppm]]" << endl;
+            return 1;
+        }
+    }
+
+    GLFWwindow* window = nullptr;
+    if (!headless) {
+        glfwInit();
+
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+        window = glfwCreateWindow(
+            initial_window_width, initial_window_height, "Vulkan",
+            nullptr, nullptr
+        );
+    }
 
     // set up error handling
     VkDebugUtilsMessengerCreateInfoEXT debugUtilsMessengerCreateInfo{
@@ -165,8 +554,10 @@ int main() {
 
     // look up extensions needed by GLFW
     uint32_t glfw_extension_count = 0;
-    auto glfw_extensions =
-        glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+    const char** glfw_extensions = nullptr;
+    if (!headless)
+        glfw_extensions =
+            glfwGetRequiredInstanceExtensions(&glfw_extension_count);
 
     // loop up supported extensions
     uint32_t supported_extension_count = 0;
@@ -265,8 +656,9 @@ int main() {
 #endif
 
     // create surface
-    VkSurfaceKHR surface;
-    check(glfwCreateWindowSurface(instance, window, nullptr, &surface));
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    if (!headless)
+        check(glfwCreateWindowSurface(instance, window, nullptr, &surface));
 
     // look for available devices
     VkPhysicalDevice physical_device;
@@ -284,13 +676,12 @@ int main() {
     }
 
     // get properties of physical device
+    VkPhysicalDeviceProperties physical_device_properties;
+    vkGetPhysicalDeviceProperties(
+        physical_device, &physical_device_properties
+    );
     max_sample_count = VK_SAMPLE_COUNT_1_BIT;
     {
-        VkPhysicalDeviceProperties physical_device_properties;
-        vkGetPhysicalDeviceProperties(
-            physical_device, &physical_device_properties
-        );
-
         VkSampleCountFlags sample_count_falgs =
             physical_device_properties.limits.framebufferColorSampleCounts &
             physical_device_properties.limits.framebufferDepthSampleCounts &
@@ -307,8 +698,6 @@ int main() {
             }
         }
     }
-    assert(max_sample_count != VK_SAMPLE_COUNT_1_BIT);
-    std::cout << max_sample_count << std::endl;
 
     // look for available queue families
     uint32_t queueFamilyCount = 0;
@@ -322,16 +711,24 @@ int main() {
     );
 
     uint32_t graphics_queue_family = -1u, present_queue_family = -1u;
+    uint32_t compute_queue_family = -1u, transfer_queue_family = -1u;
     for (auto i = 0u; i < queueFamilyCount; i++) {
         const auto& queueFamily = queueFamilies[i];
         if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             graphics_queue_family = i;
+        } else if (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+            // runs next to graphics instead of interleaved with it
+            compute_queue_family = i;
+        } else if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) {
+            // usually a copy engine, uploads don't take time from frames
+            transfer_queue_family = i;
         }
 
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(
-            physical_device, i, surface, &presentSupport
-        );
+        if (!headless)
+            vkGetPhysicalDeviceSurfaceSupportKHR(
+                physical_device, i, surface, &presentSupport
+            );
         if (presentSupport) {
             present_queue_family = i;
         }
@@ -339,6 +736,12 @@ int main() {
     if (graphics_queue_family == -1u) {
         throw runtime_error("no suitable queue found");
     }
+    if (headless)
+        present_queue_family = graphics_queue_family;
+    if (compute_queue_family == -1u)
+        compute_queue_family = graphics_queue_family;
+    if (transfer_queue_family == -1u)
+        transfer_queue_family = graphics_queue_family;
 
     // create queues and logical device
     // TODO: move VkDevice into renderer
@@ -347,33 +750,66 @@ int main() {
     // if that fails try to look for another VkPhysicalDevice
     VkDevice device;
     current_device = &device;
+    bool pipeline_creation_feedback = false;
     {
+        // a family may only be listed once
         float priority = 1.0f;
-        VkDeviceQueueCreateInfo queueCreateInfos[]{
-            {
-                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueFamilyIndex = graphics_queue_family,
-                .queueCount = 1,
-                .pQueuePriorities = &priority,
-            }, {
+        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+        for (auto family : {
+            graphics_queue_family, present_queue_family, compute_queue_family,
+            transfer_queue_family
+        }) {
+            if (any_of(
+                queueCreateInfos.begin(), queueCreateInfos.end(),
+                [&](const VkDeviceQueueCreateInfo& info) {
+                    return info.queueFamilyIndex == family;
+                }
+            ))
+                continue;
+            queueCreateInfos.push_back({
                 .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueFamilyIndex = present_queue_family,
+                .queueFamilyIndex = family,
                 .queueCount = 1,
                 .pQueuePriorities = &priority,
-            }
-        };
+            });
+        }
 
-        const char* enabledExtensionNames[] = {
-            VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-        };
+        std::vector<const char*> enabledExtensionNames;
+        if (!headless)
+            enabledExtensionNames.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+        // optional, used to report pipeline cache hits
+        uint32_t device_extension_count = 0;
+        vkEnumerateDeviceExtensionProperties(
+            physical_device, nullptr, &device_extension_count, nullptr
+        );
+        auto device_extensions =
+            make_unique<VkExtensionProperties[]>(device_extension_count);
+        vkEnumerateDeviceExtensionProperties(
+            physical_device, nullptr, &device_extension_count,
+            device_extensions.get()
+        );
+        for (auto i = 0u; i < device_extension_count; i++) {
+            if (strcmp(
+                device_extensions[i].extensionName,
+                VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME
+            ) == 0) {
+                enabledExtensionNames.push_back(
+                    VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME
+                );
+                pipeline_creation_feedback = true;
+            }
+        }
 
         VkPhysicalDeviceFeatures deviceFeatures{};
         VkDeviceCreateInfo createInfo{
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            .queueCreateInfoCount = size(queueCreateInfos),
-            .pQueueCreateInfos = queueCreateInfos,
-            .enabledExtensionCount = size(enabledExtensionNames),
-            .ppEnabledExtensionNames = enabledExtensionNames,
+            .queueCreateInfoCount =
+                static_cast<uint32_t>(queueCreateInfos.size()),
+            .pQueueCreateInfos = queueCreateInfos.data(),
+            .enabledExtensionCount =
+                static_cast<uint32_t>(enabledExtensionNames.size()),
+            .ppEnabledExtensionNames = enabledExtensionNames.data(),
             .pEnabledFeatures = &deviceFeatures
         };
 
@@ -381,198 +817,522 @@ int main() {
     }
 
     // retreive queues
-    VkQueue graphicsQueue, presentQueue;
+    VkQueue graphicsQueue, presentQueue, computeQueue, transferQueue;
     vkGetDeviceQueue(device, graphics_queue_family, 0, &graphicsQueue);
     vkGetDeviceQueue(device, present_queue_family, 0, &presentQueue);
+    vkGetDeviceQueue(device, compute_queue_family, 0, &computeQueue);
+    vkGetDeviceQueue(device, transfer_queue_family, 0, &transferQueue);
+
+    // headless rendering reads back 8 bit RGBA
+    VkSurfaceFormatKHR surface_format = {
+        VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR
+    };
 
     // create swap chain
-    uint32_t formatCount = 0, presentModeCount = 0;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(
-        physical_device, surface, &formatCount, nullptr
-    );
-    vkGetPhysicalDeviceSurfacePresentModesKHR(
-        physical_device, surface, &presentModeCount, nullptr
-    );
-    if (formatCount == 0) {
-        throw runtime_error("no surface formats supported");
-    }
-    if (presentModeCount == 0) {
-        throw runtime_error("no surface present modes supported");
-    }
-    auto formats = make_unique<VkSurfaceFormatKHR[]>(formatCount);
-    auto presentModes = make_unique<VkPresentModeKHR[]>(presentModeCount);
+    auto present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    if (!headless) {
+        uint32_t formatCount = 0, presentModeCount = 0;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(
+            physical_device, surface, &formatCount, nullptr
+        );
+        vkGetPhysicalDeviceSurfacePresentModesKHR(
+            physical_device, surface, &presentModeCount, nullptr
+        );
+        if (formatCount == 0) {
+            throw runtime_error("no surface formats supported");
+        }
+        if (presentModeCount == 0) {
+            throw runtime_error("no surface present modes supported");
+        }
+        auto formats = make_unique<VkSurfaceFormatKHR[]>(formatCount);
+        auto presentModes = make_unique<VkPresentModeKHR[]>(presentModeCount);
 
-    vkGetPhysicalDeviceSurfaceFormatsKHR(
-        physical_device, surface, &formatCount, formats.get()
-    );
-    vkGetPhysicalDeviceSurfacePresentModesKHR(
-        physical_device, surface, &presentModeCount, presentModes.get()
-    );
+        vkGetPhysicalDeviceSurfaceFormatsKHR(
+            physical_device, surface, &formatCount, formats.get()
+        );
+        vkGetPhysicalDeviceSurfacePresentModesKHR(
+            physical_device, surface, &presentModeCount, presentModes.get()
+        );
 
-    auto surface_format = formats[0];
-    for (auto i = 0u; i < formatCount; i++) {
-        auto format = formats[i];
-        if (
-            format.format == VK_FORMAT_A2B10G10R10_UNORM_PACK32 &&
-            format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR
-        ) {
-            surface_format = format;
+        present_mode = choose_present_mode(
+            preference, vector<VkPresentModeKHR>(
+                presentModes.get(), presentModes.get() + presentModeCount
+            )
+        );
+        cout << "presenting with " << present_mode_name(present_mode) << endl;
+
+        surface_format = formats[0];
+        for (auto i = 0u; i < formatCount; i++) {
+            auto format = formats[i];
+            if (
+                format.format == VK_FORMAT_A2B10G10R10_UNORM_PACK32 &&
+                format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR
+            ) {
+                surface_format = format;
+            }
         }
     }
 
-    // create command pool
-    VkCommandPool command_pool;
-    {
-        VkCommandPoolCreateInfo createInfo{
-            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-            .queueFamilyIndex = graphics_queue_family,
-        };
-        check(vkCreateCommandPool(device, &createInfo, nullptr, &command_pool));
-    }
-
-    std::string document_file_name = "examples/example.json";
-
     document document = from_file(document_file_name.c_str());
 
     renderer renderer;
+    renderer.shader_binaries = make_unique<shader_cache>(
+        cache_directory() / "shaders", 64 * 1024 * 1024
+    );
+    renderer.physical_device_properties = physical_device_properties;
     renderer.graphics_queue_family = graphics_queue_family;
     renderer.present_queue_family = present_queue_family;
+    renderer.compute_queue_family = compute_queue_family;
+    renderer.transfer_queue_family = transfer_queue_family;
+    renderer.graphics_timestamp_bits =
+        queueFamilies[graphics_queue_family].timestampValidBits;
+    renderer.compute_timestamp_bits =
+        queueFamilies[compute_queue_family].timestampValidBits;
+    renderer.physical_device = physical_device;
     vkGetPhysicalDeviceMemoryProperties(
         physical_device, &renderer.physical_device_memory_properties
     );
+    renderer.allocator = make_unique<device_allocator>(
+        device, renderer.physical_device_memory_properties
+    );
+    renderer.pipeline_creation_feedback = pipeline_creation_feedback;
+    renderer.pipeline_cache = load_pipeline_cache(
+        device, physical_device_properties, pipeline_cache_file_name.c_str()
+    );
 
     {
-        int framebuffer_width, framebuffer_height;
-        glfwGetFramebufferSize(
-            window, &framebuffer_width, &framebuffer_height
+        auto start = chrono::steady_clock::now();
+        render_document render_document(
+            document, renderer,
+            surface_format.format,
+            headless ?
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL :
+                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
         );
-        view view = {
-            static_cast<unsigned int>(framebuffer_width),
-            static_cast<unsigned int>(framebuffer_height),
-            renderer, document,
-            device, physical_device,
-            command_pool, graphics_queue_family, present_queue_family,
-            surface, surface_format
-        };
+        cout <<
+            "built document in " <<
+            chrono::duration<double, milli>(
+                chrono::steady_clock::now() - start
+            ).count() << " ms" << endl;
+
+        // the first frame needs the meshes, later changes are uploaded in
+        // the background
+        start = chrono::steady_clock::now();
+        upload_queue uploads(renderer, transferQueue);
+        render_meshes meshes(
+            load_meshes(mesh_sources(document), renderer), renderer, uploads
+        );
+        uploads.wait(meshes.upload_ticket);
+        cout <<
+            "loaded meshes in " <<
+            chrono::duration<double, milli>(
+                chrono::steady_clock::now() - start
+            ).count() << " ms" << endl;
+        meshes.print_statistics(cout);
+        uploads.print_statistics(cout);
+        renderer.allocator->print_statistics(cout);
+
+        // the animate frame actions run on the cpu, their results go into
+        // the uniform ring with the static uniforms
+        uniform_animator animator(document);
+        gpu_profiler profiler(document, render_document.graph, renderer);
+        ::trace trace;
+        auto trace_pointer = trace_file_name ? &trace : nullptr;
+        if (headless) {
+            render_headless(
+                render_document, meshes, animator, document.uniforms,
+                renderer, graphicsQueue, computeQueue, surface_format.format,
+                initial_window_width, initial_window_height, headless_frames,
+                frames_in_flight, output_file_name, profiler, trace_pointer
+            );
+        } else {
+            int framebuffer_width, framebuffer_height;
+            glfwGetFramebufferSize(
+                window, &framebuffer_width, &framebuffer_height
+            );
+            view view = {
+                static_cast<unsigned int>(framebuffer_width),
+                static_cast<unsigned int>(framebuffer_height),
+                render_document, meshes, document.uniforms, renderer,
+                device, physical_device,
+                graphics_queue_family, present_queue_family,
+                graphicsQueue, surface, surface_format, present_mode,
+                VK_NULL_HANDLE
+            };
 
-        unique_semaphore swapchain_image_ready_semaphore;
-        {
-            VkSemaphoreCreateInfo semaphore_info = {
-                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            // used in turn, whichever images they render to
+            vector<frame_resources> frames(frames_in_flight);
+            auto animation_start = chrono::steady_clock::now();
+            unsigned frame_index = 0;
+
+            // the refresh interval follows the window between monitors
+            optional<frame_pacer> pacer;
+            if (preference != present_preference::throughput)
+                pacer.emplace(refresh_interval(window));
+            int window_x, window_y;
+            glfwGetWindowPos(window, &window_x, &window_y);
+
+            // shaders, meshes and the document are rebuilt when they are
+            // saved
+            file_watcher watcher;
+            auto watch_inputs = [&] {
+                for (const auto& users : render_document.shader_users)
+                    watcher.watch(users.first);
+                for (const auto& users : render_document.compute_shader_users)
+                    watcher.watch(users.first);
+                for (auto name : document.meshes.file_names)
+                    watcher.watch(referenced_file_name(document, name));
+            };
+            watcher.watch(document_file_name);
+            watch_inputs();
+
+            // edit_time is when the last reloaded file was written, the
+            // latency is reported once the first frame after it finished
+            optional<chrono::steady_clock::time_point> edit_time;
+            VkFence reload_fence = VK_NULL_HANDLE;
+            auto report_reload = [&] {
+                if (
+                    reload_fence == VK_NULL_HANDLE ||
+                    vkGetFenceStatus(device, reload_fence) != VK_SUCCESS
+                )
+                    return;
+                cout <<
+                    "edit to pixels in " <<
+                    chrono::duration<double, milli>(
+                        chrono::steady_clock::now() - *edit_time
+                    ).count() << " ms" << endl;
+                edit_time.reset();
+                reload_fence = VK_NULL_HANDLE;
+            };
+            // timestamps are read once the frame finished, before the
+            // image is submitted again or re-created
+            vector<uint64_t> timestamps;
+            auto read_timestamps = [&](const render_image& image) {
+                if (auto submitted = image.read_timestamps(timestamps))
+                    profiler.add_frame(timestamps, *submitted, trace_pointer);
+            };
+            auto wait_for_frames = [&] {
+                for (auto& frame : frames) {
+                    auto fence = frame.fence.get();
+                    vkWaitForFences(device, 1, &fence, VK_TRUE, -1ul);
+                }
+                for (auto& image : view.images)
+                    read_timestamps(image);
+                report_reload();
             };
-            vkCreateSemaphore(
-                device, &semaphore_info, nullptr,
-                out_ptr(swapchain_image_ready_semaphore)
-            );
-        }
 
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+            // changed mesh files are loaded on a job thread and uploaded
+            // over the following frames, which draw the previous meshes
+            // until then, edits during a load load the meshes once more
+            bool reload_meshes = false;
+            optional<chrono::steady_clock::time_point> mesh_edit_time;
+            mesh_sources loading_sources;
+            future<mesh_data> loading_meshes;
+            optional<render_meshes> uploading_meshes;
+
+            while (!glfwWindowShouldClose(window)) {
+                // spans of the last frame, which ended with this one's
+                // frame scope
+                collect_instrumentation(trace_pointer);
+                INSTRUMENT_SCOPE("frame");
+                if (pacer) {
+                    INSTRUMENT_SCOPE("pace");
+                    pacer->wait();
+                }
+                {
+                    INSTRUMENT_SCOPE("poll events");
+                    glfwPollEvents();
+                }
+                report_reload();
+
+                auto changed_files = watcher.poll();
+                if (pacer)
+                    pacer->input_sampled();
+                if (!changed_files.empty()) {
+                    // file times are on another clock
+                    auto written = filesystem::file_time_type::min();
+                    for (const auto& file : changed_files) {
+                        error_code error;
+                        written = max(
+                            written, filesystem::last_write_time(file, error)
+                        );
+                    }
+                    auto since_written = max(
+                        chrono::duration_cast<chrono::steady_clock::duration>(
+                            filesystem::file_time_type::clock::now() - written
+                        ),
+                        chrono::steady_clock::duration::zero()
+                    );
+                    auto written_time =
+                        chrono::steady_clock::now() - since_written;
+
+                    // replaced pipelines may still be in use
+                    bool uniforms_moved = false, meshes_changed = false;
+                    bool reloaded;
+                    {
+                        INSTRUMENT_SCOPE("reload");
+                        wait_for_frames();
+                        reloaded = reload(
+                            changed_files, document_file_name, document,
+                            render_document, meshes, renderer, uploads,
+                            uniforms_moved, meshes_changed
+                        );
+                        profiler.set_actions(
+                            document, render_document.graph
+                        );
+                    }
+                    if (meshes_changed) {
+                        reload_meshes = true;
+                        mesh_edit_time = written_time;
+                    }
+                    if (reloaded) {
+                        animator = uniform_animator(document);
+                        if (uniforms_moved)
+                            view.uniforms = uniform_ring(
+                                render_document, document.uniforms, renderer,
+                                view.image_count
+                            );
+                        view.record(
+                            render_document, meshes, renderer,
+                            surface_format.format, graphicsQueue
+                        );
+                        watch_inputs();
+                        edit_time = written_time;
+                        reload_fence = VK_NULL_HANDLE;
+                    }
+                }
 
-            // get next image from swapchain
-            uint32_t image_index;
-            auto result = vkAcquireNextImageKHR(
-                device, view.swapchain.get(), -1ul,
-                swapchain_image_ready_semaphore.get(),
-                VK_NULL_HANDLE,
-                &image_index
-            );
+                if (
+                    loading_meshes.valid() &&
+                    loading_meshes.wait_for(chrono::seconds(0)) ==
+                    future_status::ready
+                ) {
+                    try {
+                        auto data = loading_meshes.get();
+                        if (
+                            !reload_meshes && same_meshes(
+                                loading_sources, mesh_sources(document)
+                            )
+                        )
+                            uploading_meshes.emplace(
+                                std::move(data), renderer, uploads
+                            );
+                    } catch (const exception& error) {
+                        cerr << "reload failed: " << error.what() << endl;
+                    }
+                }
+                if (
+                    reload_meshes && !loading_meshes.valid() &&
+                    !uploading_meshes
+                ) {
+                    reload_meshes = false;
+                    loading_sources = mesh_sources(document);
+                    loading_meshes = async(launch::async, [&] {
+                        return load_meshes(loading_sources, renderer);
+                    });
+                }
+                uploads.submit();
+                if (
+                    uploading_meshes &&
+                    uploads.finished(uploading_meshes->upload_ticket)
+                ) {
+                    // the document may have changed the meshes meanwhile
+                    if (same_meshes(
+                        loading_sources, mesh_sources(document)
+                    )) {
+                        wait_for_frames();
+                        meshes = std::move(*uploading_meshes);
+                        meshes.print_statistics(cout);
+                        uploads.print_statistics(cout);
+                        view.record(
+                            render_document, meshes, renderer,
+                            surface_format.format, graphicsQueue
+                        );
+                        edit_time = mesh_edit_time;
+                        reload_fence = VK_NULL_HANDLE;
+                    }
+                    uploading_meshes.reset();
+                }
 
-            if (result == VK_SUCCESS) {
-                auto& document = view.documents[image_index];
-                VkFence fence = document.fence.get();
-                vkWaitForFences(device, 1, &fence, VK_TRUE, -1ul);
-                vkResetFences(device, 1, &fence);
-
-                // submit command buffer
-                VkPipelineStageFlags wait_stage =
-                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-                VkSemaphore render_finished_semaphore =
-                    document.render_finished_semaphore.get();
-                VkSemaphore wait_semaphore =
-                    swapchain_image_ready_semaphore.get();
-                VkSubmitInfo submitInfo = {
-                    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                    .waitSemaphoreCount = 1,
-                    .pWaitSemaphores = &wait_semaphore,
-                    .pWaitDstStageMask = &wait_stage,
-                    .commandBufferCount = 1,
-                    .pCommandBuffers = &document.command_buffer,
-                    .signalSemaphoreCount = 1,
-                    .pSignalSemaphores = &render_finished_semaphore,
-                };
-                check(vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence));
-
-                auto swapchain = view.swapchain.get();
-
-                // present image
-                VkPresentInfoKHR presentInfo{
-                    .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-                    .waitSemaphoreCount = 1,
-                    .pWaitSemaphores = &render_finished_semaphore,
-                    .swapchainCount = 1,
-                    .pSwapchains = &swapchain,
-                    .pImageIndices = &image_index,
-                };
-                vkQueuePresentKHR(presentQueue, &presentInfo);
-
-            } else if (
-                result == VK_SUBOPTIMAL_KHR ||
-                result == VK_ERROR_OUT_OF_DATE_KHR
-            ) {
-                for (auto& document : view.documents) {
-                    auto fence = document.fence.get();
+                // the oldest frame in flight has to finish before its
+                // semaphore and fence are used again
+                auto& frame = frames[frame_index];
+                VkFence fence = frame.fence.get();
+                {
+                    INSTRUMENT_SCOPE("wait for frame");
                     vkWaitForFences(device, 1, &fence, VK_TRUE, -1ul);
                 }
+                report_reload();
+
+                // get next image from swapchain
+                uint32_t image_index;
+                VkResult result;
+                {
+                    INSTRUMENT_SCOPE("acquire");
+                    auto acquire_start = chrono::steady_clock::now();
+                    result = vkAcquireNextImageKHR(
+                        device, view.swapchain.get(), -1ul,
+                        frame.image_ready_semaphore.get(),
+                        VK_NULL_HANDLE,
+                        &image_index
+                    );
+                    if (pacer)
+                        pacer->blocked(
+                            acquire_start, chrono::steady_clock::now()
+                        );
+                }
 
-                int framebuffer_width, framebuffer_height;
-                glfwGetFramebufferSize(
-                    window, &framebuffer_width, &framebuffer_height
-                );
-                if (framebuffer_height > 0 && framebuffer_width > 0) {
-                    // destroy view first
+                bool out_of_date = false;
+
+                if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+                    // the image may still be rendered by another frame,
+                    // with more frames in flight than images
+                    auto& image = view.images[image_index];
+                    auto& image_fence = view.image_fences[image_index];
+                    if (image_fence != VK_NULL_HANDLE && image_fence != fence) {
+                        INSTRUMENT_SCOPE("wait for image");
+                        vkWaitForFences(device, 1, &image_fence, VK_TRUE, -1ul);
+                    }
+                    image_fence = fence;
+                    read_timestamps(image);
+                    vkResetFences(device, 1, &fence);
+                    animator.evaluate(
+                        frame_inputs(
+                            view.extent.width, view.extent.height,
+                            chrono::duration<float>(
+                                chrono::steady_clock::now() - animation_start
+                            ).count()
+                        ),
+                        document.uniforms
+                    );
+                    view.uniforms.upload(
+                        render_document, document.uniforms, image_index
+                    );
+
+                    // submit command buffers
+                    VkSemaphore render_finished_semaphore =
+                        image.render_finished_semaphore.get();
                     {
-                        ::view old;
-                        std::swap(old, view);
+                        INSTRUMENT_SCOPE("submit");
+                        image.submit(
+                            graphicsQueue, computeQueue, view.parity,
+                            frame.image_ready_semaphore.get(),
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            view.last_frame, render_finished_semaphore, fence
+                        );
                     }
-                    view = {
-                        static_cast<unsigned int>(framebuffer_width),
-                        static_cast<unsigned int>(framebuffer_height),
-                        renderer, document,
-                        device, physical_device,
-                        command_pool, graphics_queue_family,
-                        present_queue_family,
-                        surface, surface_format
+                    frame_index = (frame_index + 1) % frames_in_flight;
+                    view.parity ^= 1;
+                    view.last_frame = image.graphics_finished_semaphore.get();
+                    if (edit_time && reload_fence == VK_NULL_HANDLE)
+                        reload_fence = fence;
+
+                    auto swapchain = view.swapchain.get();
+
+                    // present image
+                    VkPresentInfoKHR presentInfo{
+                        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                        .waitSemaphoreCount = 1,
+                        .pWaitSemaphores = &render_finished_semaphore,
+                        .swapchainCount = 1,
+                        .pSwapchains = &swapchain,
+                        .pImageIndices = &image_index,
                     };
+                    VkResult present_result;
+                    {
+                        INSTRUMENT_SCOPE("present");
+                        present_result =
+                            vkQueuePresentKHR(presentQueue, &presentInfo);
+                    }
+                    if (pacer)
+                        pacer->presented();
+
+                    // an acquired image has to be presented before recreating
+                    out_of_date =
+                        result == VK_SUBOPTIMAL_KHR ||
+                        present_result == VK_SUBOPTIMAL_KHR ||
+                        present_result == VK_ERROR_OUT_OF_DATE_KHR;
+
+                } else if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                    out_of_date = true;
+
+                } else {
+                    check(result);
                 }
 
-            } else {
-                check(result);
+                if (out_of_date) {
+                    wait_for_frames();
+                    reload_fence = VK_NULL_HANDLE;
+
+                    int framebuffer_width, framebuffer_height;
+                    glfwGetFramebufferSize(
+                        window, &framebuffer_width, &framebuffer_height
+                    );
+                    if (framebuffer_height > 0 && framebuffer_width > 0) {
+                        // the old swapchain has to stay alive until the new one
+                        // is created from it, pipelines are reused
+                        ::view old_view = std::move(view);
+                        view = {
+                            static_cast<unsigned int>(framebuffer_width),
+                            static_cast<unsigned int>(framebuffer_height),
+                            render_document, meshes, document.uniforms,
+                            renderer,
+                            device, physical_device,
+                            graphics_queue_family, present_queue_family,
+                            graphicsQueue, surface, surface_format,
+                            present_mode, old_view.swapchain.get()
+                        };
+                    }
+                }
+
+                int x, y;
+                glfwGetWindowPos(window, &x, &y);
+                if (pacer && (x != window_x || y != window_y)) {
+                    pacer->set_refresh_interval(refresh_interval(window));
+                    window_x = x;
+                    window_y = y;
+                }
             }
 
-            // TODO: swapchain doesn't necessarily sync with current monitor
-            // use VK_KHR_display to wait for vsync of current display
+            // TODO: destructors don't wait on exception
+            wait_for_frames();
+            if (uploading_meshes)
+                uploads.wait(uploading_meshes->upload_ticket);
+            if (pacer)
+                pacer->print_statistics(cout);
         }
 
-        // TODO: destructors don't wait on exception
-        for(auto& document : view.documents) {
-            auto fence = document.fence.get();
-            vkWaitForFences(device, 1, &fence, VK_TRUE, -1u);
-        }
+        collect_instrumentation(trace_pointer);
+        profiler.print_statistics(cout);
+        print_instrumentation(cout);
+        if (trace_file_name != nullptr)
+            trace.save(trace_file_name);
     }
 
-    vkDestroyCommandPool(device, command_pool, nullptr);
+    renderer.shader_binaries->print_statistics(cout);
+    renderer.pipeline_statistics.print(cout);
 
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    // pipeline cache and memory have to be destroyed before the device
+    save_pipeline_cache(
+        device, renderer.pipeline_cache.get(),
+        pipeline_cache_file_name.c_str()
+    );
+    renderer.pipeline_cache.reset();
+    renderer.allocator.reset();
+
+    if (!headless)
+        vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyDevice(device, nullptr);
 #ifdef EDITOR_VULKAN_VALIDATION
     vkDestroyDebugUtilsMessengerEXT(instance, debugUtilsMessenger, nullptr);
 #endif
     vkDestroyInstance(instance, nullptr);
 
-    glfwDestroyWindow(window);
+    if (!headless) {
+        glfwDestroyWindow(window);
 
-    glfwTerminate();
+        glfwTerminate();
+    }
 
     return 0;
 }
@@ -1,164 +1,249 @@
 #include "document.h"
 
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+
+#include "../data/instrumentation.h"
+#include "jobs.h"
+
+// sorts by destination and joins runs that are adjacent in both source and
+// destination, runs that are written twice by both shaders are dropped
+static void merge_copies(std::vector<uniform_copy>& copies) {
+    std::sort(
+        copies.begin(), copies.end(),
+        [](const uniform_copy& a, const uniform_copy& b) {
+            return a.destination < b.destination;
+        }
+    );
+    size_t end = 0;
+    for (const auto& copy : copies) {
+        if (end > 0) {
+            auto& last = copies[end - 1];
+            if (
+                copy.destination == last.destination &&
+                copy.source == last.source && copy.size == last.size
+            )
+                continue;
+            if (
+                copy.destination == last.destination + last.size &&
+                copy.source == last.source + last.size
+            ) {
+                last.size += copy.size;
+                continue;
+            }
+        }
+        copies[end++] = copy;
+    }
+    copies.resize(end);
+}
+
+// resolves the uniform names of an action to copies into its slot, names
+// only are looked up here, uploads just run the copies
+static void plan_uniforms(
+    const document& source, range uniform_range,
+    std::initializer_list<const reflected_shader_module*> shaders,
+    uint32_t uniform_size, std::vector<uniform_copy>& copies
+) {
+    auto& uniforms = source.uniforms;
+    auto first_value = uniform_range.count == 0 ?
+        0 : uniforms.offsets[uniform_range.first];
+    for (
+        auto i = uniform_range.first;
+        i < uniform_range.first + uniform_range.count; i++
+    ) {
+        std::string name(source.strings[uniforms.names[i]]);
+        for (auto shader : shaders) {
+            auto offset = shader->descriptor_offsets.find(name);
+            if (
+                offset == shader->descriptor_offsets.end() ||
+                offset->second >= uniform_size
+            )
+                continue;
+            copies.push_back({
+                .source = (uniforms.offsets[i] - first_value) * 4,
+                .destination = offset->second,
+                .size = std::min(
+                    uniforms.data_size(i), uniform_size - offset->second
+                ),
+            });
+        }
+    }
+    merge_copies(copies);
+}
+
+// values may differ, but the plan depends on names and sizes
+static bool same_uniforms(
+    const document& previous, const document& current, range a, range b
+) {
+    if (a.count != b.count)
+        return false;
+    for (auto i = 0u; i < a.count; i++) {
+        auto j = a.first + i, k = b.first + i;
+        if (
+            previous.strings[previous.uniforms.names[j]] !=
+            current.strings[current.uniforms.names[k]] ||
+            previous.uniforms.types[j] != current.uniforms.types[k]
+        )
+            return false;
+    }
+    return true;
+}
+
+// vertex inputs are bound by name to attributes, whose formats are part of
+// the pipeline and whose index the draw uses
+static bool same_attributes(
+    const document& previous, const document& current, range a, range b
+) {
+    if (a.count != b.count)
+        return false;
+    for (auto i = 0u; i < a.count; i++) {
+        auto j = a.first + i, k = b.first + i;
+        auto attribute = current.bindings.attributes[k];
+        if (
+            previous.strings[previous.bindings.names[j]] !=
+            current.strings[current.bindings.names[k]] ||
+            previous.bindings.attributes[j] != attribute || (
+                attribute != no_attribute &&
+                previous.meshes.attribute_formats[attribute] !=
+                current.meshes.attribute_formats[attribute]
+            ) || (
+                attribute != no_attribute &&
+                previous.meshes.attribute_meshes[attribute] !=
+                current.meshes.attribute_meshes[attribute]
+            )
+        )
+            return false;
+    }
+    return true;
+}
+
+// descriptors are bound by name to the textures and buffers
+static bool same_bindings(
+    const document& previous, const document& current, range a, range b
+) {
+    if (a.count != b.count)
+        return false;
+    for (auto i = 0u; i < a.count; i++) {
+        auto j = a.first + i, k = b.first + i;
+        if (
+            previous.strings[previous.bindings.names[j]] !=
+            current.strings[current.bindings.names[k]] ||
+            previous.bindings.textures[j] != current.bindings.textures[k] ||
+            previous.bindings.buffers[j] != current.bindings.buffers[k]
+        )
+            return false;
+    }
+    return true;
+}
+
+static bool same_program(
+    const document& previous, const document& current, uint32_t index
+) {
+    auto& a = previous.programs;
+    auto& b = current.programs;
+    return
+        previous.strings[a.vertex_shaders[index]] ==
+        current.strings[b.vertex_shaders[index]] &&
+        previous.strings[a.fragment_shaders[index]] ==
+        current.strings[b.fragment_shaders[index]] &&
+        a.outs[index].count == b.outs[index].count &&
+        same_uniforms(
+            previous, current, a.uniforms[index], b.uniforms[index]
+        ) &&
+        same_attributes(previous, current, a.ins[index], b.ins[index]) &&
+        same_bindings(previous, current, a.ins[index], b.ins[index]);
+}
+
+static bool same_compute(
+    const document& previous, const document& current, uint32_t index
+) {
+    auto& a = previous.computes;
+    auto& b = current.computes;
+    return
+        previous.strings[a.shaders[index]] ==
+        current.strings[b.shaders[index]] &&
+        same_uniforms(
+            previous, current, a.uniforms[index], b.uniforms[index]
+        ) &&
+        same_bindings(previous, current, a.ins[index], b.ins[index]) &&
+        same_bindings(previous, current, a.outs[index], b.outs[index]);
+}
+
+std::vector<uint32_t> changed_programs(
+    const document& previous, const document& current
+) {
+    std::vector<uint32_t> changed;
+    for (auto i = 0u; i < current.programs.size(); i++) {
+        if (
+            i >= previous.programs.size() ||
+            !same_program(previous, current, i)
+        )
+            changed.push_back(i);
+    }
+    return changed;
+}
+
+std::vector<uint32_t> changed_computes(
+    const document& previous, const document& current
+) {
+    std::vector<uint32_t> changed;
+    for (auto i = 0u; i < current.computes.size(); i++) {
+        if (
+            i >= previous.computes.size() ||
+            !same_compute(previous, current, i)
+        )
+            changed.push_back(i);
+    }
+    return changed;
+}
+
+static std::vector<unique_render_pass> create_render_passes(
+    const render_graph& graph, VkFormat output_format
+) {
+    std::vector<unique_render_pass> render_passes;
+    for (auto i = 0u; i < graph.passes.size(); i++)
+        render_passes.push_back(create_render_pass(graph, i, output_format));
+    return render_passes;
+}
+
+// only reads shared state, so it can run for several actions in parallel
 struct compile_action_functor {
     const renderer &renderer;
-    render_document &document;
-    VkImageLayout output_layout;
+    const render_document &document;
+    const render_graph &graph;
+    const std::vector<unique_render_pass> &render_passes;
+    const ::document &source;
+    std::optional<render_program_action> &result;
+    // destinations are relative to the uniform slot of the action
+    std::vector<uniform_copy> &copies;
 
-    void operator() (const std::unique_ptr<program_action> &action_pointer) {
-        auto &action = *action_pointer;
+    void operator() (uint32_t program_index) {
+        auto& programs = source.programs;
+        auto shader_path = [&](string_id name) {
+            return referenced_file_name(source, name);
+        };
 
         reflected_shader_module vertex_shader(
             renderer, *current_device,
-            ("examples/" + action.vertex_shader).c_str(), // TODO
+            shader_path(programs.vertex_shaders[program_index]).c_str(),
             shaderc_glsl_vertex_shader
         );
         reflected_shader_module fragment_shader(
             renderer, *current_device,
-            ("examples/" + action.fragment_shader).c_str(), // TODO
+            shader_path(programs.fragment_shaders[program_index]).c_str(),
             shaderc_glsl_fragment_shader
         );
 
-        auto descriptor_size =
-            vertex_shader.descriptor_size + fragment_shader.descriptor_size;
-
-        VkDescriptorSetLayoutBinding descriptor_set_layout_binding = {
-            .binding = 0,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = 1,
-            .stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS,
-        };
-        VkDescriptorSetLayoutCreateInfo descriptor_set_info = {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-            .bindingCount = 1,
-            .pBindings = &descriptor_set_layout_binding,
-        };
-        unique_descriptor_set_layout descriptor_set_layout;
-        check(vkCreateDescriptorSetLayout(
-            *current_device, &descriptor_set_info,
-            nullptr, out_ptr(descriptor_set_layout)
-        ));
-
-        uint32_t queue_family_index = renderer.graphics_queue_family;
-        VkBufferCreateInfo uniform_buffer_info = {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .size = descriptor_size,
-            .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-            .queueFamilyIndexCount = 1,
-            .pQueueFamilyIndices = &queue_family_index,
-        };
-        unique_buffer uniform_buffer;
-        unique_device_memory uniform_memory;
-        void* uniform_data;
-        if (descriptor_size > 0) {
-            check(vkCreateBuffer(
-                *current_device, &uniform_buffer_info, nullptr,
-                out_ptr(uniform_buffer)
-            ));
-            VkMemoryRequirements memory_requirements;
-            vkGetBufferMemoryRequirements(
-                *current_device, uniform_buffer.get(), &memory_requirements
-            );
-            VkMemoryPropertyFlags properties =
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-            uint32_t memory_type_index;
-            for (
-                memory_type_index = 0;
-                memory_type_index <
-                renderer.physical_device_memory_properties.memoryTypeCount;
-                memory_type_index++
-            ) {
-                if (
-                    (
-                        memory_requirements.memoryTypeBits &
-                        (1 << memory_type_index)
-                    ) && (
-                        renderer.physical_device_memory_properties.memoryTypes[
-                            memory_type_index
-                        ].propertyFlags &
-                        properties
-                    )
-                )
-                    break;
-            }
-            VkMemoryAllocateInfo allocate_info = {
-                .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-                .allocationSize = memory_requirements.size,
-                .memoryTypeIndex = memory_type_index,
-            };
-            check(vkAllocateMemory(
-                *current_device, &allocate_info, nullptr,
-                out_ptr(uniform_memory)
-            ));
-            check(vkBindBufferMemory(
-                *current_device, uniform_buffer.get(), uniform_memory.get(), 0
-            ));
-
-            vkMapMemory(
-                *current_device, uniform_memory.get(), 0,
-                descriptor_size, 0, &uniform_data
-            );
-
-            for (const auto& uniform : action.uniforms) {
-                auto span = get_data_pointer(uniform.second);
-                for (auto shader : {&vertex_shader, &fragment_shader}) {
-                    auto offset =
-                        shader->descriptor_offsets.find(uniform.first);
-                    if (offset != shader->descriptor_offsets.end()) {
-                        memcpy(
-                            reinterpret_cast<uint8_t*>(uniform_data) +
-                            offset->second,
-                            span.first, span.second
-                        );
-                    }
-                }
-            }
-        }
-
-        VkDescriptorPoolSize pool_size = {
-            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .descriptorCount = 1, // TODO: share between swap chain images
-        };
-        VkDescriptorPoolCreateInfo pool_info = {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-            .maxSets = 1,  // TODO: share between swap chain images
-            .poolSizeCount = 1,
-            .pPoolSizes = &pool_size,
-        };
-        unique_descriptor_pool descriptor_pool;
-        check(vkCreateDescriptorPool(
-            *current_device, &pool_info, nullptr, out_ptr(descriptor_pool))
+        // both stages read the same buffer, so their blocks overlap
+        uint32_t uniform_size = std::max(
+            vertex_shader.descriptor_size, fragment_shader.descriptor_size
         );
 
-        VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            .descriptorPool = descriptor_pool.get(),
-            .descriptorSetCount = 1, // TODO: share between swap chain images
-            .pSetLayouts = &descriptor_set_layout.get(),
-        };
-        VkDescriptorSet descriptor_set;
-        check(vkAllocateDescriptorSets(
-            *current_device, &descriptor_set_allocate_info, &descriptor_set
-        ));
-
-        VkDescriptorBufferInfo descriptor_buffer_info = {
-            .buffer = uniform_buffer.get(),
-            .offset = 0,
-            .range = descriptor_size,
-        };
-        VkWriteDescriptorSet write_descriptor_set = {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = descriptor_set,
-            .dstBinding = 0,
-            .dstArrayElement = 0,
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .pBufferInfo = &descriptor_buffer_info,
-        };
-        vkUpdateDescriptorSets(
-            *current_device, 1, &write_descriptor_set, 0, nullptr
+        plan_uniforms(
+            source, programs.uniforms[program_index],
+            {&vertex_shader, &fragment_shader}, uniform_size, copies
         );
 
         VkPipelineShaderStageCreateInfo pipeline_shader_stage_info[] = {
@@ -174,33 +259,186 @@ struct compile_action_functor {
                 .pName = "main",
             },
         };
+        // every input reads the mesh attribute the ins bind to its name,
+        // with a binding of its own, since attributes are regions of the
+        // buffer of the mesh, programs without inputs draw vertex_count
+        // vertices as strip
+        std::vector<VkVertexInputBindingDescription> vertex_bindings;
+        std::vector<VkVertexInputAttributeDescription> vertex_inputs;
+        std::vector<uint32_t> vertex_attributes;
+        auto ins = programs.ins[program_index];
+        for (const auto& input : vertex_shader.inputs) {
+            auto attribute = no_attribute;
+            for (auto i = ins.first; i < ins.first + ins.count; i++)
+                if (source.strings[source.bindings.names[i]] == input.name)
+                    attribute = source.bindings.attributes[i];
+            if (attribute == no_attribute)
+                throw std::runtime_error(
+                    "Vertex input " + input.name +
+                    " isn't bound to a mesh attribute"
+                );
+            auto format = vertex_format(
+                renderer, source.meshes.attribute_formats[attribute]
+            );
+            auto binding = static_cast<uint32_t>(vertex_bindings.size());
+            vertex_bindings.push_back({
+                .binding = binding,
+                .stride = vertex_size(format),
+                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+            });
+            vertex_inputs.push_back({
+                .location = input.location,
+                .binding = binding,
+                .format = format,
+                .offset = 0,
+            });
+            vertex_attributes.push_back(attribute);
+        }
+        auto mesh = vertex_attributes.empty() ?
+            no_mesh : programs.meshes[program_index];
+
+        // sampled images are found by name in the ins, programs sampling
+        // any get a layout of their own, with the uniform block at the
+        // binding of the shared layout
+        auto shader_name = [&](const reflected_shader_module* shader) {
+            return shader_path(
+                shader == &vertex_shader ?
+                programs.vertex_shaders[program_index] :
+                programs.fragment_shaders[program_index]
+            );
+        };
+        std::vector<descriptor_binding> bindings;
+        std::vector<VkDescriptorSetLayoutBinding> layout_bindings;
+        auto samples = false;
+        for (auto shader : {&vertex_shader, &fragment_shader}) {
+            auto error = [&](const std::string& message) {
+                return std::runtime_error(
+                    message + " in " + shader_name(shader)
+                );
+            };
+            auto stage = shader == &vertex_shader ?
+                VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_FRAGMENT_BIT;
+            for (const auto& reflected : shader->bindings) {
+                if (reflected.set != 0)
+                    throw error(
+                        "Descriptor " + reflected.name + " not in set 0"
+                    );
+                descriptor_binding binding = {
+                    reflected.binding,
+                    static_cast<VkDescriptorType>(reflected.type),
+                    no_texture, no_buffer,
+                };
+                if (binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+                    binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                } else if (
+                    binding.type ==
+                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+                    binding.type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+                ) {
+                    for (auto i = ins.first; i < ins.first + ins.count; i++)
+                        if (
+                            source.strings[source.bindings.names[i]] ==
+                            reflected.name
+                        )
+                            binding.texture = source.bindings.textures[i];
+                    if (
+                        binding.texture == no_texture ||
+                        binding.texture == built_in_window
+                    )
+                        throw error("Texture expected for " + reflected.name);
+                    samples = true;
+                } else if (binding.type == VK_DESCRIPTOR_TYPE_SAMPLER) {
+                    samples = true;
+                } else {
+                    throw error("Unsupported descriptor " + reflected.name);
+                }
+
+                // both stages may use the same descriptor
+                auto same = std::find_if(
+                    bindings.begin(), bindings.end(),
+                    [&](const descriptor_binding& other) {
+                        return other.binding == binding.binding;
+                    }
+                );
+                if (same == bindings.end()) {
+                    bindings.push_back(binding);
+                    layout_bindings.push_back({
+                        .binding = binding.binding,
+                        .descriptorType = binding.type,
+                        .descriptorCount = 1,
+                        .stageFlags = static_cast<VkShaderStageFlags>(stage),
+                    });
+                } else if (
+                    same->type != binding.type ||
+                    same->texture != binding.texture
+                ) {
+                    throw error(
+                        "Binding " + std::to_string(binding.binding) +
+                        " of " + reflected.name +
+                        " differs from the vertex shader"
+                    );
+                } else {
+                    layout_bindings[same - bindings.begin()].stageFlags |=
+                        stage;
+                }
+            }
+        }
+        unique_descriptor_set_layout descriptor_set_layout;
+        unique_pipeline_layout pipeline_layout;
+        if (samples) {
+            VkDescriptorSetLayoutCreateInfo descriptor_set_info = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .bindingCount = static_cast<uint32_t>(layout_bindings.size()),
+                .pBindings = layout_bindings.data(),
+            };
+            check(vkCreateDescriptorSetLayout(
+                *current_device, &descriptor_set_info, nullptr,
+                out_ptr(descriptor_set_layout)
+            ));
+            VkDescriptorSetLayout layouts[] = {descriptor_set_layout.get()};
+            VkPipelineLayoutCreateInfo pipeline_layout_info = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .setLayoutCount = 1,
+                .pSetLayouts = layouts,
+            };
+            check(vkCreatePipelineLayout(
+                *current_device, &pipeline_layout_info, nullptr,
+                out_ptr(pipeline_layout)
+            ));
+        } else {
+            bindings.clear();
+        }
         VkPipelineVertexInputStateCreateInfo vertex_input_info = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .vertexBindingDescriptionCount =
+                static_cast<uint32_t>(vertex_bindings.size()),
+            .pVertexBindingDescriptions = vertex_bindings.data(),
+            .vertexAttributeDescriptionCount =
+                static_cast<uint32_t>(vertex_inputs.size()),
+            .pVertexAttributeDescriptions = vertex_inputs.data(),
         };
         VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {
             .sType =
                 VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+            .topology = mesh == no_mesh ?
+                VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP :
+                VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
             .primitiveRestartEnable = VK_FALSE,
         };
-        VkViewport viewport = {
-            .x = 0.0f,
-            .y = 0.0f,
-            .width = static_cast<float>(document.width), // TODO
-            .height = static_cast<float>(document.height),
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f,
-        };
-        VkRect2D scissors = {
-            .offset = {0, 0},
-            .extent = {document.width, document.height},
-        };
+        // viewport and scissors are dynamic so that pipelines don't depend
+        // on the resolution
         VkPipelineViewportStateCreateInfo viewport_info = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
             .viewportCount = 1,
-            .pViewports = &viewport,
             .scissorCount = 1,
-            .pScissors = &scissors,
+        };
+        VkDynamicState dynamic_states[] = {
+            VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
+        };
+        VkPipelineDynamicStateCreateInfo dynamic_state_info = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+            .dynamicStateCount = std::size(dynamic_states),
+            .pDynamicStates = dynamic_states,
         };
         VkPipelineRasterizationStateCreateInfo rasterization_info = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
@@ -216,80 +454,20 @@ struct compile_action_functor {
             .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
             .sampleShadingEnable = VK_FALSE,
         };
-        VkPipelineColorBlendAttachmentState color_blend_attachment = {
-            .blendEnable = VK_FALSE,
-            .colorWriteMask =
-                VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                VK_COLOR_COMPONENT_B_BIT,
-        };
+        auto attachment_count = graph.program_outs[program_index].count;
+        std::vector<VkPipelineColorBlendAttachmentState>
+            color_blend_attachments(attachment_count, {
+                .blendEnable = VK_FALSE,
+                .colorWriteMask =
+                    VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                    VK_COLOR_COMPONENT_B_BIT,
+            });
         VkPipelineColorBlendStateCreateInfo color_blend_info = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
             .logicOpEnable = VK_FALSE,
-            .attachmentCount = 1,
-            .pAttachments = &color_blend_attachment,
-        };
-        VkDescriptorSetLayout layouts[] = { descriptor_set_layout.get() };
-        VkPipelineLayoutCreateInfo pipeline_layout_info = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .setLayoutCount = 1,
-            .pSetLayouts = layouts,
-        };
-        unique_pipeline_layout pipeline_layout;
-        check(vkCreatePipelineLayout(
-            *current_device, &pipeline_layout_info, nullptr,
-            out_ptr(pipeline_layout)
-        ));
-
-        auto attachments =
-            std::make_unique<VkAttachmentDescription[]>(action.out.size());
-        auto attachment_references =
-            std::make_unique<VkAttachmentReference[]>(action.out.size());
-
-        {
-            int i = 0;
-            for (auto& out : action.out) {
-                (void)out;
-                VkImageLayout final_layout;
-                final_layout = output_layout;
-
-                attachments[i] = VkAttachmentDescription{
-                    .format = VK_FORMAT_A2B10G10R10_UNORM_PACK32,
-                    .samples = VK_SAMPLE_COUNT_1_BIT,
-                    .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-                    .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-                    .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                    .stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE,
-                    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                    .finalLayout = final_layout,
-                };
-
-                attachment_references[i] = {
-                    .attachment = static_cast<uint32_t>(i),
-                    .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                };
-
-                i++;
-            }
-        }
-
-        // TODO: some actions could share render passes
-        VkSubpassDescription subpass = {
-            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS, // TODO
-            .colorAttachmentCount = static_cast<uint32_t>(action.out.size()),
-            .pColorAttachments = attachment_references.get()
-        };
-        VkRenderPassCreateInfo render_pass_info = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-            .attachmentCount = static_cast<uint32_t>(action.out.size()),
-            .pAttachments = attachments.get(),
-            .subpassCount = 1,
-            .pSubpasses = &subpass,
+            .attachmentCount = attachment_count,
+            .pAttachments = color_blend_attachments.data(),
         };
-        unique_render_pass render_pass;
-        check(vkCreateRenderPass(
-            *current_device, &render_pass_info, nullptr,
-            out_ptr(render_pass)
-        ));
 
         VkGraphicsPipelineCreateInfo pipeline_info = {
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
@@ -301,121 +479,600 @@ struct compile_action_functor {
             .pRasterizationState = &rasterization_info,
             .pMultisampleState = &multisample_info,
             .pColorBlendState = &color_blend_info,
-            .layout = pipeline_layout.get(),
-            .renderPass = render_pass.get(),
-            .subpass = 0,
+            .pDynamicState = &dynamic_state_info,
+            .layout = samples ?
+                pipeline_layout.get() : document.pipeline_layout.get(),
+            .renderPass =
+                render_passes[graph.program_passes[program_index]].get(),
+            .subpass = graph.program_subpasses[program_index],
             .basePipelineHandle = VK_NULL_HANDLE,
             .basePipelineIndex = -1,
         };
-        unique_pipeline pipeline;
-        check(vkCreateGraphicsPipelines(
-            *current_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
-            out_ptr(pipeline)
-        ));
+        auto pipeline = create_graphics_pipeline(renderer, pipeline_info);
 
-        // TODO: some actions could share framebuffer
-        VkImageView output_view = document.output_view.get();
-        VkFramebufferCreateInfo framebuffer_info = {
-            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            .renderPass = render_pass.get(),
-            .attachmentCount = static_cast<uint32_t>(action.out.size()),
-            .pAttachments = &output_view,
-            .width = document.width,
-            .height = document.height,
-            .layers = 1,
-        };
-        unique_framebuffer framebuffer;
-        check(vkCreateFramebuffer(
-            *current_device, &framebuffer_info, nullptr,
-            out_ptr(framebuffer)
-        ));
+        result.emplace(render_program_action{
+            .pipeline = std::move(pipeline),
+            .descriptor_set_layout = std::move(descriptor_set_layout),
+            .pipeline_layout = std::move(pipeline_layout),
+            .bindings = std::move(bindings),
+            .uniform_copies = {},
+            .uniform_size = uniform_size,
+            .uniform_offset = 0,
+            .uniform_source = 0,
+            .vertex_count = programs.vertex_counts[program_index],
+            .mesh = mesh,
+            .vertex_attributes = std::move(vertex_attributes),
+        });
+    }
+};
 
-        VkClearValue clear_value = {{{1.0f, 1.0f, 1.0f, 1.0f}}};
-        VkRenderPassBeginInfo render_pass_begin_info = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .renderPass = render_pass.get(),
-            .framebuffer = framebuffer.get(),
-            .renderArea = {
-                .offset = {0, 0},
-                .extent = {document.width, document.height},
-            },
-            .clearValueCount = 1,
-            .pClearValues = &clear_value,
-        };
-        vkCmdBeginRenderPass(
-            document.command_buffer, &render_pass_begin_info,
-            VK_SUBPASS_CONTENTS_INLINE
+// the same for compute actions, whose descriptor set layout is reflected
+struct compile_compute_functor {
+    const renderer &renderer;
+    const ::document &source;
+    std::optional<render_compute_action> &result;
+    std::vector<uniform_copy> &copies;
+
+    void operator() (uint32_t compute_index) {
+        auto& computes = source.computes;
+        auto shader_name = referenced_file_name(
+            source, computes.shaders[compute_index]
         );
-        vkCmdBindPipeline(
-            document.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-            pipeline.get()
+        reflected_shader_module shader(
+            renderer, *current_device, shader_name.c_str(),
+            shaderc_glsl_compute_shader
         );
-        vkCmdBindDescriptorSets(
-            document.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-            pipeline_layout.get(), 0, 1, &descriptor_set, 0, nullptr
+        auto uniform_size = shader.descriptor_size;
+        plan_uniforms(
+            source, computes.uniforms[compute_index], {&shader},
+            uniform_size, copies
         );
-        vkCmdDraw(document.command_buffer, action.vertex_count, 1, 0, 0);
-        vkCmdEndRenderPass(document.command_buffer);
 
-        document.render_program_actions.push_back(render_program_action{
-            .pipeline_layout = std::move(pipeline_layout),
-            .pipeline = std::move(pipeline),
-            .framebuffer = std::move(framebuffer),
-            .render_pass = std::move(render_pass),
-            .uniform_buffer = std::move(uniform_buffer),
-            .uniform_memory = std::move(uniform_memory),
-            .descriptor_pool = std::move(descriptor_pool),
-            .uniform_data = uniform_data,
-        });
-    }
-    void operator() (const std::unique_ptr<blit_action> &) {
+        // storage images and buffers are found by name in the ins and outs
+        auto& bindings = source.bindings;
+        auto find_binding = [&](const std::string& name) {
+            for (auto range : {
+                computes.ins[compute_index], computes.outs[compute_index]
+            })
+                for (auto i = range.first; i < range.first + range.count; i++)
+                    if (source.strings[bindings.names[i]] == name)
+                        return i;
+            return -1u;
+        };
+        auto error = [&](const std::string& message) {
+            return std::runtime_error(
+                message + " in " + std::string(shader_name)
+            );
+        };
+        std::vector<descriptor_binding> compute_bindings;
+        std::vector<VkDescriptorSetLayoutBinding> layout_bindings;
+        for (const auto& reflected : shader.bindings) {
+            if (reflected.set != 0)
+                throw error("Descriptor " + reflected.name + " not in set 0");
+            descriptor_binding binding = {
+                reflected.binding,
+                static_cast<VkDescriptorType>(reflected.type),
+                no_texture, no_buffer,
+            };
+            if (binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+                binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            } else if (
+                binding.type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+                binding.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+            ) {
+                auto index = find_binding(reflected.name);
+                if (index == -1u)
+                    throw error("Nothing bound to " + reflected.name);
+                binding.texture = bindings.textures[index];
+                binding.buffer = bindings.buffers[index];
+                auto image = binding.type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                if (
+                    image ? binding.texture == no_texture :
+                    binding.buffer == no_buffer
+                )
+                    throw error(
+                        std::string(image ? "Texture" : "Buffer") +
+                        " expected for " + reflected.name
+                    );
+            } else {
+                throw error("Unsupported descriptor " + reflected.name);
+            }
+            compute_bindings.push_back(binding);
+            layout_bindings.push_back({
+                .binding = binding.binding,
+                .descriptorType = binding.type,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+        }
+
+        render_compute_action action = {};
+        VkDescriptorSetLayoutCreateInfo descriptor_set_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = static_cast<uint32_t>(layout_bindings.size()),
+            .pBindings = layout_bindings.data(),
+        };
+        check(vkCreateDescriptorSetLayout(
+            *current_device, &descriptor_set_info, nullptr,
+            out_ptr(action.descriptor_set_layout)
+        ));
+        VkDescriptorSetLayout layouts[] = {
+            action.descriptor_set_layout.get()
+        };
+        VkPipelineLayoutCreateInfo pipeline_layout_info = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = layouts,
+        };
+        check(vkCreatePipelineLayout(
+            *current_device, &pipeline_layout_info, nullptr,
+            out_ptr(action.pipeline_layout)
+        ));
 
+        VkComputePipelineCreateInfo pipeline_info = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader.module.get(),
+                .pName = "main",
+            },
+            .layout = action.pipeline_layout.get(),
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = -1,
+        };
+        action.pipeline = create_compute_pipeline(renderer, pipeline_info);
+        action.bindings = std::move(compute_bindings);
+        std::copy(
+            shader.local_size, shader.local_size + 3, action.group_size
+        );
+        action.uniform_size = uniform_size;
+        result.emplace(std::move(action));
     }
 };
 
+// compiles the compute actions in parallel, results and copies are indexed
+// like computes
+static void compile_computes(
+    const renderer& renderer, const document& document,
+    const std::vector<uint32_t>& computes,
+    std::vector<std::optional<render_compute_action>>& results,
+    std::vector<std::vector<uniform_copy>>& copies
+) {
+    results.resize(computes.size());
+    copies.resize(computes.size());
+    parallel_for(computes.size(), [&](size_t i) {
+        compile_compute_functor{
+            renderer, document, results[i], copies[i]
+        }(computes[i]);
+    });
+}
+
 render_document::render_document(
-    unsigned width, unsigned height,
     const document &document, const renderer &renderer,
-    VkImage output, VkFormat output_format, VkImageLayout output_layout,
-    VkCommandPool graphics_command_pool
-
+    VkFormat output_format, VkImageLayout output_layout
 ) :
-    width(width), height(height),
-    render_program_actions(document.view_actions.size())
+    graph(
+        document, output_layout,
+        renderer.compute_queue_family != renderer.graphics_queue_family
+    ),
+    output_format(output_format), output_layout(output_layout)
 {
+    // without building the graph, which is timed with the actions
+    INSTRUMENT_SCOPE("render_document");
+    // the offset into the uniform ring is passed when binding
+    VkDescriptorSetLayoutBinding descriptor_set_layout_binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS,
+    };
+    VkDescriptorSetLayoutCreateInfo descriptor_set_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &descriptor_set_layout_binding,
+    };
+    check(vkCreateDescriptorSetLayout(
+        *current_device, &descriptor_set_info,
+        nullptr, out_ptr(descriptor_set_layout)
+    ));
 
-    VkFenceCreateInfo fence_info = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    VkDescriptorSetLayout layouts[] = { descriptor_set_layout.get() };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = layouts,
     };
-    vkCreateFence(
-        *current_device, &fence_info, nullptr, out_ptr(fence)
+    check(vkCreatePipelineLayout(
+        *current_device, &pipeline_layout_info, nullptr,
+        out_ptr(pipeline_layout)
+    ));
+
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .anisotropyEnable = VK_FALSE,
+        .compareEnable = VK_FALSE,
+        .maxLod = 0.0f,
+        .unnormalizedCoordinates = VK_FALSE,
+    };
+    check(vkCreateSampler(
+        *current_device, &sampler_info, nullptr, out_ptr(sampler)
+    ));
+
+    render_passes = create_render_passes(graph, output_format);
+
+    // shaders and pipelines are compiled in parallel, one job per action,
+    // program actions are stored in document order
+    std::vector<std::optional<render_program_action>> compiled_actions(
+        document.programs.size()
     );
-    VkSemaphoreCreateInfo semaphore_info = {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    std::vector<std::vector<uniform_copy>> action_copies(
+        document.programs.size()
+    );
+    parallel_for(document.programs.size(), [&](size_t i) {
+        compile_action_functor{
+            renderer, *this, graph, render_passes, document,
+            compiled_actions[i], action_copies[i]
+        }(static_cast<uint32_t>(i));
+    });
+
+    render_program_actions.reserve(compiled_actions.size());
+    for (auto& action : compiled_actions)
+        render_program_actions.push_back(std::move(*action));
+
+    std::vector<uint32_t> computes(document.computes.size());
+    for (uint32_t i = 0; i < computes.size(); i++)
+        computes[i] = i;
+    std::vector<std::optional<render_compute_action>> compiled_computes;
+    std::vector<std::vector<uniform_copy>> compute_copies;
+    compile_computes(
+        renderer, document, computes, compiled_computes, compute_copies
+    );
+    render_compute_actions.reserve(compiled_computes.size());
+    for (auto& action : compiled_computes)
+        render_compute_actions.push_back(std::move(*action));
+    for (auto& copies : compute_copies)
+        action_copies.push_back(std::move(copies));
+    place_uniforms(document, renderer, action_copies);
+}
+
+bool render_document::rebuild(
+    const document& document, const renderer& renderer,
+    const std::vector<uint32_t>& changed,
+    const std::vector<uint32_t>& changed_computes
+) {
+    // merging may have changed the subpasses of kept programs
+    render_graph new_graph(
+        document, output_layout,
+        renderer.compute_queue_family != renderer.graphics_queue_family
+    );
+    auto programs = changed;
+    auto kept_count = std::min(
+        document.programs.size(), render_program_actions.size()
+    );
+    for (auto i = 0u; i < kept_count; i++)
+        if (!compatible_passes(graph, new_graph, i))
+            programs.push_back(i);
+    std::sort(programs.begin(), programs.end());
+    programs.erase(
+        std::unique(programs.begin(), programs.end()), programs.end()
+    );
+
+    // compiled on the side, so that errors leave the current pipelines
+    auto new_render_passes = create_render_passes(new_graph, output_format);
+    std::vector<std::optional<render_program_action>> compiled_actions(
+        programs.size()
+    );
+    std::vector<std::vector<uniform_copy>> compiled_copies(programs.size());
+    parallel_for(programs.size(), [&](size_t i) {
+        compile_action_functor{
+            renderer, *this, new_graph, new_render_passes, document,
+            compiled_actions[i], compiled_copies[i]
+        }(programs[i]);
+    });
+    std::vector<std::optional<render_compute_action>> compiled_computes;
+    std::vector<std::vector<uniform_copy>> compiled_compute_copies;
+    compile_computes(
+        renderer, document, changed_computes, compiled_computes,
+        compiled_compute_copies
+    );
+    graph = std::move(new_graph);
+    render_passes = std::move(new_render_passes);
+
+    // kept actions get their plans back relative to their slot
+    auto action_count = document.programs.size();
+    auto compute_count = document.computes.size();
+    std::vector<std::vector<uniform_copy>> action_copies(
+        action_count + compute_count
+    );
+    auto restore_copies = [&](const auto& action, size_t index) {
+        auto copies = action.uniform_copies;
+        for (auto j = copies.first; j < copies.first + copies.count; j++) {
+            auto copy = uniform_copies[j];
+            copy.source -= action.uniform_source;
+            copy.destination -= static_cast<uint32_t>(action.uniform_offset);
+            action_copies[index].push_back(copy);
+        }
     };
-    vkCreateSemaphore(
-        *current_device, &semaphore_info, nullptr,
-        out_ptr(render_finished_semaphore)
+    for (size_t i = 0; i < kept_count; i++)
+        restore_copies(render_program_actions[i], i);
+    auto kept_compute_count = std::min(
+        compute_count, render_compute_actions.size()
     );
+    for (size_t i = 0; i < kept_compute_count; i++)
+        restore_copies(render_compute_actions[i], action_count + i);
 
-    for (size_t i = 0; i < document.textures.size(); i++) {
-        // TODO: create images and image views
+    render_program_actions.resize(action_count);
+    for (size_t i = 0; i < programs.size(); i++) {
+        render_program_actions[programs[i]] = std::move(*compiled_actions[i]);
+        action_copies[programs[i]] = std::move(compiled_copies[i]);
     }
 
-    VkCommandBufferAllocateInfo command_buffer_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = graphics_command_pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
+    // draw parameters are only recorded, the pipeline doesn't depend on them
+    for (size_t i = 0; i < action_count; i++)
+        render_program_actions[i].vertex_count =
+            document.programs.vertex_counts[i];
+    render_compute_actions.resize(compute_count);
+    for (size_t i = 0; i < changed_computes.size(); i++) {
+        auto index = changed_computes[i];
+        render_compute_actions[index] = std::move(*compiled_computes[i]);
+        action_copies[action_count + index] =
+            std::move(compiled_compute_copies[i]);
+    }
+
+    auto previous_stride = uniform_stride;
+    auto previous_frame_size = uniform_frame_size;
+    place_uniforms(document, renderer, action_copies);
+    return
+        uniform_stride != previous_stride ||
+        uniform_frame_size != previous_frame_size;
+}
+
+void render_document::place_uniforms(
+    const document& document, const renderer& renderer,
+    std::vector<std::vector<uniform_copy>>& action_copies
+) {
+    // every action gets a slot of the same size, so that the descriptor
+    // range fits all of them
+    VkDeviceSize uniform_range = 16;
+    for (const auto& action : render_program_actions)
+        uniform_range = std::max<VkDeviceSize>(
+            uniform_range, action.uniform_size
+        );
+    for (const auto& action : render_compute_actions)
+        uniform_range = std::max<VkDeviceSize>(
+            uniform_range, action.uniform_size
+        );
+    auto alignment = std::max<VkDeviceSize>(
+        renderer.physical_device_properties.limits
+            .minUniformBufferOffsetAlignment, 1
+    );
+    uniform_stride = (uniform_range + alignment - 1) / alignment * alignment;
+    auto program_count = render_program_actions.size();
+    uniform_frame_size = uniform_stride * std::max<size_t>(
+        program_count + render_compute_actions.size(), 1
+    );
+    uniform_copies.clear();
+    shader_users.clear();
+    compute_shader_users.clear();
+    auto place = [&](auto& action, range uniforms, size_t slot) {
+        action.uniform_offset = slot * uniform_stride;
+        action.uniform_source = uniforms.count == 0 ?
+            0 : document.uniforms.offsets[uniforms.first] * 4;
+        action.uniform_copies = {
+            static_cast<uint32_t>(uniform_copies.size()),
+            static_cast<uint32_t>(action_copies[slot].size())
+        };
+        for (auto copy : action_copies[slot]) {
+            copy.source += action.uniform_source;
+            copy.destination += static_cast<uint32_t>(action.uniform_offset);
+            uniform_copies.push_back(copy);
+        }
+    };
+    auto& programs = document.programs;
+    for (size_t i = 0; i < program_count; i++) {
+        place(render_program_actions[i], programs.uniforms[i], i);
+        for (
+            auto shader :
+            {programs.vertex_shaders[i], programs.fragment_shaders[i]}
+        )
+            shader_users[referenced_file_name(document, shader)]
+                .push_back(static_cast<uint32_t>(i));
+    }
+    auto& computes = document.computes;
+    for (size_t i = 0; i < render_compute_actions.size(); i++) {
+        place(
+            render_compute_actions[i], computes.uniforms[i], program_count + i
+        );
+        compute_shader_users[
+            referenced_file_name(document, computes.shaders[i])
+        ].push_back(static_cast<uint32_t>(i));
+    }
+}
+
+uniform_ring::uniform_ring(
+    const render_document& document, const uniform_table& values,
+    const renderer& renderer, unsigned frame_count
+) : frame_size(document.uniform_frame_size) {
+    uint32_t queue_families[] = {
+        renderer.graphics_queue_family, renderer.compute_queue_family,
+    };
+    auto shared = queue_families[0] != queue_families[1];
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = frame_size * frame_count,
+        .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        .sharingMode = shared ?
+            VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = shared ? 2u : 1u,
+        .pQueueFamilyIndices = queue_families,
+    };
+    check(vkCreateBuffer(
+        *current_device, &buffer_info, nullptr, out_ptr(buffer)
+    ));
+    memory = allocate_buffer_memory(
+        *renderer.allocator, buffer.get(),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+    // uniforms the document doesn't set are zero
+    memset(memory.get().mapped, 0, frame_size * frame_count);
+    for (auto frame = 0u; frame < frame_count; frame++)
+        upload(document, values, frame);
+
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        .descriptorCount = 1,
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
     };
-    check(vkAllocateCommandBuffers(
-        *current_device, &command_buffer_info, &command_buffer
+    check(vkCreateDescriptorPool(
+        *current_device, &pool_info, nullptr, out_ptr(descriptor_pool)
     ));
 
-    VkCommandBufferBeginInfo begin_info = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptor_pool.get(),
+        .descriptorSetCount = 1,
+        .pSetLayouts = &document.descriptor_set_layout.get(),
     };
-    check(vkBeginCommandBuffer(command_buffer, &begin_info));
+    check(vkAllocateDescriptorSets(
+        *current_device, &descriptor_set_allocate_info, &descriptor_set
+    ));
+
+    VkDescriptorBufferInfo descriptor_buffer_info = {
+        .buffer = buffer.get(),
+        .offset = 0,
+        .range = document.uniform_stride,
+    };
+    VkWriteDescriptorSet write_descriptor_set = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = descriptor_set,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        .pBufferInfo = &descriptor_buffer_info,
+    };
+    vkUpdateDescriptorSets(
+        *current_device, 1, &write_descriptor_set, 0, nullptr
+    );
+}
+
+void uniform_ring::upload(
+    const render_document& document, const uniform_table& values,
+    unsigned frame
+) {
+    auto destination =
+        static_cast<uint8_t*>(memory.get().mapped) + frame * frame_size;
+    auto source = reinterpret_cast<const uint8_t*>(values.values.data());
+    for (const auto& copy : document.uniform_copies)
+        memcpy(
+            destination + copy.destination, source + copy.source, copy.size
+        );
+}
+
+// copies whole textures, scaling with a blit where they differ
+static void record_blit(
+    VkCommandBuffer command_buffer, const render_graph& graph,
+    uint32_t blit, const render_targets& targets, unsigned parity
+) {
+    if (graph.blit_swaps[blit])
+        return;
+    auto& blits = graph.blits;
+    auto source = image_texture(graph, blits.source_textures[blit], parity);
+    auto destination =
+        image_texture(graph, blits.destination_textures[blit], parity);
+    auto& from = targets.textures[source];
+    auto& to = targets.textures[destination];
+
+    VkImageSubresourceLayers layers = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .mipLevel = 0,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+    };
+    if (
+        graph.textures[source].format == graph.textures[destination].format &&
+        from.width == to.width && from.height == to.height
+    ) {
+        VkImageCopy region = {
+            .srcSubresource = layers,
+            .srcOffset = {0, 0, 0},
+            .dstSubresource = layers,
+            .dstOffset = {0, 0, 0},
+            .extent = {from.width, from.height, 1},
+        };
+        vkCmdCopyImage(
+            command_buffer, from.image.get(),
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, to.image.get(),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region
+        );
+        return;
+    }
+    VkImageBlit region = {
+        .srcSubresource = layers,
+        .srcOffsets = {
+            {0, 0, 0},
+            {
+                static_cast<int32_t>(from.width),
+                static_cast<int32_t>(from.height), 1
+            },
+        },
+        .dstSubresource = layers,
+        .dstOffsets = {
+            {0, 0, 0},
+            {
+                static_cast<int32_t>(to.width),
+                static_cast<int32_t>(to.height), 1
+            },
+        },
+    };
+    vkCmdBlitImage(
+        command_buffer, from.image.get(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        to.image.get(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+        VK_FILTER_LINEAR
+    );
+}
+
+render_image::render_image(
+    const render_document& document, const render_targets& targets,
+    const render_meshes& meshes, const uniform_ring& uniforms,
+    unsigned frame, VkImage output, VkFormat output_format,
+    unsigned width, unsigned height, const renderer& renderer
+) : width(width), height(height) {
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    vkCreateSemaphore(
+        *current_device, &semaphore_info, nullptr,
+        out_ptr(render_finished_semaphore)
+    );
+    auto& graph = document.graph;
+    auto async = std::find(
+        graph.async_actions.begin(), graph.async_actions.end(), true
+    ) != graph.async_actions.end();
+    window_before_join = graph.window_before_join;
+    if (async) {
+        check(vkCreateSemaphore(
+            *current_device, &semaphore_info, nullptr,
+            out_ptr(compute_finished_semaphore)
+        ));
+        check(vkCreateSemaphore(
+            *current_device, &semaphore_info, nullptr,
+            out_ptr(graphics_finished_semaphore)
+        ));
+    }
 
     VkImageViewCreateInfo image_view_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -431,19 +1088,615 @@ render_document::render_document(
         }
     };
     vkCreateImageView(
-        *current_device, &image_view_info, nullptr,
-        out_ptr(this->output_view)
+        *current_device, &image_view_info, nullptr, out_ptr(output_view)
     );
 
-    for (size_t i = 0; i < document.view_actions.size(); i++) {
-        // TODO: multi-thread shader compilation
-        // TODO: multi-thread pipeline compilation
+    // own pools, so that the command buffers are freed with the image
+    VkCommandPoolCreateInfo command_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = renderer.graphics_queue_family,
+    };
+    check(vkCreateCommandPool(
+        *current_device, &command_pool_info, nullptr, out_ptr(command_pool)
+    ));
 
-        std::visit(
-            compile_action_functor{renderer, *this, output_layout},
-            document.view_actions[i]
+    // swapped textures change images every other frame
+    auto& swaps = graph.blit_swaps;
+    uint32_t parities =
+        std::find(swaps.begin(), swaps.end(), true) != swaps.end() ? 2 : 1;
+    auto allocate = [&](VkCommandPool pool, VkCommandBuffer* buffers) {
+        VkCommandBufferAllocateInfo command_buffer_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = parities,
+        };
+        check(vkAllocateCommandBuffers(
+            *current_device, &command_buffer_info, buffers
+        ));
+        if (parities == 1)
+            buffers[1] = buffers[0];
+    };
+    allocate(command_pool.get(), command_buffers);
+    if (async) {
+        allocate(command_pool.get(), join_command_buffers);
+        command_pool_info.queueFamilyIndex = renderer.compute_queue_family;
+        check(vkCreateCommandPool(
+            *current_device, &command_pool_info, nullptr,
+            out_ptr(compute_command_pool)
+        ));
+        allocate(compute_command_pool.get(), compute_command_buffers);
+    }
+
+    // one set per compute action, or program sampling textures, and
+    // parity, swapped textures are bound like they are used as attachments
+    auto& computes = document.render_compute_actions;
+    auto& programs = document.render_program_actions;
+    auto compute_count = static_cast<uint32_t>(computes.size());
+    auto program_count = static_cast<uint32_t>(programs.size());
+    std::vector<const std::vector<descriptor_binding>*> set_bindings;
+    std::vector<VkDescriptorSetLayout> layouts;
+    for (auto parity = 0u; parity < parities; parity++) {
+        for (const auto& action : computes) {
+            set_bindings.push_back(&action.bindings);
+            layouts.push_back(action.descriptor_set_layout.get());
+        }
+        for (const auto& action : programs) {
+            if (action.descriptor_set_layout.get() == VK_NULL_HANDLE)
+                continue;
+            set_bindings.push_back(&action.bindings);
+            layouts.push_back(action.descriptor_set_layout.get());
+        }
+    }
+    program_descriptor_sets.assign(
+        parities * program_count, VK_NULL_HANDLE
+    );
+    if (!layouts.empty()) {
+        VkDescriptorPoolSize pool_sizes[] = {
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0},
+            {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 0},
+            {VK_DESCRIPTOR_TYPE_SAMPLER, 0},
+        };
+        size_t descriptor_count = 0;
+        for (auto bindings : set_bindings) {
+            descriptor_count += bindings->size();
+            for (const auto& binding : *bindings)
+                for (auto& size : pool_sizes)
+                    if (size.type == binding.type)
+                        size.descriptorCount++;
+        }
+        std::vector<VkDescriptorPoolSize> used_sizes;
+        for (auto size : pool_sizes)
+            if (size.descriptorCount > 0)
+                used_sizes.push_back(size);
+        VkDescriptorPoolCreateInfo pool_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = static_cast<uint32_t>(layouts.size()),
+            .poolSizeCount = static_cast<uint32_t>(used_sizes.size()),
+            .pPoolSizes = used_sizes.data(),
+        };
+        check(vkCreateDescriptorPool(
+            *current_device, &pool_info, nullptr, out_ptr(descriptor_pool)
+        ));
+
+        VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = descriptor_pool.get(),
+            .descriptorSetCount = static_cast<uint32_t>(layouts.size()),
+            .pSetLayouts = layouts.data(),
+        };
+        std::vector<VkDescriptorSet> sets(layouts.size());
+        check(vkAllocateDescriptorSets(
+            *current_device, &descriptor_set_allocate_info, sets.data()
+        ));
+
+        // infos are reserved, so that the writes can point into them
+        std::vector<VkDescriptorImageInfo> image_infos;
+        std::vector<VkDescriptorBufferInfo> buffer_infos;
+        std::vector<VkWriteDescriptorSet> writes;
+        image_infos.reserve(descriptor_count);
+        buffer_infos.reserve(descriptor_count);
+        auto sets_per_parity = sets.size() / parities;
+        for (size_t i = 0; i < sets.size(); i++) {
+            auto parity = static_cast<unsigned>(i / sets_per_parity);
+            for (const auto& binding : *set_bindings[i]) {
+                VkWriteDescriptorSet write = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet = sets[i],
+                    .dstBinding = binding.binding,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = binding.type,
+                };
+                auto image_view = [&]() {
+                    auto texture =
+                        image_texture(graph, binding.texture, parity);
+                    return targets.textures[texture].view.get();
+                };
+                switch (binding.type) {
+                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                    image_infos.push_back({
+                        .sampler = VK_NULL_HANDLE,
+                        .imageView = image_view(),
+                        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+                    });
+                    write.pImageInfo = &image_infos.back();
+                    break;
+                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                    image_infos.push_back({
+                        .sampler =
+                            binding.type ==
+                            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ?
+                            document.sampler.get() : VK_NULL_HANDLE,
+                        .imageView = image_view(),
+                        .imageLayout =
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    });
+                    write.pImageInfo = &image_infos.back();
+                    break;
+                case VK_DESCRIPTOR_TYPE_SAMPLER:
+                    image_infos.push_back({
+                        .sampler = document.sampler.get(),
+                        .imageView = VK_NULL_HANDLE,
+                        .imageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                    });
+                    write.pImageInfo = &image_infos.back();
+                    break;
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+                    buffer_infos.push_back({
+                        .buffer = targets.buffers[binding.buffer].get(),
+                        .offset = 0,
+                        .range = VK_WHOLE_SIZE,
+                    });
+                    write.pBufferInfo = &buffer_infos.back();
+                    break;
+                default:
+                    buffer_infos.push_back({
+                        .buffer = uniforms.buffer.get(),
+                        .offset = 0,
+                        .range = document.uniform_stride,
+                    });
+                    write.pBufferInfo = &buffer_infos.back();
+                }
+                writes.push_back(write);
+            }
+        }
+        vkUpdateDescriptorSets(
+            *current_device, static_cast<uint32_t>(writes.size()),
+            writes.data(), 0, nullptr
+        );
+
+        // computes come first in the sets of each parity
+        descriptor_sets.clear();
+        for (auto parity = 0u; parity < parities; parity++) {
+            auto set = sets.begin() + parity * sets_per_parity;
+            descriptor_sets.insert(
+                descriptor_sets.end(), set, set + compute_count
+            );
+            set += compute_count;
+            for (auto i = 0u; i < program_count; i++)
+                if (programs[i].descriptor_set_layout.get() != VK_NULL_HANDLE)
+                    program_descriptor_sets[parity * program_count + i] =
+                        *set++;
+        }
+    }
+
+    compute_timestamps = renderer.compute_timestamp_bits != 0;
+    if (renderer.graphics_timestamp_bits != 0 && !graph.actions.empty()) {
+        timestamp_count = static_cast<uint32_t>(graph.actions.size() * 2);
+        VkQueryPoolCreateInfo query_pool_info = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = timestamp_count,
+        };
+        check(vkCreateQueryPool(
+            *current_device, &query_pool_info, nullptr, out_ptr(query_pool)
+        ));
+    }
+
+    framebuffers.reserve(parities * graph.passes.size());
+    for (unsigned parity = 0; parity < parities; parity++) {
+        record(
+            command_buffers[parity], document, targets, meshes, uniforms,
+            frame, parity, output, frame_part::before_join
+        );
+        if (!async)
+            continue;
+        record(
+            join_command_buffers[parity], document, targets, meshes,
+            uniforms, frame, parity, output, frame_part::from_join
+        );
+        record(
+            compute_command_buffers[parity], document, targets, meshes,
+            uniforms, frame, parity, output, frame_part::async
+        );
+    }
+}
+
+void render_image::submit(
+    VkQueue graphics_queue, VkQueue compute_queue, unsigned parity,
+    VkSemaphore wait_semaphore, VkPipelineStageFlags wait_stage,
+    VkSemaphore last_frame, VkSemaphore signal_semaphore, VkFence fence,
+    VkCommandBuffer extra
+) const {
+    submitted = std::chrono::steady_clock::now();
+    auto wait_count = wait_semaphore == VK_NULL_HANDLE ? 0u : 1u;
+    auto signal_count = signal_semaphore == VK_NULL_HANDLE ? 0u : 1u;
+    VkCommandBuffer graphics_buffers[] = {command_buffers[parity], extra};
+    if (compute_command_buffers[0] == VK_NULL_HANDLE) {
+        VkSubmitInfo submit_info = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = wait_count,
+            .pWaitSemaphores = &wait_semaphore,
+            .pWaitDstStageMask = &wait_stage,
+            .commandBufferCount = extra == VK_NULL_HANDLE ? 1u : 2u,
+            .pCommandBuffers = graphics_buffers,
+            .signalSemaphoreCount = signal_count,
+            .pSignalSemaphores = &signal_semaphore,
+        };
+        check(vkQueueSubmit(graphics_queue, 1, &submit_info, fence));
+        return;
+    }
+
+    // the compute queue may start while the graphics queue still renders
+    // the last frame, but not use what it uses
+    VkPipelineStageFlags compute_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    auto compute_finished = compute_finished_semaphore.get();
+    VkSubmitInfo compute_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = last_frame == VK_NULL_HANDLE ? 0u : 1u,
+        .pWaitSemaphores = &last_frame,
+        .pWaitDstStageMask = &compute_stage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &compute_command_buffers[parity],
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &compute_finished,
+    };
+    check(vkQueueSubmit(compute_queue, 1, &compute_info, VK_NULL_HANDLE));
+
+    // the window is waited for by the part using it first
+    VkSemaphore join_waits[] = {compute_finished, wait_semaphore};
+    VkPipelineStageFlags join_stages[] = {
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, wait_stage,
+    };
+    VkCommandBuffer join_buffers[] = {join_command_buffers[parity], extra};
+    VkSemaphore join_signals[] = {
+        graphics_finished_semaphore.get(), signal_semaphore,
+    };
+    VkSubmitInfo graphics_info[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = window_before_join ? wait_count : 0u,
+            .pWaitSemaphores = &wait_semaphore,
+            .pWaitDstStageMask = &wait_stage,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &command_buffers[parity],
+        }, {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = window_before_join ? 1u : 1u + wait_count,
+            .pWaitSemaphores = join_waits,
+            .pWaitDstStageMask = join_stages,
+            .commandBufferCount = extra == VK_NULL_HANDLE ? 1u : 2u,
+            .pCommandBuffers = join_buffers,
+            .signalSemaphoreCount = 1 + signal_count,
+            .pSignalSemaphores = join_signals,
+        },
+    };
+    check(vkQueueSubmit(graphics_queue, 2, graphics_info, fence));
+}
+
+std::optional<std::chrono::steady_clock::time_point>
+render_image::read_timestamps(std::vector<uint64_t>& results) const {
+    if (query_pool.get() == VK_NULL_HANDLE || !submitted)
+        return {};
+    // doesn't wait, the availability tells which were written
+    results.resize(timestamp_count * 2);
+    auto result = vkGetQueryPoolResults(
+        *current_device, query_pool.get(), 0, timestamp_count,
+        results.size() * sizeof(uint64_t), results.data(),
+        2 * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+    );
+    if (result != VK_NOT_READY)
+        check(result);
+    auto time = submitted;
+    submitted.reset();
+    return time;
+}
+
+frame_resources::frame_resources() {
+    VkFenceCreateInfo fence_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+    };
+    check(vkCreateFence(
+        *current_device, &fence_info, nullptr, out_ptr(fence)
+    ));
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    check(vkCreateSemaphore(
+        *current_device, &semaphore_info, nullptr,
+        out_ptr(image_ready_semaphore)
+    ));
+}
+
+void render_image::record_compute(
+    VkCommandBuffer command_buffer, const render_document& document,
+    uint32_t compute, const uniform_ring& uniforms, unsigned frame,
+    unsigned parity
+) {
+    auto& graph = document.graph;
+    auto& action = document.render_compute_actions[compute];
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, action.pipeline.get()
+    );
+    auto uniform_offset = static_cast<uint32_t>(
+        frame * uniforms.frame_size + action.uniform_offset
+    );
+    auto dynamic = std::any_of(
+        action.bindings.begin(), action.bindings.end(),
+        [](const descriptor_binding& binding) {
+            return binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        }
+    );
+    auto descriptor_set = descriptor_sets[
+        parity * document.render_compute_actions.size() + compute
+    ];
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        action.pipeline_layout.get(), 0, 1, &descriptor_set,
+        dynamic ? 1 : 0, &uniform_offset
+    );
+
+    // sizes are in invocations, 0 follows the window
+    auto& computes = graph.computes;
+    uint32_t size[] = {
+        computes.widths[compute], computes.heights[compute],
+        computes.depths[compute],
+    };
+    auto texture = computes.size_textures[compute];
+    if (texture != no_texture) {
+        auto& definition = graph.textures[texture];
+        size[0] = definition.width;
+        size[1] = definition.height;
+        size[2] = 1;
+    }
+    size[0] = size[0] == 0 ? width : size[0];
+    size[1] = size[1] == 0 ? height : size[1];
+    size[2] = std::max(size[2], 1u);
+    uint32_t groups[3];
+    for (auto i = 0; i < 3; i++)
+        groups[i] = (size[i] + action.group_size[i] - 1) /
+            action.group_size[i];
+    vkCmdDispatch(command_buffer, groups[0], groups[1], groups[2]);
+}
+
+void render_image::record(
+    VkCommandBuffer command_buffer, const render_document& document,
+    const render_targets& targets, const render_meshes& meshes,
+    const uniform_ring& uniforms, unsigned frame, unsigned parity,
+    VkImage output, frame_part part
+) {
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    };
+    check(vkBeginCommandBuffer(command_buffer, &begin_info));
+
+    auto& graph = document.graph;
+    std::vector<VkImageView> attachment_views;
+    std::vector<VkClearValue> clear_values;
+
+    auto async = join_command_buffers[0] != VK_NULL_HANDLE;
+    auto part_of = [&](size_t i) {
+        return
+            graph.async_actions[i] ? frame_part::async :
+            i < graph.async_join ? frame_part::before_join :
+            frame_part::from_join;
+    };
+
+    // each part resets the timestamps it writes before the first of them,
+    // the first part also resets the ones no queue writes
+    auto timed = [&](frame_part part) {
+        return
+            query_pool.get() != VK_NULL_HANDLE &&
+            (part != frame_part::async || compute_timestamps);
+    };
+    auto resets = [&](size_t i) {
+        return
+            query_pool.get() != VK_NULL_HANDLE &&
+            (part_of(i) == part ?
+                timed(part) :
+                part == frame_part::before_join && !timed(part_of(i)));
+    };
+    for (size_t i = 0; i < graph.actions.size(); i++) {
+        if (!resets(i))
+            continue;
+        auto first = i;
+        while (i + 1 < graph.actions.size() && resets(i + 1))
+            i++;
+        vkCmdResetQueryPool(
+            command_buffer, query_pool.get(),
+            static_cast<uint32_t>(first * 2),
+            static_cast<uint32_t>((i + 1 - first) * 2)
         );
     }
+    auto write_timestamp = [&](VkPipelineStageFlagBits stage, size_t query) {
+        if (timed(part))
+            vkCmdWriteTimestamp(
+                command_buffer, stage, query_pool.get(),
+                static_cast<uint32_t>(query)
+            );
+    };
+
+    for (size_t i = 0; i < graph.actions.size(); i++) {
+        if (part_of(i) != part)
+            continue;
+        // the barriers before an action count towards it, actions merged
+        // into one render pass are timed at their subpasses
+        write_timestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, i * 2);
+        record_barriers(command_buffer, graph, i, targets, parity, output);
+        if (graph.actions[i].type == action_type::blit) {
+            record_blit(
+                command_buffer, graph, graph.actions[i].index, targets, parity
+            );
+            write_timestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, i * 2 + 1);
+            continue;
+        }
+        if (graph.actions[i].type == action_type::compute) {
+            record_compute(
+                command_buffer, document, graph.actions[i].index, uniforms,
+                frame, parity
+            );
+            write_timestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, i * 2 + 1);
+            continue;
+        }
+
+        auto program_index = graph.actions[i].index;
+        auto& action = document.render_program_actions[program_index];
+        auto pass_index = graph.program_passes[program_index];
+        auto& pass = graph.passes[pass_index];
+        auto subpass = graph.program_subpasses[program_index];
+
+        if (subpass > 0) {
+            vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+        } else {
+            // textures of other sizes are rendered to where they overlap
+            auto attachments = pass.attachments;
+            attachment_views.clear();
+            VkExtent2D extent = {width, height};
+            for (
+                auto j = attachments.first;
+                j < attachments.first + attachments.count; j++
+            ) {
+                auto texture = graph.attachments[j];
+                if (texture == built_in_window) {
+                    attachment_views.push_back(output_view.get());
+                    continue;
+                }
+                auto& target =
+                    targets.textures[image_texture(graph, texture, parity)];
+                attachment_views.push_back(target.view.get());
+                extent.width = std::min(extent.width, target.width);
+                extent.height = std::min(extent.height, target.height);
+            }
+            clear_values.assign(
+                attachments.count, {{{1.0f, 1.0f, 1.0f, 1.0f}}}
+            );
+
+            VkFramebufferCreateInfo framebuffer_info = {
+                .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+                .renderPass = document.render_passes[pass_index].get(),
+                .attachmentCount = attachments.count,
+                .pAttachments = attachment_views.data(),
+                .width = extent.width,
+                .height = extent.height,
+                .layers = 1,
+            };
+            unique_framebuffer framebuffer;
+            check(vkCreateFramebuffer(
+                *current_device, &framebuffer_info, nullptr,
+                out_ptr(framebuffer)
+            ));
+
+            VkViewport viewport = {
+                .x = 0.0f,
+                .y = 0.0f,
+                .width = static_cast<float>(extent.width),
+                .height = static_cast<float>(extent.height),
+                .minDepth = 0.0f,
+                .maxDepth = 1.0f,
+            };
+            VkRect2D scissors = {
+                .offset = {0, 0},
+                .extent = extent,
+            };
+            vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+            vkCmdSetScissor(command_buffer, 0, 1, &scissors);
+
+            VkRenderPassBeginInfo render_pass_begin_info = {
+                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                .renderPass = document.render_passes[pass_index].get(),
+                .framebuffer = framebuffer.get(),
+                .renderArea = scissors,
+                .clearValueCount = attachments.count,
+                .pClearValues = clear_values.data(),
+            };
+            vkCmdBeginRenderPass(
+                command_buffer, &render_pass_begin_info,
+                VK_SUBPASS_CONTENTS_INLINE
+            );
+            framebuffers.push_back(std::move(framebuffer));
+        }
+
+        vkCmdBindPipeline(
+            command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            action.pipeline.get()
+        );
+        // dynamic offsets are fixed at record time, edited values only
+        // change the contents of the ring
+        auto uniform_offset = static_cast<uint32_t>(
+            frame * uniforms.frame_size + action.uniform_offset
+        );
+        if (action.descriptor_set_layout.get() == VK_NULL_HANDLE) {
+            vkCmdBindDescriptorSets(
+                command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                document.pipeline_layout.get(), 0, 1,
+                &uniforms.descriptor_set, 1, &uniform_offset
+            );
+        } else {
+            auto dynamic = std::any_of(
+                action.bindings.begin(), action.bindings.end(),
+                [](const descriptor_binding& binding) {
+                    return
+                        binding.type ==
+                        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                }
+            );
+            auto descriptor_set = program_descriptor_sets[
+                parity * document.render_program_actions.size() +
+                program_index
+            ];
+            vkCmdBindDescriptorSets(
+                command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                action.pipeline_layout.get(), 0, 1, &descriptor_set,
+                dynamic ? 1 : 0, &uniform_offset
+            );
+        }
+        // the attributes of a mesh are regions of its buffer
+        auto vertex_count = action.vertex_count;
+        if (action.mesh != no_mesh) {
+            vertex_count = meshes.vertex_counts[action.mesh];
+            auto binding_count = action.vertex_attributes.size();
+            std::vector<VkBuffer> vertex_buffers(
+                binding_count, meshes.buffers[action.mesh].get()
+            );
+            std::vector<VkDeviceSize> offsets;
+            for (auto attribute : action.vertex_attributes)
+                offsets.push_back(meshes.offsets[attribute]);
+            if (vertex_count > 0)
+                vkCmdBindVertexBuffers(
+                    command_buffer, 0, static_cast<uint32_t>(binding_count),
+                    vertex_buffers.data(), offsets.data()
+                );
+        }
+        if (vertex_count > 0)
+            vkCmdDraw(command_buffer, vertex_count, 1, 0, 0);
+
+        if (subpass + 1 == pass.actions.count)
+            vkCmdEndRenderPass(command_buffer);
+        write_timestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, i * 2 + 1);
+    }
+    // the last graphics commands leave the window in the output layout
+    if (part == (async ? frame_part::from_join : frame_part::before_join))
+        record_barriers(
+            command_buffer, graph, graph.actions.size(), targets, parity,
+            output
+        );
 
     check(vkEndCommandBuffer(command_buffer));
 }
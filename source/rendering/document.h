@@ -1,49 +1,277 @@
 #pragma once
 
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "../data/document.h"
 #include "resources.h"
 #include "renderer.h"
 #include "shader.h"
+#include "memory.h"
+#include "render_graph.h"
+#include "mesh.h"
+
+// copies a run of bytes from uniform_table::values to a frame of the ring
+struct uniform_copy {
+    uint32_t source, destination, size;
+};
+
+// a reflected descriptor of an action, storage images and buffers of
+// compute actions and sampled images of programs are bound to the ins and
+// outs of the same name, samplers are render_document::sampler
+struct descriptor_binding {
+    uint32_t binding;
+    VkDescriptorType type;
+    // index in document::textures or no_texture
+    unsigned texture;
+    // index in document::buffers or no_buffer
+    unsigned buffer;
+};
 
 struct render_program_action {
-    unique_pipeline_layout pipeline_layout;
     unique_pipeline pipeline;
-    unique_framebuffer framebuffer;
-    unique_render_pass render_pass;
-    std::vector<reflected_shader_module> modules;
-    unique_buffer uniform_buffer;
-    unique_device_memory uniform_memory;
-    unique_descriptor_pool descriptor_pool;
-    void* uniform_data;
-    // framebuffer and render_pass are resolution dependent
-    // need one per action (or caching/partitioning)
-    unsigned width, height;
+    // only for programs sampling textures, whose descriptors depend on the
+    // shaders, null for the others, which use the layout of the document
+    unique_descriptor_set_layout descriptor_set_layout;
+    unique_pipeline_layout pipeline_layout;
+    std::vector<descriptor_binding> bindings;
+    // copy plan of this pipeline in render_document::uniform_copies
+    range uniform_copies;
+    uint32_t uniform_size;
+    // start of the uniforms of this action in every frame of the ring
+    VkDeviceSize uniform_offset;
+    // start of the values of this action in the uniform table, in bytes
+    uint32_t uniform_source;
+    unsigned vertex_count;
+    // mesh the vertex shader reads, all of whose triangles are drawn
+    // instead of vertex_count, or no_mesh
+    unsigned mesh;
+    // per vertex binding, the attribute of the mesh it reads
+    std::vector<uint32_t> vertex_attributes;
 };
 
-struct render_texture {
-    unique_image image;
-    unique_image_view view;
-    unsigned width, height;
+struct render_compute_action {
+    // the descriptors depend on the shader, so every action has its own
+    // layouts, the uniform block is dynamic as for programs
+    unique_descriptor_set_layout descriptor_set_layout;
+    unique_pipeline_layout pipeline_layout;
+    unique_pipeline pipeline;
+    std::vector<descriptor_binding> bindings;
+    // workgroup size of the shader, dispatches are rounded up to it
+    uint32_t group_size[3];
+    // as for programs
+    range uniform_copies;
+    uint32_t uniform_size;
+    VkDeviceSize uniform_offset;
+    uint32_t uniform_source;
 };
 
+// indices of the programs of current that need new pipelines compared to
+// previous, which includes ins binding other textures, other programs only
+// differ in uniform values, viewports or vertex counts, or in the content
+// of their mesh
+std::vector<uint32_t> changed_programs(
+    const document& previous, const document& current
+);
+// the same for compute actions, whose ins and outs are compared as well
+std::vector<uint32_t> changed_computes(
+    const document& previous, const document& current
+);
+
 struct render_document {
-    // is dependent on swapchain image and re-created on resolution changes
+    // is shared by all swapchain images and independent of the resolution
     render_document(
-        unsigned width, unsigned height,
-        const document& document, const renderer &renderer, VkImage output,
-        VkFormat output_format, VkImageLayout output_layout,
-        VkCommandPool graphics_command_pool
+        const document& document, const renderer &renderer,
+        VkFormat output_format, VkImageLayout output_layout
     );
 
-    unsigned width, height;
-    // TODO: can't put swapchain image in this vector
-    std::vector<render_texture> textures;
+    // builds new pipelines for programs and compute actions of document,
+    // which may be a new version of the document, and for programs whose
+    // render pass became incompatible, all other actions keep theirs
+    // nothing changes if a shader fails to compile
+    // returns whether the uniform slots changed size, rings have to be
+    // re-created then, render targets and command buffers have to be
+    // created again anyway
+    bool rebuild(
+        const document& document, const renderer& renderer,
+        const std::vector<uint32_t>& changed,
+        const std::vector<uint32_t>& changed_computes
+    );
+
+    render_graph graph;
+    // per pass of the graph, load and store operations depend on the rest
+    // of the document, so passes are replaced whenever it changes
+    std::vector<unique_render_pass> render_passes;
     std::vector<render_program_action> render_program_actions;
-    VkCommandBuffer command_buffer;
+    std::vector<render_compute_action> render_compute_actions;
 
-    unique_fence fence;
+    // programs that don't sample textures share one layout with a single
+    // dynamic uniform buffer
+    unique_descriptor_set_layout descriptor_set_layout;
+    unique_pipeline_layout pipeline_layout;
+    // linear and clamped to the edge, for every sampled texture
+    unique_sampler sampler;
+
+    // actions have uniform slots of uniform_stride bytes in every frame
+    VkDeviceSize uniform_stride, uniform_frame_size;
+    // copy plans of all actions, sorted by destination with adjacent runs
+    // merged, resolved from uniform names once when building
+    std::vector<uniform_copy> uniform_copies;
+
+    // programs and compute actions using each shader file, to find what a
+    // changed file affects
+    std::unordered_map<std::string, std::vector<uint32_t>> shader_users;
+    std::unordered_map<std::string, std::vector<uint32_t>>
+        compute_shader_users;
+
+    VkFormat output_format;
+    VkImageLayout output_layout;
+
+private:
+    // assigns uniform slots and places the copy plans of all actions,
+    // plans are relative to the slot and the first value of their action
+    // compute actions follow the programs in action_copies
+    void place_uniforms(
+        const document& document, const renderer& renderer,
+        std::vector<std::vector<uniform_copy>>& action_copies
+    );
+};
+
+// persistently mapped buffer holding the uniforms of all actions once per
+// frame, so that a frame can be updated while others are still rendered,
+// it is shared with the compute queue
+struct uniform_ring {
+    uniform_ring() = default;
+    uniform_ring(
+        const render_document& document, const uniform_table& values,
+        const renderer& renderer, unsigned frame_count
+    );
+
+    // runs the copy plans from the values of the document into the slice
+    // of the frame, the frame must not be in use by the device, so edits
+    // of the uniform table show up with the next upload
+    void upload(
+        const render_document& document, const uniform_table& values,
+        unsigned frame
+    );
+
+    VkDeviceSize frame_size;
+    unique_buffer buffer;
+    unique_allocation memory;
+    unique_descriptor_pool descriptor_pool;
+    VkDescriptorSet descriptor_set;
+};
+
+struct render_image {
+    // is dependent on swapchain image and re-created on resolution changes,
+    // only holds the objects that reference the output image directly
+    // the command buffer reads the uniforms of frame in uniforms, output
+    // is built_in_window, all other textures are in targets, vertices in
+    // meshes
+    render_image(
+        const render_document& document, const render_targets& targets,
+        const render_meshes& meshes, const uniform_ring& uniforms,
+        unsigned frame, VkImage output, VkFormat output_format,
+        unsigned width, unsigned height, const renderer& renderer
+    );
+
+    // submits the frame of parity, graphics wait for wait_semaphore at
+    // wait_stage, async actions for last_frame, the graphics_finished
+    // semaphore of the frame before, and extra runs after the frame,
+    // all of which are optional, signals signal_semaphore and fence, the
+    // fence of the frame in flight, which has to have signalled for the
+    // frame this image rendered before
+    void submit(
+        VkQueue graphics_queue, VkQueue compute_queue, unsigned parity,
+        VkSemaphore wait_semaphore, VkPipelineStageFlags wait_stage,
+        VkSemaphore last_frame, VkSemaphore signal_semaphore, VkFence fence,
+        VkCommandBuffer extra = VK_NULL_HANDLE
+    ) const;
+
+    // the timestamps before and after every view action in the frame
+    // submitted last, each followed by its availability, the frame must
+    // have finished, returns when it was submitted, nothing if there are
+    // no timestamps or they were read already, some may not be available
+    std::optional<std::chrono::steady_clock::time_point> read_timestamps(
+        std::vector<uint64_t>& results
+    ) const;
+
+    unsigned width, height;
+    // framebuffers are resolution dependent, one per pass and parity
+    std::vector<unique_framebuffer> framebuffers;
+    unique_command_pool command_pool;
+    // indexed by the parity of the frame, both are the same unless the
+    // graph swaps textures, with async actions these only hold the
+    // graphics actions before the join of the graph
+    VkCommandBuffer command_buffers[2];
+    // only with async actions, the graphics actions from the join on and
+    // the async actions
+    VkCommandBuffer join_command_buffers[2] = {};
+    unique_command_pool compute_command_pool;
+    VkCommandBuffer compute_command_buffers[2] = {};
+    // storage images and buffers of compute actions, per parity and action
+    unique_descriptor_pool descriptor_pool;
+    std::vector<VkDescriptorSet> descriptor_sets;
+    // sampled images of programs, per parity and program, null for the
+    // ones using the set of the uniform ring
+    std::vector<VkDescriptorSet> program_descriptor_sets;
+
+    // the swapchain image isn't in render_targets
     unique_image_view output_view;
     unique_semaphore render_finished_semaphore;
+    // only with async actions, the compute queue signals the graphics
+    // queue at the join and waits for the graphics of the last frame
+    unique_semaphore compute_finished_semaphore, graphics_finished_semaphore;
+    // see render_graph::window_before_join
+    bool window_before_join;
+
+    // two timestamps per view action, written by the queue running it,
+    // null if the graphics queue has no timestamps, one pool per image
+    // rather than per frame in flight, because the command buffers are
+    // recorded once and reset and write it, the last frame of the image
+    // has finished before it's submitted again
+    unique_query_pool query_pool;
+    uint32_t timestamp_count = 0;
+    // async actions are only timed if the compute queue has timestamps
+    bool compute_timestamps;
+    // when the last frame was submitted, until its timestamps are read
+    mutable std::optional<std::chrono::steady_clock::time_point> submitted;
+
+private:
+    // the actions a command buffer holds
+    enum struct frame_part {
+        before_join, from_join, async,
+    };
+
+    void record(
+        VkCommandBuffer command_buffer, const render_document& document,
+        const render_targets& targets, const render_meshes& meshes,
+        const uniform_ring& uniforms, unsigned frame, unsigned parity,
+        VkImage output, frame_part part
+    );
+    void record_compute(
+        VkCommandBuffer command_buffer, const render_document& document,
+        uint32_t compute, const uniform_ring& uniforms, unsigned frame,
+        unsigned parity
+    );
+};
+
+// how many frames may be submitted before waiting for the oldest, one
+// keeps the latency of edits lowest, more overlap the cpu with the device
+inline constexpr unsigned max_frames_in_flight = 3;
+
+// what a frame in flight needs besides its render_image, frames are reused
+// in turn once their fence signalled, independent of the number of images
+struct frame_resources {
+    frame_resources();
+
+    // created signalled, so that the first wait doesn't block
+    unique_fence fence;
+    // signalled when the swapchain image of the frame was acquired
+    unique_semaphore image_ready_semaphore;
 };
@@ -0,0 +1,123 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// the jobs of one call, on the stack of the calling thread
+struct job_batch {
+    std::size_t count;
+    const std::function<void(std::size_t)>& job;
+    std::atomic<std::size_t> next{0};
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+
+    void work() {
+        for (
+            auto i = next++;
+            i < count;
+            i = next++
+        ) {
+            try {
+                job(i);
+            } catch (...) {
+                std::lock_guard lock(exception_mutex);
+                if (!exception)
+                    exception = std::current_exception();
+                // skip remaining jobs
+                next = count;
+            }
+        }
+    }
+};
+
+// started once and kept for the whole session, so that thread_local state
+// of the workers, like their shader compiler, is only created once
+struct worker_pool {
+    worker_pool() {
+        auto worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+        // the calling thread takes part instead of waiting idle
+        for (auto i = 1u; i < worker_count; i++)
+            workers.emplace_back([this]() { run(); });
+    }
+
+    ~worker_pool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    void run() {
+        std::uint64_t seen = 0;
+        std::unique_lock lock(mutex);
+        while (true) {
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            // the batch may already be finished by the time a worker wakes
+            if (batch == nullptr)
+                continue;
+            auto current = batch;
+            active++;
+            lock.unlock();
+            current->work();
+            lock.lock();
+            if (--active == 0)
+                finished.notify_all();
+        }
+    }
+
+    void run(job_batch& jobs) {
+        {
+            std::lock_guard lock(mutex);
+            batch = &jobs;
+            generation++;
+        }
+        wake.notify_all();
+        jobs.work();
+        // workers still running jobs reference the batch
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [&]() { return active == 0; });
+        batch = nullptr;
+    }
+
+    // one batch at a time
+    std::atomic<bool> busy{false};
+
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    job_batch* batch = nullptr;
+    std::uint64_t generation = 0;
+    unsigned active = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+void parallel_for(
+    std::size_t count, const std::function<void(std::size_t)>& job
+) {
+    static worker_pool pool;
+    job_batch jobs{count, job};
+
+    // jobs started from jobs, or while another thread uses the pool, run on
+    // the calling thread instead of waiting for the workers
+    if (count <= 1 || pool.busy.exchange(true)) {
+        jobs.work();
+    } else {
+        pool.run(jobs);
+        pool.busy = false;
+    }
+
+    if (jobs.exception)
+        std::rethrow_exception(jobs.exception);
+}
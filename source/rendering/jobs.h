@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// runs job(i) for every i in [0, count) on worker threads started once for
+// the session and returns once all jobs finished, rethrows the first
+// exception of any job
+void parallel_for(
+    std::size_t count, const std::function<void(std::size_t)>& job
+);
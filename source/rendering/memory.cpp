@@ -0,0 +1,319 @@
+#include "memory.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "renderer.h"
+
+static const VkDeviceSize minimum_buddy_size = 256;
+
+static unsigned buddy_order(VkDeviceSize size) {
+    return std::countr_zero(
+        std::bit_ceil(std::max(size, minimum_buddy_size)) / minimum_buddy_size
+    );
+}
+
+device_allocator::device_allocator(
+    VkDevice device,
+    const VkPhysicalDeviceMemoryProperties& memory_properties,
+    VkDeviceSize block_size
+) :
+    device(device), memory_properties(memory_properties),
+    block_size(std::bit_ceil(std::max(block_size, minimum_buddy_size)))
+{}
+
+uint32_t device_allocator::find_memory_type(
+    uint32_t type_bits, VkMemoryPropertyFlags properties
+) const {
+    for (auto i = 0u; i < memory_properties.memoryTypeCount; i++) {
+        if (
+            (type_bits & (1u << i)) &&
+            (memory_properties.memoryTypes[i].propertyFlags & properties) ==
+            properties
+        )
+            return i;
+    }
+    throw std::runtime_error("No suitable memory type found");
+}
+
+memory_block& device_allocator::create_block(
+    uint32_t pool_key, uint32_t memory_type, VkDeviceSize size,
+    allocation_strategy strategy, bool dedicated
+) {
+    auto block = std::make_unique<memory_block>();
+    block->size = size;
+    block->mapped = nullptr;
+    block->pool_key = pool_key;
+    block->strategy = strategy;
+    block->dedicated = dedicated;
+    block->allocation_count = 0;
+    block->used = 0;
+    block->linear_end = 0;
+
+    VkMemoryAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = memory_type,
+    };
+    check(vkAllocateMemory(
+        device, &allocate_info, nullptr, out_ptr(block->memory)
+    ));
+
+    // host visible blocks stay mapped for their whole lifetime
+    if (
+        memory_properties.memoryTypes[memory_type].propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+    ) {
+        check(vkMapMemory(
+            device, block->memory.get(), 0, VK_WHOLE_SIZE, 0, &block->mapped
+        ));
+    }
+
+    if (strategy == allocation_strategy::buddy && !dedicated) {
+        auto maximum_order = buddy_order(size);
+        block->free_offsets.resize(maximum_order + 1);
+        block->free_offsets[maximum_order].insert(0);
+    }
+
+    auto& blocks = pools[pool_key].blocks;
+    blocks.push_back(std::move(block));
+    return *blocks.back();
+}
+
+static bool allocate_buddy(
+    memory_block& block, unsigned order, VkDeviceSize& offset
+) {
+    auto available = order;
+    while (
+        available < block.free_offsets.size() &&
+        block.free_offsets[available].empty()
+    )
+        available++;
+    if (available >= block.free_offsets.size())
+        return false;
+
+    offset = *block.free_offsets[available].begin();
+    block.free_offsets[available].erase(block.free_offsets[available].begin());
+
+    // split until the requested size is reached, upper halves become free
+    while (available > order) {
+        available--;
+        block.free_offsets[available].insert(
+            offset + (minimum_buddy_size << available)
+        );
+    }
+
+    block.allocated_orders[offset] = order;
+    block.used += minimum_buddy_size << order;
+    return true;
+}
+
+static void free_buddy(memory_block& block, VkDeviceSize offset) {
+    auto allocated = block.allocated_orders.find(offset);
+    auto order = allocated->second;
+    block.allocated_orders.erase(allocated);
+    block.used -= minimum_buddy_size << order;
+
+    // merge with free buddies
+    while (order + 1 < block.free_offsets.size()) {
+        auto buddy = offset ^ (minimum_buddy_size << order);
+        auto free_buddy = block.free_offsets[order].find(buddy);
+        if (free_buddy == block.free_offsets[order].end())
+            break;
+        block.free_offsets[order].erase(free_buddy);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    block.free_offsets[order].insert(offset);
+}
+
+device_allocation device_allocator::allocate(
+    const VkMemoryRequirements& requirements,
+    VkMemoryPropertyFlags properties, bool image,
+    allocation_strategy strategy
+) {
+    auto memory_type =
+        find_memory_type(requirements.memoryTypeBits, properties);
+    auto size = requirements.size;
+    auto alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+    std::lock_guard lock(mutex);
+    auto pool_key = memory_type * 2 + (image ? 1 : 0);
+    auto& pool = pools[pool_key];
+
+    device_allocation allocation;
+    allocation.size = size;
+
+    // large resources get their own memory
+    if (size > block_size / 2) {
+        auto& block = create_block(pool_key, memory_type, size, strategy, true);
+        block.allocation_count = 1;
+        block.used = size;
+        allocation.block = &block;
+
+    } else if (strategy == allocation_strategy::buddy) {
+        // buddies are aligned to their size
+        auto order = buddy_order(std::max(size, alignment));
+        for (auto& block : pool.blocks) {
+            if (
+                block->strategy == allocation_strategy::buddy &&
+                !block->dedicated &&
+                allocate_buddy(*block, order, allocation.offset)
+            ) {
+                allocation.block = block.get();
+                break;
+            }
+        }
+        if (allocation.block == nullptr) {
+            auto& block = create_block(
+                pool_key, memory_type, block_size, strategy, false
+            );
+            allocate_buddy(block, order, allocation.offset);
+            allocation.block = &block;
+        }
+
+    } else {
+        for (auto& block : pool.blocks) {
+            // dedicated blocks are owned by their single allocation
+            if (
+                block->dedicated ||
+                block->strategy != allocation_strategy::linear
+            )
+                continue;
+            auto offset =
+                (block->linear_end + alignment - 1) / alignment * alignment;
+            if (offset + size <= block->size) {
+                allocation.block = block.get();
+                allocation.offset = offset;
+                break;
+            }
+        }
+        if (allocation.block == nullptr) {
+            allocation.block = &create_block(
+                pool_key, memory_type, block_size, strategy, false
+            );
+            allocation.offset = 0;
+        }
+        auto& block = *allocation.block;
+        block.used += allocation.offset + size - block.linear_end;
+        block.linear_end = allocation.offset + size;
+    }
+
+    auto& block = *allocation.block;
+    if (!block.dedicated)
+        block.allocation_count++;
+    allocation.memory = block.memory.get();
+    if (block.mapped != nullptr)
+        allocation.mapped =
+            static_cast<char*>(block.mapped) + allocation.offset;
+    return allocation;
+}
+
+void device_allocator::free(const device_allocation& allocation) {
+    std::lock_guard lock(mutex);
+    auto& block = *allocation.block;
+
+    if (block.strategy == allocation_strategy::buddy && !block.dedicated)
+        free_buddy(block, allocation.offset);
+
+    block.allocation_count--;
+    if (block.allocation_count > 0)
+        return;
+
+    if (block.strategy == allocation_strategy::linear) {
+        block.linear_end = 0;
+        block.used = 0;
+    }
+
+    // keep one empty block per pool around to avoid allocation churn
+    auto& blocks = pools[block.pool_key].blocks;
+    auto empty_blocks = std::count_if(
+        blocks.begin(), blocks.end(),
+        [](const auto& block) { return block->allocation_count == 0; }
+    );
+    if (block.dedicated || empty_blocks > 1) {
+        blocks.erase(std::find_if(
+            blocks.begin(), blocks.end(),
+            [&](const auto& candidate) { return candidate.get() == &block; }
+        ));
+    }
+}
+
+allocator_statistics device_allocator::statistics() const {
+    std::lock_guard lock(mutex);
+    allocator_statistics statistics = {};
+    VkDeviceSize free_bytes = 0, largest_free = 0;
+
+    for (const auto& pool : pools) {
+        for (const auto& block : pool.second.blocks) {
+            statistics.block_count++;
+            statistics.allocation_count += block->allocation_count;
+            statistics.block_bytes += block->size;
+            statistics.used_bytes += block->used;
+
+            if (block->dedicated)
+                continue;
+            free_bytes += block->size - block->used;
+            if (block->strategy == allocation_strategy::buddy) {
+                auto& free_offsets = block->free_offsets;
+                for (auto order = 0u; order < free_offsets.size(); order++) {
+                    if (!free_offsets[order].empty())
+                        largest_free = std::max(
+                            largest_free, minimum_buddy_size << order
+                        );
+                }
+            } else {
+                largest_free =
+                    std::max(largest_free, block->size - block->linear_end);
+            }
+        }
+    }
+
+    statistics.fragmentation = free_bytes == 0 ?
+        0.0f : 1.0f - float(largest_free) / float(free_bytes);
+    return statistics;
+}
+
+void device_allocator::print_statistics(std::ostream& stream) const {
+    auto statistics = this->statistics();
+    stream <<
+        "device memory blocks: " << statistics.block_count <<
+        " (" << statistics.block_bytes << " bytes), allocations: " <<
+        statistics.allocation_count << " (" << statistics.used_bytes <<
+        " bytes), fragmentation: " << statistics.fragmentation << std::endl;
+}
+
+unique_allocation allocate_buffer_memory(
+    device_allocator& allocator, VkBuffer buffer,
+    VkMemoryPropertyFlags properties, allocation_strategy strategy
+) {
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(allocator.device, buffer, &requirements);
+    unique_allocation allocation(
+        allocator,
+        allocator.allocate(requirements, properties, false, strategy)
+    );
+    check(vkBindBufferMemory(
+        allocator.device, buffer, allocation.get().memory,
+        allocation.get().offset
+    ));
+    return allocation;
+}
+
+unique_allocation allocate_image_memory(
+    device_allocator& allocator, VkImage image,
+    VkMemoryPropertyFlags properties, allocation_strategy strategy
+) {
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(allocator.device, image, &requirements);
+    unique_allocation allocation(
+        allocator,
+        allocator.allocate(requirements, properties, true, strategy)
+    );
+    check(vkBindImageMemory(
+        allocator.device, image, allocation.get().memory,
+        allocation.get().offset
+    ));
+    return allocation;
+}
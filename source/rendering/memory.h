@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "resources.h"
+
+enum struct allocation_strategy {
+    // general purpose, power of two sizes that are merged again when freed
+    buddy,
+    // bump allocation, a block is only reused after all its allocations
+    // were freed, meant for transient data
+    linear,
+};
+
+struct memory_block;
+
+struct device_allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0, size = 0;
+    // null if the memory is not host visible, stays mapped while allocated
+    void* mapped = nullptr;
+
+    memory_block* block = nullptr;
+};
+
+struct allocator_statistics {
+    unsigned block_count, allocation_count;
+    VkDeviceSize block_bytes, used_bytes;
+    // 1 - largest free range / all free memory, over all blocks
+    float fragmentation;
+};
+
+// sub-allocates device memory from large blocks, with one pool of blocks per
+// memory type and resource kind
+struct device_allocator {
+    // block_size is rounded up to a power of two
+    device_allocator(
+        VkDevice device,
+        const VkPhysicalDeviceMemoryProperties& memory_properties,
+        VkDeviceSize block_size = 64 * 1024 * 1024
+    );
+
+    // images and buffers are kept in separate blocks, so that
+    // bufferImageGranularity doesn't need to be respected
+    device_allocation allocate(
+        const VkMemoryRequirements& requirements,
+        VkMemoryPropertyFlags properties, bool image,
+        allocation_strategy strategy = allocation_strategy::buddy
+    );
+    void free(const device_allocation& allocation);
+
+    // first memory type with all of the requested properties
+    uint32_t find_memory_type(
+        uint32_t type_bits, VkMemoryPropertyFlags properties
+    ) const;
+
+    allocator_statistics statistics() const;
+    void print_statistics(std::ostream& stream) const;
+
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDeviceSize block_size;
+
+private:
+    struct memory_pool {
+        std::vector<std::unique_ptr<memory_block>> blocks;
+    };
+
+    memory_block& create_block(
+        uint32_t pool_key, uint32_t memory_type, VkDeviceSize size,
+        allocation_strategy strategy, bool dedicated
+    );
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint32_t, memory_pool> pools;
+};
+
+struct memory_block {
+    unique_device_memory memory;
+    VkDeviceSize size;
+    void* mapped;
+    uint32_t pool_key;
+    allocation_strategy strategy;
+    bool dedicated;
+    unsigned allocation_count;
+    // including padding of buddy allocations
+    VkDeviceSize used;
+
+    // buddy: free offsets per order, order 0 being minimum_buddy_size
+    std::vector<std::set<VkDeviceSize>> free_offsets;
+    std::unordered_map<VkDeviceSize, unsigned> allocated_orders;
+
+    // linear: end of the last allocation
+    VkDeviceSize linear_end;
+};
+
+// frees the allocation on destruction
+struct unique_allocation {
+    unique_allocation() = default;
+    unique_allocation(device_allocator& allocator, device_allocation value) :
+        allocator(&allocator), value(value) {}
+    unique_allocation(const unique_allocation&) = delete;
+    unique_allocation(unique_allocation&& o) :
+        allocator(o.allocator), value(o.value)
+    {
+        o.allocator = nullptr;
+    }
+    ~unique_allocation() {
+        reset();
+    }
+    unique_allocation& operator= (const unique_allocation&) = delete;
+    unique_allocation& operator= (unique_allocation&& o) {
+        reset();
+        allocator = o.allocator;
+        value = o.value;
+        o.allocator = nullptr;
+        return *this;
+    }
+
+    const device_allocation& get() const {
+        return value;
+    }
+
+    void reset() {
+        if (allocator != nullptr)
+            allocator->free(value);
+        allocator = nullptr;
+    }
+
+private:
+    device_allocator* allocator = nullptr;
+    device_allocation value;
+};
+
+// allocates memory for the resource and binds it
+unique_allocation allocate_buffer_memory(
+    device_allocator& allocator, VkBuffer buffer,
+    VkMemoryPropertyFlags properties,
+    allocation_strategy strategy = allocation_strategy::buddy
+);
+unique_allocation allocate_image_memory(
+    device_allocator& allocator, VkImage image,
+    VkMemoryPropertyFlags properties,
+    allocation_strategy strategy = allocation_strategy::buddy
+);
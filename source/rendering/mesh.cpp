@@ -0,0 +1,147 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "../data/mesh.h"
+#include "render_graph.h"
+#include "jobs.h"
+
+VkFormat vertex_format(const renderer& renderer, format format) {
+    auto vertex = vulkan_format(format);
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(
+        renderer.physical_device, vertex, &properties
+    );
+    if (properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT)
+        return vertex;
+    // the padded format has to be supported
+    if (format == format::r8g8b8_snorm)
+        return VK_FORMAT_R8G8B8A8_SNORM;
+    throw std::runtime_error("Vertex format not supported by the device");
+}
+
+unsigned vertex_size(VkFormat format) {
+    return format == VK_FORMAT_R8G8B8_SNORM ? 3 : 4;
+}
+
+mesh_sources::mesh_sources(const document& document) :
+    meshes(document.meshes)
+{
+    for (auto name : meshes.file_names)
+        file_names.push_back(referenced_file_name(document, name));
+}
+
+bool same_meshes(const mesh_sources& previous, const mesh_sources& current) {
+    auto& a = previous.meshes;
+    auto& b = current.meshes;
+    return
+        a.attribute_sources == b.attribute_sources &&
+        a.attribute_formats == b.attribute_formats &&
+        a.attribute_meshes == b.attribute_meshes &&
+        previous.file_names == current.file_names;
+}
+
+static VkDeviceSize aligned(VkDeviceSize offset) {
+    return (offset + 3) & ~VkDeviceSize(3);
+}
+
+mesh_data load_meshes(const mesh_sources& sources, const renderer& renderer) {
+    auto& meshes = sources.meshes;
+    std::vector<obj_mesh> files(meshes.size());
+    parallel_for(meshes.size(), [&](size_t i) {
+        files[i] = load_obj(sources.file_names[i].c_str());
+    });
+
+    // the regions of the attributes start 4 byte aligned
+    mesh_data data;
+    auto attribute_count = meshes.attribute_names.size();
+    std::vector<unsigned> strides(attribute_count);
+    data.offsets.resize(attribute_count);
+    data.vertices.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        auto vertex_count = files[i].vertex_count();
+        data.vertex_counts.push_back(static_cast<uint32_t>(vertex_count));
+        auto attributes = meshes.attributes[i];
+        VkDeviceSize size = 0;
+        for (
+            auto j = attributes.first;
+            j < attributes.first + attributes.count; j++
+        ) {
+            strides[j] = vertex_size(
+                vertex_format(renderer, meshes.attribute_formats[j])
+            );
+            data.offsets[j] = size;
+            size = aligned(size + vertex_count * strides[j]);
+            auto components =
+                meshes.attribute_sources[j] ==
+                mesh_source::texture_coordinate ? 2 : 3;
+            data.unpacked_size += vertex_count * components * sizeof(float);
+        }
+        data.vertices[i].resize(size);
+    }
+
+    parallel_for(attribute_count, [&](size_t i) {
+        auto mesh = meshes.attribute_meshes[i];
+        pack_attribute(
+            files[mesh], meshes.attribute_sources[i],
+            meshes.attribute_formats[i],
+            data.vertices[mesh].data() + data.offsets[i], strides[i]
+        );
+    });
+    return data;
+}
+
+render_meshes::render_meshes(
+    mesh_data data, const renderer& renderer, upload_queue& uploads
+) :
+    vertex_counts(std::move(data.vertex_counts)),
+    offsets(std::move(data.offsets)), unpacked_size(data.unpacked_size)
+{
+    auto mesh_count = data.vertices.size();
+    buffers.resize(mesh_count);
+    memory.resize(mesh_count);
+    // the transfer queue writes them
+    uint32_t queue_families[] = {
+        renderer.graphics_queue_family, renderer.transfer_queue_family,
+    };
+    auto shared = queue_families[0] != queue_families[1];
+    for (size_t i = 0; i < mesh_count; i++) {
+        auto& vertices = data.vertices[i];
+        if (vertices.empty())
+            continue;
+        VkBufferCreateInfo buffer_info = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = vertices.size(),
+            .usage =
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = shared ?
+                VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = shared ? 2u : 1u,
+            .pQueueFamilyIndices = queue_families,
+        };
+        check(vkCreateBuffer(
+            *current_device, &buffer_info, nullptr, out_ptr(buffers[i])
+        ));
+        memory[i] = allocate_buffer_memory(
+            *renderer.allocator, buffers[i].get(),
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+        size += vertices.size();
+        upload_ticket = uploads.enqueue(
+            buffers[i].get(), 0, std::move(vertices)
+        );
+    }
+}
+
+void render_meshes::print_statistics(std::ostream& stream) const {
+    size_t vertex_count = 0;
+    for (auto count : vertex_counts)
+        vertex_count += count;
+    stream <<
+        "meshes: " << vertex_counts.size() << ", vertices: " <<
+        vertex_count << ", vertex memory: " << size / 1024 << " KiB (" <<
+        unpacked_size / 1024 << " KiB as floats)" << std::endl;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../data/document.h"
+#include "resources.h"
+#include "renderer.h"
+#include "memory.h"
+#include "upload.h"
+
+// format of a mesh attribute in its vertex buffer, R8G8B8_SNORM is padded
+// to R8G8B8A8_SNORM where the device can't read it
+VkFormat vertex_format(const renderer& renderer, format format);
+
+// bytes per vertex of an attribute in its vertex format
+unsigned vertex_size(VkFormat format);
+
+// what the meshes of a document are loaded from, doesn't refer to the
+// document, so it can be read on another thread while it's replaced
+struct mesh_sources {
+    mesh_sources() = default;
+    explicit mesh_sources(const document& document);
+
+    mesh_table meshes;
+    // per mesh, see referenced_file_name
+    std::vector<std::string> file_names;
+};
+
+// the vertex buffers loaded from previous hold the meshes of current as
+// well, as long as the files weren't changed
+bool same_meshes(const mesh_sources& previous, const mesh_sources& current);
+
+// vertices of the meshes of a document in host memory, quantized to the
+// formats of their attributes, which follow each other per mesh
+struct mesh_data {
+    // per mesh
+    std::vector<std::vector<std::byte>> vertices;
+    std::vector<uint32_t> vertex_counts;
+    // per attribute of the document, into the vertices of its mesh
+    std::vector<VkDeviceSize> offsets;
+    // what the attributes would take as floats
+    VkDeviceSize unpacked_size = 0;
+};
+
+// parses and quantizes the files in parallel, doesn't use the device, so
+// it can run next to the frame loop
+mesh_data load_meshes(const mesh_sources& sources, const renderer& renderer);
+
+// vertex buffers of the meshes of a document, one per mesh, holding the
+// attributes of the mesh one after the other
+struct render_meshes {
+    render_meshes() = default;
+    // creates the buffers and queues the copies of the vertices, the
+    // meshes can be drawn once upload_ticket finished
+    render_meshes(
+        mesh_data data, const renderer& renderer, upload_queue& uploads
+    );
+
+    void print_statistics(std::ostream& stream) const;
+
+    // per mesh, empty meshes have no buffer
+    std::vector<unique_buffer> buffers;
+    std::vector<unique_allocation> memory;
+    std::vector<uint32_t> vertex_counts;
+    // per attribute of the document, into the buffer of its mesh
+    std::vector<VkDeviceSize> offsets;
+    // of all buffers and what the attributes would take as floats
+    VkDeviceSize size = 0, unpacked_size = 0;
+    uint64_t upload_ticket = 0;
+};
@@ -0,0 +1,148 @@
+#include "offscreen.h"
+
+#include <stdexcept>
+
+offscreen_target::offscreen_target(
+    const renderer& renderer, VkFormat format, unsigned width, unsigned height
+) : format(format), width(width), height(height) {
+    // the readback buffer and write_ppm assume 4 bytes in RGBA order
+    if (format != VK_FORMAT_R8G8B8A8_UNORM)
+        throw std::runtime_error(
+            "Offscreen targets only support VK_FORMAT_R8G8B8A8_UNORM"
+        );
+    uint32_t queue_family_index = renderer.graphics_queue_family;
+
+    VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {width, height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage =
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queue_family_index,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    check(vkCreateImage(
+        *current_device, &image_info, nullptr, out_ptr(image)
+    ));
+    image_memory = allocate_image_memory(
+        *renderer.allocator, image.get(),
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = VkDeviceSize(width) * height * 4,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &queue_family_index,
+    };
+    check(vkCreateBuffer(
+        *current_device, &buffer_info, nullptr, out_ptr(readback_buffer)
+    ));
+    readback_memory = allocate_buffer_memory(
+        *renderer.allocator, readback_buffer.get(),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+
+    VkCommandPoolCreateInfo command_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = queue_family_index,
+    };
+    check(vkCreateCommandPool(
+        *current_device, &command_pool_info, nullptr, out_ptr(command_pool)
+    ));
+
+    VkCommandBufferAllocateInfo command_buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool.get(),
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    check(vkAllocateCommandBuffers(
+        *current_device, &command_buffer_info, &readback_command_buffer
+    ));
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    };
+    check(vkBeginCommandBuffer(readback_command_buffer, &begin_info));
+
+    // the render graph already transitioned the image, only wait for it
+    VkImageMemoryBarrier image_barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image.get(),
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+    };
+    vkCmdPipelineBarrier(
+        readback_command_buffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &image_barrier
+    );
+
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {width, height, 1},
+    };
+    vkCmdCopyImageToBuffer(
+        readback_command_buffer, image.get(),
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback_buffer.get(),
+        1, &region
+    );
+
+    VkBufferMemoryBarrier buffer_barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = readback_buffer.get(),
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(
+        readback_command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+        0, nullptr, 1, &buffer_barrier, 0, nullptr
+    );
+
+    check(vkEndCommandBuffer(readback_command_buffer));
+}
+
+void offscreen_target::write_ppm(std::ostream& stream) const {
+    stream << "P6\n" << width << " " << height << "\n255\n";
+    auto pixels = static_cast<const uint8_t*>(readback_memory.get().mapped);
+    for (size_t i = 0; i < size_t(width) * height; i++)
+        stream.write(reinterpret_cast<const char*>(pixels + i * 4), 3);
+}
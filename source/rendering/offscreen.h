@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#include <vulkan/vulkan.h>
+
+#include "resources.h"
+#include "renderer.h"
+#include "memory.h"
+
+// render target without a surface, for headless rendering, the image is
+// expected in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL after rendering, throws
+// std::runtime_error for formats other than VK_FORMAT_R8G8B8A8_UNORM
+struct offscreen_target {
+    offscreen_target(
+        const renderer& renderer, VkFormat format,
+        unsigned width, unsigned height
+    );
+
+    // writes the last read back image as binary PPM
+    void write_ppm(std::ostream& stream) const;
+
+    VkFormat format;
+    unsigned width, height;
+
+    unique_image image;
+    unique_allocation image_memory;
+
+    // copy of the image, valid once readback_command_buffer completed
+    unique_buffer readback_buffer;
+    unique_allocation readback_memory;
+
+    // copies image to readback_buffer, submitted after rendering
+    unique_command_pool command_pool;
+    VkCommandBuffer readback_command_buffer;
+};
@@ -0,0 +1,158 @@
+#include "pacing.h"
+
+#include <algorithm>
+#include <thread>
+
+VkPresentModeKHR choose_present_mode(
+    present_preference preference,
+    const std::vector<VkPresentModeKHR>& supported
+) {
+    std::vector<VkPresentModeKHR> order;
+    switch (preference) {
+    case present_preference::latency:
+        order = {
+            VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR,
+            VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+        };
+        break;
+    case present_preference::throughput:
+        order = {
+            VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+            VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+        };
+        break;
+    case present_preference::vsync:
+        order = {VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+        break;
+    }
+    for (auto mode : order) {
+        auto found = std::find(supported.begin(), supported.end(), mode);
+        if (found != supported.end())
+            return mode;
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+const char* present_mode_name(VkPresentModeKHR mode) {
+    switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "fifo relaxed";
+    default:
+        return "other";
+    }
+}
+
+frame_pacer::frame_pacer(
+    std::chrono::steady_clock::duration refresh_interval, unsigned window
+) : refresh_interval(refresh_interval), window(std::max(window, 1u)) {}
+
+void frame_pacer::set_refresh_interval(
+    std::chrono::steady_clock::duration refresh_interval
+) {
+    this->refresh_interval = refresh_interval;
+}
+
+void frame_pacer::wait() {
+    if (!deadline)
+        return;
+    // a high percentile, so that single slow frames don't move all others
+    std::chrono::nanoseconds predicted(0);
+    if (!work.empty()) {
+        auto sorted = work;
+        auto percentile = sorted.begin() + sorted.size() * 9 / 10;
+        std::nth_element(sorted.begin(), percentile, sorted.end());
+        predicted = std::chrono::nanoseconds(*percentile);
+    }
+    auto start = *deadline - predicted - margin;
+    auto now = std::chrono::steady_clock::now();
+    if (start <= now)
+        return;
+    // sleeping may wake up late by a scheduler tick, the rest is spun
+    auto spin = std::chrono::milliseconds(1);
+    if (start - now > spin)
+        std::this_thread::sleep_until(start - spin);
+    while (std::chrono::steady_clock::now() < start)
+        std::this_thread::yield();
+}
+
+void frame_pacer::input_sampled() {
+    input_time = std::chrono::steady_clock::now();
+}
+
+void frame_pacer::blocked(
+    std::chrono::steady_clock::time_point begin,
+    std::chrono::steady_clock::time_point end
+) {
+    // the frame can be shown at the refresh after the one that ended it
+    if (end - begin > refresh_interval / 4)
+        deadline = end + refresh_interval;
+}
+
+void frame_pacer::presented() {
+    auto now = std::chrono::steady_clock::now();
+    // frames that miss their deadline are shown at the next refresh after
+    if (!deadline) {
+        deadline = now;
+    } else if (now > *deadline) {
+        missed_deadlines++;
+        auto late = (now - *deadline) / refresh_interval + 1;
+        *deadline += late * refresh_interval;
+    }
+    if (input_time) {
+        auto nanoseconds = [](std::chrono::steady_clock::duration duration) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                duration
+            ).count();
+        };
+        auto present = nanoseconds(now - *input_time);
+        input_to_present.add(present);
+        input_to_display.add(nanoseconds(*deadline - *input_time));
+        if (work.size() < window)
+            work.push_back(present);
+        else
+            work[next_work] = present;
+        next_work = (next_work + 1) % window;
+        input_time.reset();
+    }
+    *deadline += refresh_interval;
+    frames++;
+}
+
+frame_pacing_statistics frame_pacer::statistics() const {
+    auto milliseconds = [](uint64_t nanoseconds) {
+        return static_cast<double>(nanoseconds) / 1e6;
+    };
+    return {
+        .frames = frames,
+        .missed_deadlines = missed_deadlines,
+        .refresh_interval = std::chrono::duration<double, std::milli>(
+            refresh_interval
+        ).count(),
+        .input_to_present_p50 = milliseconds(input_to_present.percentile(0.5)),
+        .input_to_present_p99 =
+            milliseconds(input_to_present.percentile(0.99)),
+        .input_to_display_p50 = milliseconds(input_to_display.percentile(0.5)),
+        .input_to_display_p99 =
+            milliseconds(input_to_display.percentile(0.99)),
+    };
+}
+
+void frame_pacer::print_statistics(std::ostream& stream) const {
+    auto statistics = this->statistics();
+    stream <<
+        "paced " << statistics.frames << " frames at " <<
+        statistics.refresh_interval << " ms, " <<
+        statistics.missed_deadlines << " missed their deadline" << std::endl <<
+        "  input to present, p50 / p99 ms: " <<
+        statistics.input_to_present_p50 << " / " <<
+        statistics.input_to_present_p99 << std::endl <<
+        "  input to display, p50 / p99 ms: " <<
+        statistics.input_to_display_p50 << " / " <<
+        statistics.input_to_display_p99 << std::endl;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../data/instrumentation.h"
+
+// what the present mode is chosen for, latency prefers MAILBOX, then
+// IMMEDIATE, throughput the other way around, both fall back to
+// FIFO_RELAXED, vsync prefers FIFO_RELAXED, all end up with FIFO, which
+// every device supports
+enum struct present_preference : uint8_t {
+    latency, throughput, vsync,
+};
+
+VkPresentModeKHR choose_present_mode(
+    present_preference preference,
+    const std::vector<VkPresentModeKHR>& supported
+);
+const char* present_mode_name(VkPresentModeKHR mode);
+
+// in milliseconds, input to present is measured until vkQueuePresentKHR
+// returned, input to display is estimated until the refresh the frame was
+// presented for
+struct frame_pacing_statistics {
+    uint64_t frames, missed_deadlines;
+    double refresh_interval;
+    double input_to_present_p50, input_to_present_p99;
+    double input_to_display_p50, input_to_display_p99;
+};
+
+// delays sampling input and recording a frame until just before the
+// deadline of the next refresh, so that the frame shows the latest input
+// deadlines are a grid of refresh intervals, aligned to refreshes whenever
+// the frame loop is seen blocking on the display, and the start of a frame
+// leaves room for a high percentile of the last window frames
+struct frame_pacer {
+    explicit frame_pacer(
+        std::chrono::steady_clock::duration refresh_interval,
+        unsigned window = 120
+    );
+
+    // when the window moved to another monitor
+    void set_refresh_interval(
+        std::chrono::steady_clock::duration refresh_interval
+    );
+
+    // sleeps until the frame has to start to make the next deadline
+    void wait();
+    // input of the frame is sampled, at its start
+    void input_sampled();
+    // the frame loop waited for the display from begin to end, a long
+    // wait ends at a refresh
+    void blocked(
+        std::chrono::steady_clock::time_point begin,
+        std::chrono::steady_clock::time_point end
+    );
+    // the frame was handed to the presentation engine
+    void presented();
+
+    frame_pacing_statistics statistics() const;
+    void print_statistics(std::ostream& stream) const;
+
+    // added to the predicted work of a frame, covers sleeping late
+    std::chrono::steady_clock::duration margin = std::chrono::microseconds(
+        500
+    );
+
+private:
+    std::chrono::steady_clock::duration refresh_interval;
+    // of the next frame, none until the first was presented
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    std::optional<std::chrono::steady_clock::time_point> input_time;
+    // from input to present in nanoseconds, a ring of the last window
+    // frames
+    std::vector<int64_t> work;
+    size_t next_work = 0;
+    unsigned window;
+    uint64_t frames = 0, missed_deadlines = 0;
+    latency_histogram input_to_present, input_to_display;
+};
@@ -0,0 +1,184 @@
+#include "pipeline_cache.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "renderer.h"
+
+double pipeline_cache_statistics::saved_milliseconds() const {
+    if (misses == 0)
+        return 0.0;
+    double average_miss = double(miss_nanoseconds) / misses;
+    return (average_miss * hits - double(hit_nanoseconds)) * 1e-6;
+}
+
+void pipeline_cache_statistics::print(std::ostream& stream) const {
+    stream <<
+        "pipeline cache hits: " << hits << " (" << hit_nanoseconds * 1e-6 <<
+        " ms), misses: " << misses << " (" << miss_nanoseconds * 1e-6 <<
+        " ms), unknown: " << unknown << " (" << unknown_nanoseconds * 1e-6 <<
+        " ms), estimated saved: " << saved_milliseconds() << " ms" <<
+        std::endl;
+}
+
+unique_pipeline_cache load_pipeline_cache(
+    VkDevice device, const VkPhysicalDeviceProperties& properties,
+    const char* file_name
+) {
+    std::vector<char> data;
+    {
+        std::ifstream file(file_name, std::ios::binary);
+        if (file.is_open()) {
+            data.assign(
+                std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>()
+            );
+        }
+    }
+
+    // the driver should reject foreign data itself, but not all do
+    VkPipelineCacheHeaderVersionOne header;
+    bool valid = data.size() >= sizeof(header);
+    if (valid) {
+        memcpy(&header, data.data(), sizeof(header));
+        valid =
+            header.headerSize >= sizeof(header) &&
+            header.headerSize <= data.size() &&
+            header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            header.vendorID == properties.vendorID &&
+            header.deviceID == properties.deviceID &&
+            memcmp(
+                header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                VK_UUID_SIZE
+            ) == 0;
+    }
+    if (!valid)
+        data.clear();
+
+    VkPipelineCacheCreateInfo cache_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data.size(),
+        .pInitialData = data.data(),
+    };
+    unique_pipeline_cache cache;
+    check(vkCreatePipelineCache(
+        device, &cache_info, nullptr, out_ptr(cache)
+    ));
+    return cache;
+}
+
+void save_pipeline_cache(
+    VkDevice device, VkPipelineCache cache, const char* file_name
+) {
+    size_t size;
+    check(vkGetPipelineCacheData(device, cache, &size, nullptr));
+    std::vector<char> data(size);
+    check(vkGetPipelineCacheData(device, cache, &size, data.data()));
+
+    std::filesystem::path path(file_name);
+    auto temporary_path = path;
+    temporary_path += ".tmp";
+
+    std::error_code error;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), error);
+    bool written;
+    {
+        std::ofstream file(temporary_path, std::ios::binary);
+        written = static_cast<bool>(file.write(data.data(), size));
+    }
+    if (written)
+        std::filesystem::rename(temporary_path, path, error);
+    if (!written || error) {
+        std::cerr <<
+            "saving the pipeline cache to " << path.string() << " failed" <<
+            (error ? ": " + error.message() : "") << std::endl;
+        std::filesystem::remove(temporary_path, error);
+    }
+}
+
+// counts the creation as cache hit or miss where the driver reports it
+static void count_creation(
+    const renderer& renderer, const VkPipelineCreationFeedbackEXT& feedback,
+    uint64_t duration
+) {
+    auto& statistics = renderer.pipeline_statistics;
+    if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) {
+        if (
+            feedback.flags &
+            VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT
+        ) {
+            statistics.hits++;
+            statistics.hit_nanoseconds += duration;
+        } else {
+            statistics.misses++;
+            statistics.miss_nanoseconds += duration;
+        }
+    } else {
+        statistics.unknown++;
+        statistics.unknown_nanoseconds += duration;
+    }
+}
+
+unique_pipeline create_graphics_pipeline(
+    const renderer& renderer, VkGraphicsPipelineCreateInfo pipeline_info
+) {
+    VkPipelineCreationFeedbackEXT pipeline_feedback = {};
+    auto stage_feedbacks = std::make_unique<VkPipelineCreationFeedbackEXT[]>(
+        pipeline_info.stageCount
+    );
+    VkPipelineCreationFeedbackCreateInfoEXT feedback_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+        .pNext = pipeline_info.pNext,
+        .pPipelineCreationFeedback = &pipeline_feedback,
+        .pipelineStageCreationFeedbackCount = pipeline_info.stageCount,
+        .pPipelineStageCreationFeedbacks = stage_feedbacks.get(),
+    };
+    if (renderer.pipeline_creation_feedback)
+        pipeline_info.pNext = &feedback_info;
+
+    auto start = std::chrono::steady_clock::now();
+    unique_pipeline pipeline;
+    check(vkCreateGraphicsPipelines(
+        *current_device, renderer.pipeline_cache.get(), 1, &pipeline_info,
+        nullptr, out_ptr(pipeline)
+    ));
+    uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+    count_creation(renderer, pipeline_feedback, duration);
+    return pipeline;
+}
+
+unique_pipeline create_compute_pipeline(
+    const renderer& renderer, VkComputePipelineCreateInfo pipeline_info
+) {
+    VkPipelineCreationFeedbackEXT pipeline_feedback = {}, stage_feedback = {};
+    VkPipelineCreationFeedbackCreateInfoEXT feedback_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT,
+        .pNext = pipeline_info.pNext,
+        .pPipelineCreationFeedback = &pipeline_feedback,
+        .pipelineStageCreationFeedbackCount = 1,
+        .pPipelineStageCreationFeedbacks = &stage_feedback,
+    };
+    if (renderer.pipeline_creation_feedback)
+        pipeline_info.pNext = &feedback_info;
+
+    auto start = std::chrono::steady_clock::now();
+    unique_pipeline pipeline;
+    check(vkCreateComputePipelines(
+        *current_device, renderer.pipeline_cache.get(), 1, &pipeline_info,
+        nullptr, out_ptr(pipeline)
+    ));
+    uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+    count_creation(renderer, pipeline_feedback, duration);
+    return pipeline;
+}
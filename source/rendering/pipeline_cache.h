@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#include <vulkan/vulkan.h>
+
+#include "resources.h"
+
+struct renderer;
+
+// pipeline creations are counted as hits or misses if the driver reports
+// creation feedback, otherwise as unknown
+struct pipeline_cache_statistics {
+    std::atomic<unsigned> hits{0}, misses{0}, unknown{0};
+    std::atomic<uint64_t>
+        hit_nanoseconds{0}, miss_nanoseconds{0}, unknown_nanoseconds{0};
+
+    // estimated from the average time of a miss
+    double saved_milliseconds() const;
+    void print(std::ostream& stream) const;
+};
+
+// returns an empty cache if the file is missing or was written by a
+// different device or driver
+unique_pipeline_cache load_pipeline_cache(
+    VkDevice device, const VkPhysicalDeviceProperties& properties,
+    const char* file_name
+);
+
+// replaces the file only once the data is written, failures are reported
+// on stderr
+void save_pipeline_cache(
+    VkDevice device, VkPipelineCache cache, const char* file_name
+);
+
+// creates the pipeline through renderer.pipeline_cache and records timing
+unique_pipeline create_graphics_pipeline(
+    const renderer& renderer, VkGraphicsPipelineCreateInfo pipeline_info
+);
+
+unique_pipeline create_compute_pipeline(
+    const renderer& renderer, VkComputePipelineCreateInfo pipeline_info
+);
@@ -0,0 +1,143 @@
+#include "profiler.h"
+
+#include <algorithm>
+
+static uint64_t timestamp_mask(uint32_t valid_bits) {
+    return valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+}
+
+gpu_profiler::gpu_profiler(
+    const document& document, const render_graph& graph,
+    const renderer& renderer, unsigned window
+) :
+    timestamp_period(
+        renderer.physical_device_properties.limits.timestampPeriod
+    ),
+    graphics_timestamp_mask(timestamp_mask(renderer.graphics_timestamp_bits)),
+    compute_timestamp_mask(timestamp_mask(renderer.compute_timestamp_bits)),
+    window(std::max(window, 1u))
+{
+    set_actions(document, graph);
+}
+
+void gpu_profiler::set_actions(
+    const document& document, const render_graph& graph
+) {
+    std::vector<std::string> names;
+    for (auto action : document.view_actions) {
+        auto name = [&](string_id id) {
+            return std::string(document.strings[id]);
+        };
+        switch (action.type) {
+        case action_type::program:
+            names.push_back(
+                "program " + name(document.programs.fragment_shaders[
+                    action.index
+                ])
+            );
+            break;
+        case action_type::blit:
+            names.push_back(
+                "blit " + name(document.blits.source_names[action.index]) +
+                " to " + name(document.blits.destination_names[action.index])
+            );
+            break;
+        case action_type::compute:
+            names.push_back(
+                "compute " + name(document.computes.shaders[action.index])
+            );
+            break;
+        }
+    }
+    compute_queue_actions = graph.async_actions;
+    compute_queue_actions.resize(names.size(), false);
+    if (names == action_names)
+        return;
+    action_names = std::move(names);
+    samples.assign(action_names.size() * window, 0.0f);
+    sample_counts.assign(action_names.size(), 0);
+    next_samples.assign(action_names.size(), 0);
+}
+
+void gpu_profiler::add_frame(
+    const std::vector<uint64_t>& results,
+    std::chrono::steady_clock::time_point submitted, trace* trace
+) {
+    // a value and its availability per timestamp, two per action
+    auto action_count = action_names.size();
+    if (results.size() != action_count * 4)
+        return;
+    auto mask = [&](size_t i) {
+        return compute_queue_actions[i] ?
+            compute_timestamp_mask : graphics_timestamp_mask;
+    };
+    auto nanoseconds = [&](int64_t ticks) {
+        return std::chrono::nanoseconds(static_cast<int64_t>(
+            static_cast<double>(ticks) * timestamp_period
+        ));
+    };
+    // the earliest action of the first frame is placed at its submit
+    auto timed = [&](size_t i) {
+        return results[i * 4 + 1] != 0 && results[i * 4 + 3] != 0;
+    };
+    if (!calibrated && trace != nullptr) {
+        for (size_t i = 0; i < action_count; i++) {
+            if (!timed(i))
+                continue;
+            auto tick = results[i * 4] & mask(i);
+            calibration_tick = calibrated ?
+                std::min(calibration_tick, tick) : tick;
+            calibration_time = submitted;
+            calibrated = true;
+        }
+    }
+    for (size_t i = 0; i < action_count; i++) {
+        if (!timed(i))
+            continue;
+        auto timestamps = &results[i * 4];
+        auto begin = timestamps[0] & mask(i), end = timestamps[2] & mask(i);
+        // the counter may wrap around within the action
+        auto duration = nanoseconds(
+            static_cast<int64_t>((end - begin) & mask(i))
+        );
+        samples[i * window + next_samples[i]] =
+            std::chrono::duration<float, std::milli>(duration).count();
+        next_samples[i] = (next_samples[i] + 1) % window;
+        sample_counts[i] = std::min(sample_counts[i] + 1, window);
+
+        if (trace == nullptr)
+            continue;
+        // ticks of the compute queue, or after the counter wrapped around,
+        // may be below the calibration tick
+        auto start = calibration_time + nanoseconds(
+            static_cast<int64_t>(begin) -
+            static_cast<int64_t>(calibration_tick)
+        );
+        trace->add(action_names[i], gpu_track, start, start + duration);
+    }
+}
+
+timing_statistics gpu_profiler::statistics(size_t action) const {
+    auto count = sample_counts[action];
+    if (count == 0)
+        return {0.0, 0.0, 0.0};
+    auto first = samples.begin() + action * window;
+    auto [minimum, maximum] = std::minmax_element(first, first + count);
+    double sum = 0.0;
+    for (auto sample = first; sample != first + count; sample++)
+        sum += *sample;
+    return {*minimum, sum / count, *maximum};
+}
+
+void gpu_profiler::print_statistics(std::ostream& stream) const {
+    stream << "gpu time per action, min / avg / max ms:" << std::endl;
+    for (size_t i = 0; i < action_names.size(); i++) {
+        if (sample_counts[i] == 0)
+            continue;
+        auto statistics = this->statistics(i);
+        stream <<
+            "  " << action_names[i] << ": " << statistics.minimum <<
+            " / " << statistics.average << " / " << statistics.maximum <<
+            std::endl;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../data/document.h"
+#include "../data/instrumentation.h"
+#include "renderer.h"
+#include "render_graph.h"
+
+// minimum, average and maximum in milliseconds
+struct timing_statistics {
+    double minimum, average, maximum;
+};
+
+// gpu time of every view action of a document, from the timestamps a
+// render_image writes around them, statistics are over the last window
+// frames the action was timed in
+struct gpu_profiler {
+    gpu_profiler(
+        const document& document, const render_graph& graph,
+        const renderer& renderer, unsigned window = 120
+    );
+
+    // the statistics are kept as long as the actions have the same names,
+    // graph tells which actions run on the compute queue
+    void set_actions(const document& document, const render_graph& graph);
+
+    // adds the results of render_image::read_timestamps, the spans go to
+    // trace unless it's null, placed relative to submitted, when the
+    // frame was submitted
+    void add_frame(
+        const std::vector<uint64_t>& results,
+        std::chrono::steady_clock::time_point submitted, trace* trace
+    );
+
+    // all 0 if the action wasn't timed yet
+    timing_statistics statistics(size_t action) const;
+    void print_statistics(std::ostream& stream) const;
+
+    // per view action, the name of the program's fragment shader, the
+    // compute shader or the textures of the blit
+    std::vector<std::string> action_names;
+
+private:
+    // nanoseconds per tick
+    double timestamp_period;
+    // valid bits of the queue families, per view action whether it runs
+    // on the compute queue
+    uint64_t graphics_timestamp_mask, compute_timestamp_mask;
+    std::vector<bool> compute_queue_actions;
+    unsigned window;
+    // window samples per action in milliseconds, a ring starting at
+    // next_samples[action] once sample_counts[action] reached window
+    std::vector<float> samples;
+    std::vector<unsigned> sample_counts, next_samples;
+    // gpu ticks are placed on the cpu clock relative to the first frame,
+    // steady_clock and the device clock are assumed not to drift
+    bool calibrated = false;
+    std::chrono::steady_clock::time_point calibration_time;
+    uint64_t calibration_tick;
+};
@@ -0,0 +1,1275 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+VkFormat vulkan_format(format format) {
+    switch (format) {
+    case format::a2b10g10r10_unorm_pack32:
+        return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+    case format::a2b10g10r10_snorm_pack32:
+        return VK_FORMAT_A2B10G10R10_SNORM_PACK32;
+    case format::r8g8b8a8_unorm:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    case format::b8g8r8a8_srgb:
+        return VK_FORMAT_B8G8R8A8_SRGB;
+    case format::r8g8b8_snorm:
+        return VK_FORMAT_R8G8B8_SNORM;
+    }
+    throw std::runtime_error("Unknown texture format");
+}
+
+struct texture_use {
+    unsigned texture;
+    texture_state state;
+    bool write;
+};
+
+struct buffer_use {
+    unsigned buffer;
+    buffer_state state;
+    bool write;
+};
+
+static const VkAccessFlags write_accesses =
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+    VK_ACCESS_SHADER_WRITE_BIT;
+
+// covers every earlier user of the memory of a transient texture, be it the
+// same texture in the previous frame or another one aliasing it
+static const texture_state transient_state = {
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+    VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT |
+    VK_ACCESS_SHADER_WRITE_BIT,
+};
+
+// the image acquire semaphore is waited on at this stage
+static const texture_state window_state = {
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+};
+
+static const VkImageSubresourceRange color_subresources = {
+    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .baseMipLevel = 0,
+    .levelCount = 1,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+};
+
+// textures an action reads and writes, in binding order
+static void action_textures(
+    const document& document, action action,
+    std::vector<unsigned>& reads, std::vector<unsigned>& writes
+) {
+    reads.clear();
+    writes.clear();
+    if (action.type == action_type::blit) {
+        reads.push_back(document.blits.source_textures[action.index]);
+        writes.push_back(document.blits.destination_textures[action.index]);
+    } else if (action.type == action_type::compute) {
+        auto& textures = document.bindings.textures;
+        auto ins = document.computes.ins[action.index];
+        for (auto i = ins.first; i < ins.first + ins.count; i++)
+            if (textures[i] != no_texture)
+                reads.push_back(textures[i]);
+        auto outs = document.computes.outs[action.index];
+        for (auto i = outs.first; i < outs.first + outs.count; i++)
+            if (textures[i] != no_texture)
+                writes.push_back(textures[i]);
+    } else {
+        auto& textures = document.bindings.textures;
+        auto ins = document.programs.ins[action.index];
+        for (auto i = ins.first; i < ins.first + ins.count; i++)
+            if (textures[i] != no_texture)
+                reads.push_back(textures[i]);
+        auto outs = document.programs.outs[action.index];
+        for (auto i = outs.first; i < outs.first + outs.count; i++)
+            writes.push_back(textures[i]);
+    }
+
+    for (auto texture : reads)
+        if (std::find(writes.begin(), writes.end(), texture) != writes.end())
+            throw std::runtime_error(
+                "A texture is read and written by the same action"
+            );
+}
+
+// storage buffers of a compute action, a buffer that is read and written
+// is only among the writes
+static void action_buffers(
+    const document& document, action action,
+    std::vector<unsigned>& reads, std::vector<unsigned>& writes
+) {
+    reads.clear();
+    writes.clear();
+    if (action.type != action_type::compute)
+        return;
+    auto& buffers = document.bindings.buffers;
+    auto outs = document.computes.outs[action.index];
+    for (auto i = outs.first; i < outs.first + outs.count; i++)
+        if (buffers[i] != no_buffer)
+            writes.push_back(buffers[i]);
+    auto ins = document.computes.ins[action.index];
+    for (auto i = ins.first; i < ins.first + ins.count; i++)
+        if (
+            buffers[i] != no_buffer &&
+            std::find(writes.begin(), writes.end(), buffers[i]) ==
+            writes.end()
+        )
+            reads.push_back(buffers[i]);
+}
+
+// index of texture in the attachments of pass or -1u
+static uint32_t pass_attachment(
+    const render_graph& graph, const graph_pass& pass, unsigned texture
+) {
+    auto first = graph.attachments.begin() + pass.attachments.first;
+    auto last = first + pass.attachments.count;
+    auto attachment = std::find(first, last, texture);
+    return attachment == last ? -1u : static_cast<uint32_t>(attachment - first);
+}
+
+static const texture_state sampled_state = {
+    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    VK_ACCESS_SHADER_READ_BIT,
+};
+
+static const texture_state attachment_state = {
+    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+};
+
+static const texture_state blit_source_state = {
+    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_ACCESS_TRANSFER_READ_BIT,
+};
+
+static const texture_state blit_destination_state = {
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_ACCESS_TRANSFER_WRITE_BIT,
+};
+
+static const texture_state storage_read_state = {
+    VK_IMAGE_LAYOUT_GENERAL,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_ACCESS_SHADER_READ_BIT,
+};
+
+static const texture_state storage_write_state = {
+    VK_IMAGE_LAYOUT_GENERAL,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+};
+
+static const buffer_state buffer_read_state = {
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+};
+
+static const buffer_state buffer_write_state = {
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+};
+
+// the compute queue waits for the graphics queue of the last frame, so
+// what graphics stages did before needs no barrier there, and couldn't be
+// named in one
+static void on_compute_queue(
+    VkPipelineStageFlags& stages, VkAccessFlags& accesses
+) {
+    if ((stages & ~VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) == 0)
+        return;
+    stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    accesses &= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+}
+
+// one use per texture, uses of the same texture are merged
+static void add_use(
+    std::vector<texture_use>& uses, unsigned texture, texture_state state,
+    bool write
+) {
+    auto use = std::find_if(
+        uses.begin(), uses.end(),
+        [&](const texture_use& use) { return use.texture == texture; }
+    );
+    if (use == uses.end()) {
+        uses.push_back({texture, state, write});
+    } else if (use->state.layout != state.layout) {
+        throw std::runtime_error(
+            "A texture is used in two layouts by the same pass"
+        );
+    } else {
+        use->state.stages |= state.stages;
+        use->state.accesses |= state.accesses;
+        use->write = use->write || write;
+    }
+}
+
+static void add_buffer_use(
+    std::vector<buffer_use>& uses, unsigned buffer, buffer_state state,
+    bool write
+) {
+    auto use = std::find_if(
+        uses.begin(), uses.end(),
+        [&](const buffer_use& use) { return use.buffer == buffer; }
+    );
+    if (use == uses.end()) {
+        uses.push_back({buffer, state, write});
+    } else {
+        use->state.stages |= state.stages;
+        use->state.accesses |= state.accesses;
+        use->write = use->write || write;
+    }
+}
+
+// uses of all actions of the pass
+static void pass_uses(
+    const document& document, const render_graph& graph,
+    const graph_pass& pass, std::vector<texture_use>& uses
+) {
+    auto add = [&](unsigned texture, texture_state state, bool write) {
+        add_use(uses, texture, state, write);
+    };
+
+    std::vector<unsigned> reads, writes;
+    for (
+        auto i = pass.actions.first;
+        i < pass.actions.first + pass.actions.count; i++
+    ) {
+        action_textures(document, graph.actions[i], reads, writes);
+        for (auto texture : reads)
+            add(texture, sampled_state, false);
+        for (auto texture : writes)
+            add(texture, attachment_state, true);
+    }
+}
+
+render_graph::render_graph(
+    const document& document, VkImageLayout output_layout,
+    bool async_compute
+) : textures(document.textures.definitions), actions(document.view_actions),
+    blits(document.blits), computes(document.computes),
+    buffer_sizes(document.buffers.sizes) {
+    auto texture_count = textures.size();
+    auto buffer_count = buffer_sizes.size();
+    auto window = texture_count;
+    auto slot = [&](unsigned texture) {
+        return texture == built_in_window ? window : texture;
+    };
+    auto last_action = static_cast<uint32_t>(
+        std::max<size_t>(actions.size(), 1) - 1
+    );
+
+    first_uses.assign(texture_count, -1u);
+    last_uses.assign(texture_count, 0);
+    persistent.assign(texture_count, false);
+    pass_local.assign(texture_count, false);
+    storage.assign(texture_count, false);
+    swap_partners.assign(texture_count, no_texture);
+    blit_swaps.assign(document.blits.size(), false);
+    std::vector<unsigned> reads, writes;
+    for (uint32_t i = 0; i < actions.size(); i++) {
+        action_textures(document, actions[i], reads, writes);
+        // storage images may be read before they're written, so their
+        // content is kept
+        auto compute = actions[i].type == action_type::compute;
+        auto use = [&](unsigned texture, bool write) {
+            if (texture == built_in_window)
+                return;
+            if (first_uses[texture] == -1u) {
+                first_uses[texture] = i;
+                persistent[texture] = !write || compute;
+            }
+            last_uses[texture] = i;
+            storage[texture] = storage[texture] || compute;
+        };
+        for (auto texture : reads)
+            use(texture, false);
+        for (auto texture : writes)
+            use(texture, true);
+    }
+    // ping-pong, the source is rewritten every frame and nothing uses
+    // either texture after the blit
+    for (uint32_t i = 0; i < actions.size(); i++) {
+        if (actions[i].type != action_type::blit)
+            continue;
+        auto blit = actions[i].index;
+        auto source = document.blits.source_textures[blit];
+        auto destination = document.blits.destination_textures[blit];
+        auto& a = textures[source];
+        auto& b = textures[destination];
+        if (
+            source == destination || persistent[source] ||
+            !persistent[destination] ||
+            last_uses[source] != i || last_uses[destination] != i ||
+            swap_partners[source] != no_texture ||
+            swap_partners[destination] != no_texture ||
+            a.width != b.width || a.height != b.height ||
+            a.depth != b.depth || a.format != b.format
+        )
+            continue;
+        swap_partners[source] = destination;
+        swap_partners[destination] = source;
+        blit_swaps[blit] = true;
+    }
+
+    // an async action can't use what an earlier graphics action used, the
+    // compute queue would have to wait for it within the frame
+    async_actions.assign(actions.size(), false);
+    std::vector<bool> graphics_textures(texture_count, false);
+    std::vector<bool> graphics_buffers(buffer_count, false);
+    std::vector<unsigned> buffer_reads, buffer_writes;
+    for (uint32_t i = 0; i < actions.size(); i++) {
+        action_textures(document, actions[i], reads, writes);
+        action_buffers(document, actions[i], buffer_reads, buffer_writes);
+        auto used = [&](unsigned texture) {
+            return texture != built_in_window && graphics_textures[texture];
+        };
+        auto buffer_used = [&](unsigned buffer) {
+            return static_cast<bool>(graphics_buffers[buffer]);
+        };
+        auto async =
+            async_compute && actions[i].type == action_type::compute &&
+            document.computes.async[actions[i].index] &&
+            std::none_of(reads.begin(), reads.end(), used) &&
+            std::none_of(writes.begin(), writes.end(), used) &&
+            std::none_of(
+                buffer_reads.begin(), buffer_reads.end(), buffer_used
+            ) &&
+            std::none_of(
+                buffer_writes.begin(), buffer_writes.end(), buffer_used
+            );
+        async_actions[i] = async;
+        if (async)
+            continue;
+        for (auto texture : reads)
+            if (texture != built_in_window)
+                graphics_textures[texture] = true;
+        for (auto texture : writes)
+            if (texture != built_in_window)
+                graphics_textures[texture] = true;
+        for (auto buffer : buffer_reads)
+            graphics_buffers[buffer] = true;
+        for (auto buffer : buffer_writes)
+            graphics_buffers[buffer] = true;
+    }
+    shared_textures.assign(texture_count, false);
+    shared_buffers.assign(buffer_count, false);
+    for (uint32_t i = 0; i < actions.size(); i++) {
+        if (!async_actions[i])
+            continue;
+        action_textures(document, actions[i], reads, writes);
+        action_buffers(document, actions[i], buffer_reads, buffer_writes);
+        for (auto texture : reads)
+            shared_textures[texture] = true;
+        for (auto texture : writes)
+            shared_textures[texture] = true;
+        for (auto buffer : buffer_reads)
+            shared_buffers[buffer] = true;
+        for (auto buffer : buffer_writes)
+            shared_buffers[buffer] = true;
+    }
+
+    // read before written, so the content of the last frame is used, the
+    // images of swapped textures are always one of those, textures of async
+    // actions are used while graphics run the whole frame
+    for (size_t i = 0; i < texture_count; i++) {
+        if (
+            persistent[i] || swap_partners[i] != no_texture ||
+            shared_textures[i]
+        ) {
+            first_uses[i] = 0;
+            last_uses[i] = last_action;
+        }
+    }
+
+    // framebuffers have a single size, 0 follows the window
+    auto texture_extent = [&](unsigned texture) {
+        if (texture == built_in_window)
+            return std::pair(0u, 0u);
+        return std::pair(textures[texture].width, textures[texture].height);
+    };
+    auto program_count = document.programs.size();
+    program_passes.resize(program_count);
+    program_subpasses.resize(program_count);
+    program_outs.resize(program_count);
+    std::vector<uint32_t> action_passes(actions.size(), -1u);
+    // sampled textures of the last pass, which it can't write
+    std::vector<unsigned> pass_reads;
+    std::pair<unsigned, unsigned> pass_extent;
+    bool open = false;
+    for (uint32_t i = 0; i < actions.size(); i++) {
+        if (actions[i].type != action_type::program) {
+            open = false;
+            continue;
+        }
+        action_textures(document, actions[i], reads, writes);
+
+        // only merged if that saves loading or storing an attachment, an
+        // action sampling an attachment of the pass starts a new one, so the
+        // barrier before it makes the writes visible to the sampler
+        auto join = open;
+        if (join) {
+            auto shared = false;
+            for (auto texture : writes) {
+                join = join &&
+                    texture_extent(texture) == pass_extent &&
+                    std::find(pass_reads.begin(), pass_reads.end(), texture) ==
+                    pass_reads.end();
+                shared = shared ||
+                    pass_attachment(*this, passes.back(), texture) != -1u;
+            }
+            for (auto texture : reads)
+                join = join &&
+                    pass_attachment(*this, passes.back(), texture) == -1u;
+            join = join && shared;
+        }
+        if (!join) {
+            passes.push_back({
+                {i, 0}, {static_cast<uint32_t>(attachments.size()), 0}
+            });
+            pass_reads.clear();
+            pass_extent = writes.empty() ?
+                texture_extent(built_in_window) : texture_extent(writes[0]);
+        }
+
+        auto& pass = passes.back();
+        auto program = actions[i].index;
+        action_passes[i] = static_cast<uint32_t>(passes.size() - 1);
+        program_passes[program] = action_passes[i];
+        program_subpasses[program] = pass.actions.count++;
+        program_outs[program] = {static_cast<uint32_t>(references.size()), 0};
+        for (auto texture : writes) {
+            auto attachment = pass_attachment(*this, pass, texture);
+            if (attachment == -1u) {
+                attachment = pass.attachments.count++;
+                attachments.push_back(texture);
+            }
+            references.push_back(attachment);
+            program_outs[program].count++;
+        }
+        pass_reads.insert(pass_reads.end(), reads.begin(), reads.end());
+        open = true;
+    }
+
+    // consecutive blits share barriers as long as none uses what another
+    // one writes, swapped blits record nothing
+    std::vector<uint32_t> group_starts(actions.size());
+    std::vector<unsigned> batch_reads, batch_writes;
+    auto batch_start = -1u;
+    for (uint32_t i = 0; i < actions.size(); i++) {
+        group_starts[i] = i;
+        if (action_passes[i] != -1u) {
+            group_starts[i] = passes[action_passes[i]].actions.first;
+            batch_start = -1u;
+            continue;
+        }
+        if (
+            actions[i].type == action_type::compute ||
+            blit_swaps[actions[i].index]
+        ) {
+            batch_start = -1u;
+            continue;
+        }
+        action_textures(document, actions[i], reads, writes);
+        auto contains = [](const std::vector<unsigned>& textures, unsigned t) {
+            return std::find(textures.begin(), textures.end(), t) !=
+                textures.end();
+        };
+        if (
+            batch_start == -1u ||
+            contains(batch_writes, reads[0]) ||
+            contains(batch_writes, writes[0]) ||
+            contains(batch_reads, writes[0])
+        ) {
+            batch_start = i;
+            batch_reads.clear();
+            batch_writes.clear();
+        }
+        group_starts[i] = batch_start;
+        batch_reads.push_back(reads[0]);
+        batch_writes.push_back(writes[0]);
+    }
+
+    // the pass or batch of the first graphics action using what an async
+    // action uses waits for the compute queue
+    async_join = static_cast<uint32_t>(actions.size());
+    for (uint32_t i = 0; i < actions.size(); i++) {
+        if (async_actions[i])
+            continue;
+        action_textures(document, actions[i], reads, writes);
+        action_buffers(document, actions[i], buffer_reads, buffer_writes);
+        auto shared = [&](unsigned texture) {
+            return texture != built_in_window && shared_textures[texture];
+        };
+        auto buffer_shared = [&](unsigned buffer) {
+            return static_cast<bool>(shared_buffers[buffer]);
+        };
+        if (
+            std::any_of(reads.begin(), reads.end(), shared) ||
+            std::any_of(writes.begin(), writes.end(), shared) ||
+            std::any_of(
+                buffer_reads.begin(), buffer_reads.end(), buffer_shared
+            ) ||
+            std::any_of(
+                buffer_writes.begin(), buffer_writes.end(), buffer_shared
+            )
+        ) {
+            async_join = group_starts[i];
+            break;
+        }
+    }
+    window_before_join = false;
+    for (uint32_t i = 0; i < async_join; i++) {
+        action_textures(document, actions[i], reads, writes);
+        window_before_join = window_before_join ||
+            std::find(writes.begin(), writes.end(), built_in_window) !=
+            writes.end() ||
+            std::find(reads.begin(), reads.end(), built_in_window) !=
+            reads.end();
+    }
+
+    // textures of a pass are alive for all of it, so that none of its
+    // attachments alias each other
+    for (size_t i = 0; i < texture_count; i++) {
+        if (first_uses[i] > last_uses[i])
+            continue;
+        auto first_pass = action_passes[first_uses[i]];
+        auto last_pass = action_passes[last_uses[i]];
+        if (first_pass != -1u)
+            first_uses[i] = passes[first_pass].actions.first;
+        if (last_pass != -1u)
+            last_uses[i] = passes[last_pass].actions.first +
+                passes[last_pass].actions.count - 1;
+        pass_local[i] =
+            !persistent[i] && !storage[i] && first_pass != -1u &&
+            first_pass == last_pass;
+    }
+
+    std::vector<bool> written(texture_count + 1, false);
+    for (const auto& pass : passes) {
+        auto last = pass.actions.first + pass.actions.count - 1;
+        for (
+            auto i = pass.attachments.first;
+            i < pass.attachments.first + pass.attachments.count; i++
+        ) {
+            auto texture = attachments[i];
+            auto index = slot(texture);
+            attachment_clears.push_back(
+                !written[index] &&
+                (index == window || !persistent[index])
+            );
+            attachment_stores.push_back(
+                index == window || persistent[index] ||
+                last_uses[index] > last
+            );
+            written[index] = true;
+        }
+    }
+
+    texture_state output_state = {
+        output_layout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+    };
+    if (output_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+        output_state = {
+            output_layout, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT,
+        };
+
+    // actions are walked in the order the queues run them, the graphics
+    // actions before the join, the async ones and the rest
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < async_join; i++)
+        if (!async_actions[i])
+            order.push_back(i);
+    for (uint32_t i = 0; i < actions.size(); i++)
+        if (async_actions[i])
+            order.push_back(i);
+    for (auto i = async_join; i < actions.size(); i++)
+        if (!async_actions[i])
+            order.push_back(i);
+
+    // persistent textures and buffers start a frame in the state the last
+    // one left them in, which is only known after walking the actions once
+    frame_states.assign(texture_count, transient_state);
+    buffer_frame_states.assign(
+        buffer_count, {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0}
+    );
+    std::vector<texture_state> states(texture_count + 1);
+    std::vector<buffer_state> buffer_states(buffer_count);
+    std::vector<texture_use> uses;
+    std::vector<buffer_use> buffer_uses;
+    for (auto walk = 0; walk < 2; walk++) {
+        barriers.clear();
+        buffer_barriers.clear();
+        action_barriers.assign(actions.size() + 1, {0, 0});
+        action_buffer_barriers.assign(actions.size() + 1, {0, 0});
+        std::copy(frame_states.begin(), frame_states.end(), states.begin());
+        states[window] = window_state;
+        buffer_states = buffer_frame_states;
+
+        for (auto i : order) {
+            range action_range = {static_cast<uint32_t>(barriers.size()), 0};
+            range buffer_range = {
+                static_cast<uint32_t>(buffer_barriers.size()), 0
+            };
+            // later actions of a pass are covered by its subpass
+            // dependencies, later blits of a batch by its first one
+            auto pass = action_passes[i];
+            uses.clear();
+            buffer_uses.clear();
+            auto group_start = group_starts[i] == i;
+            if (group_start && pass != -1u) {
+                pass_uses(document, *this, passes[pass], uses);
+            } else if (actions[i].type == action_type::compute) {
+                action_textures(document, actions[i], reads, writes);
+                for (auto texture : reads)
+                    add_use(uses, texture, storage_read_state, false);
+                for (auto texture : writes)
+                    add_use(uses, texture, storage_write_state, true);
+                action_buffers(
+                    document, actions[i], buffer_reads, buffer_writes
+                );
+                for (auto buffer : buffer_reads)
+                    add_buffer_use(
+                        buffer_uses, buffer, buffer_read_state, false
+                    );
+                for (auto buffer : buffer_writes)
+                    add_buffer_use(
+                        buffer_uses, buffer, buffer_write_state, true
+                    );
+            } else if (group_start && !blit_swaps[actions[i].index]) {
+                for (
+                    auto j = i; j < actions.size() && group_starts[j] == i;
+                    j++
+                ) {
+                    action_textures(document, actions[j], reads, writes);
+                    add_use(uses, reads[0], blit_source_state, false);
+                    add_use(uses, writes[0], blit_destination_state, true);
+                }
+            }
+            for (const auto& use : uses) {
+                auto& state = states[slot(use.texture)];
+                if (async_actions[i])
+                    on_compute_queue(state.stages, state.accesses);
+                // reads of the same layout only extend the state
+                if (
+                    state.layout != use.state.layout ||
+                    (state.accesses & write_accesses) != 0 || use.write
+                ) {
+                    barriers.push_back({use.texture, state, use.state});
+                    action_range.count++;
+                    state = use.state;
+                } else {
+                    state.stages |= use.state.stages;
+                    state.accesses |= use.state.accesses;
+                }
+            }
+            for (const auto& use : buffer_uses) {
+                auto& state = buffer_states[use.buffer];
+                if (async_actions[i])
+                    on_compute_queue(state.stages, state.accesses);
+                if ((state.accesses & write_accesses) != 0 || use.write) {
+                    buffer_barriers.push_back({use.buffer, state, use.state});
+                    buffer_range.count++;
+                    state = use.state;
+                } else {
+                    state.stages |= use.state.stages;
+                    state.accesses |= use.state.accesses;
+                }
+            }
+            action_barriers[i] = action_range;
+            action_buffer_barriers[i] = buffer_range;
+        }
+
+        action_barriers.back() = {static_cast<uint32_t>(barriers.size()), 1};
+        barriers.push_back({built_in_window, states[window], output_state});
+
+        buffer_frame_states = buffer_states;
+        for (size_t i = 0; i < texture_count; i++)
+            if (persistent[i])
+                frame_states[i] = states[i];
+        // the image of the source is the destination in the next frame
+        for (size_t i = 0; i < texture_count; i++)
+            if (persistent[i] && swap_partners[i] != no_texture)
+                frame_states[i] = states[swap_partners[i]];
+    }
+}
+
+unsigned image_texture(
+    const render_graph& graph, unsigned texture, unsigned parity
+) {
+    if (
+        parity % 2 == 0 || texture >= graph.swap_partners.size() ||
+        graph.swap_partners[texture] == no_texture
+    )
+        return texture;
+    return graph.swap_partners[texture];
+}
+
+bool compatible_passes(
+    const render_graph& a, const render_graph& b, uint32_t program
+) {
+    if (
+        program >= a.program_passes.size() ||
+        program >= b.program_passes.size() ||
+        a.program_subpasses[program] != b.program_subpasses[program]
+    )
+        return false;
+    auto& a_pass = a.passes[a.program_passes[program]];
+    auto& b_pass = b.passes[b.program_passes[program]];
+    if (
+        a_pass.actions.count != b_pass.actions.count ||
+        a_pass.attachments.count != b_pass.attachments.count
+    )
+        return false;
+
+    auto attachment_format = [](const render_graph& graph, uint32_t index) {
+        auto texture = graph.attachments[index];
+        if (texture == built_in_window)
+            return -1;
+        return static_cast<int>(graph.textures[texture].format);
+    };
+    for (auto i = 0u; i < a_pass.attachments.count; i++) {
+        if (
+            attachment_format(a, a_pass.attachments.first + i) !=
+            attachment_format(b, b_pass.attachments.first + i)
+        )
+            return false;
+    }
+
+    // subpass dependencies only depend on the references
+    auto same_references = [&](range a_range, range b_range) {
+        return
+            a_range.count == b_range.count && std::equal(
+                a.references.begin() + a_range.first,
+                a.references.begin() + a_range.first + a_range.count,
+                b.references.begin() + b_range.first
+            );
+    };
+    for (auto i = 0u; i < a_pass.actions.count; i++) {
+        auto a_program = a.actions[a_pass.actions.first + i].index;
+        auto b_program = b.actions[b_pass.actions.first + i].index;
+        if (
+            !same_references(
+                a.program_outs[a_program], b.program_outs[b_program]
+            )
+        )
+            return false;
+    }
+    return true;
+}
+
+unique_render_pass create_render_pass(
+    const render_graph& graph, uint32_t pass_index, VkFormat output_format
+) {
+    auto& pass = graph.passes[pass_index];
+    auto attachment_count = pass.attachments.count;
+    auto subpass_count = pass.actions.count;
+
+    std::vector<VkAttachmentDescription> attachments;
+    for (auto i = 0u; i < attachment_count; i++) {
+        auto index = pass.attachments.first + i;
+        auto texture = graph.attachments[index];
+        attachments.push_back({
+            .format = texture == built_in_window ?
+                output_format :
+                vulkan_format(graph.textures[texture].format),
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = graph.attachment_clears[index] ?
+                VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+            .storeOp = graph.attachment_stores[index] ?
+                VK_ATTACHMENT_STORE_OP_STORE :
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        });
+    }
+
+    // first and last subpass referencing each attachment, in between it
+    // has to be preserved
+    std::vector<uint32_t> first_subpasses(attachment_count, -1u);
+    std::vector<uint32_t> last_subpasses(attachment_count, 0);
+    for (auto i = 0u; i < subpass_count; i++) {
+        auto program = graph.actions[pass.actions.first + i].index;
+        auto outs = graph.program_outs[program];
+        for (auto j = outs.first; j < outs.first + outs.count; j++) {
+            auto attachment = graph.references[j];
+            first_subpasses[attachment] =
+                std::min(first_subpasses[attachment], i);
+            last_subpasses[attachment] = i;
+        }
+    }
+
+    // references are stored in one array each, so that pointers into them
+    // stay valid
+    std::vector<VkAttachmentReference> color_references;
+    std::vector<uint32_t> preserved;
+    std::vector<range> preserved_ranges;
+    for (auto i = 0u; i < subpass_count; i++) {
+        auto program = graph.actions[pass.actions.first + i].index;
+        auto outs = graph.program_outs[program];
+        for (auto j = outs.first; j < outs.first + outs.count; j++)
+            color_references.push_back({
+                graph.references[j], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+            });
+
+        range preserved_range = {static_cast<uint32_t>(preserved.size()), 0};
+        auto referenced = [&](range references, uint32_t attachment) {
+            auto first = graph.references.begin() + references.first;
+            auto last = first + references.count;
+            return std::find(first, last, attachment) != last;
+        };
+        for (auto j = 0u; j < attachment_count; j++) {
+            if (
+                first_subpasses[j] < i && i < last_subpasses[j] &&
+                !referenced(outs, j)
+            ) {
+                preserved.push_back(j);
+                preserved_range.count++;
+            }
+        }
+        preserved_ranges.push_back(preserved_range);
+    }
+
+    std::vector<VkSubpassDescription> subpasses;
+    uint32_t color_offset = 0;
+    for (auto i = 0u; i < subpass_count; i++) {
+        auto program = graph.actions[pass.actions.first + i].index;
+        auto outs = graph.program_outs[program];
+        subpasses.push_back({
+            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+            .colorAttachmentCount = outs.count,
+            .pColorAttachments = color_references.data() + color_offset,
+            .preserveAttachmentCount = preserved_ranges[i].count,
+            .pPreserveAttachments =
+                preserved.data() + preserved_ranges[i].first,
+        });
+        color_offset += outs.count;
+    }
+
+    // every subpass waits for the one before it, so dependencies chain
+    // across subpasses that don't touch an attachment
+    std::vector<VkSubpassDependency> dependencies;
+    for (auto i = 1u; i < subpass_count; i++)
+        dependencies.push_back({
+            .srcSubpass = i - 1,
+            .dstSubpass = i,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask =
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
+        });
+
+    VkRenderPassCreateInfo render_pass_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = attachment_count,
+        .pAttachments = attachments.data(),
+        .subpassCount = subpass_count,
+        .pSubpasses = subpasses.data(),
+        .dependencyCount = static_cast<uint32_t>(dependencies.size()),
+        .pDependencies = dependencies.data(),
+    };
+    unique_render_pass render_pass;
+    check(vkCreateRenderPass(
+        *current_device, &render_pass_info, nullptr, out_ptr(render_pass)
+    ));
+    return render_pass;
+}
+
+render_targets::render_targets(
+    const render_graph& graph, const renderer& renderer,
+    unsigned window_width, unsigned window_height, VkQueue queue
+) {
+    auto texture_count = graph.textures.size();
+    textures.resize(texture_count);
+    std::vector<VkMemoryRequirements> requirements(texture_count);
+    std::vector<unsigned> used;
+    uint32_t queue_family_index = renderer.graphics_queue_family;
+    uint32_t queue_families[] = {
+        renderer.graphics_queue_family, renderer.compute_queue_family,
+    };
+    // resources of both queues are shared instead of changing owners
+    auto concurrent = [&](bool shared) {
+        return shared && queue_families[0] != queue_families[1];
+    };
+
+    for (unsigned i = 0; i < texture_count; i++) {
+        if (graph.first_uses[i] > graph.last_uses[i])
+            continue;
+        used.push_back(i);
+
+        auto& definition = graph.textures[i];
+        auto& texture = textures[i];
+        texture.width =
+            definition.width == 0 ? window_width : definition.width;
+        texture.height =
+            definition.height == 0 ? window_height : definition.height;
+        // textures of one pass may never leave tile memory
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (graph.pass_local[i])
+            usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        else
+            usage |=
+                VK_IMAGE_USAGE_SAMPLED_BIT |
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if (graph.storage[i])
+            usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        auto shared = concurrent(graph.shared_textures[i]);
+        VkImageCreateInfo image_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = vulkan_format(definition.format),
+            .extent = {texture.width, texture.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = usage,
+            .sharingMode = shared ?
+                VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = shared ? 2u : 1u,
+            .pQueueFamilyIndices = queue_families,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        check(vkCreateImage(
+            *current_device, &image_info, nullptr, out_ptr(texture.image)
+        ));
+        vkGetImageMemoryRequirements(
+            *current_device, texture.image.get(), &requirements[i]
+        );
+        unaliased_size += requirements[i].size;
+    }
+
+    // lazily allocated memory is only backed where tiles are spilled, so
+    // it isn't shared
+    auto& memory_properties = renderer.allocator->memory_properties;
+    VkMemoryPropertyFlags lazy_properties =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+        VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    auto lazily_allocatable = [&](uint32_t type_bits) {
+        for (auto i = 0u; i < memory_properties.memoryTypeCount; i++) {
+            auto flags = memory_properties.memoryTypes[i].propertyFlags;
+            if (
+                (type_bits & (1u << i)) &&
+                (flags & lazy_properties) == lazy_properties
+            )
+                return true;
+        }
+        return false;
+    };
+    std::vector<unsigned> shareable;
+    for (auto texture : used) {
+        auto& texture_requirements = requirements[texture];
+        if (
+            !graph.pass_local[texture] ||
+            !lazily_allocatable(texture_requirements.memoryTypeBits)
+        ) {
+            shareable.push_back(texture);
+            continue;
+        }
+        auto allocation = renderer.allocator->allocate(
+            texture_requirements, lazy_properties, true
+        );
+        memory.emplace_back(*renderer.allocator, allocation);
+        lazy_size += texture_requirements.size;
+        check(vkBindImageMemory(
+            *current_device, textures[texture].image.get(),
+            allocation.memory, allocation.offset
+        ));
+    }
+
+    // largest first, every texture goes into the first memory none of whose
+    // textures is alive at the same time
+    std::sort(
+        shareable.begin(), shareable.end(), [&](unsigned a, unsigned b) {
+            return requirements[a].size > requirements[b].size;
+        }
+    );
+    auto overlap = [&](unsigned a, unsigned b) {
+        return
+            graph.first_uses[a] <= graph.last_uses[b] &&
+            graph.first_uses[b] <= graph.last_uses[a];
+    };
+    struct shared_memory {
+        VkMemoryRequirements requirements;
+        std::vector<unsigned> textures;
+    };
+    std::vector<shared_memory> shared;
+    for (auto texture : shareable) {
+        auto& texture_requirements = requirements[texture];
+        auto memory = std::find_if(
+            shared.begin(), shared.end(), [&](const shared_memory& memory) {
+                return
+                    (memory.requirements.memoryTypeBits &
+                    texture_requirements.memoryTypeBits) != 0 &&
+                    std::none_of(
+                        memory.textures.begin(), memory.textures.end(),
+                        [&](unsigned other) { return overlap(texture, other); }
+                    );
+            }
+        );
+        if (memory == shared.end()) {
+            shared.push_back({texture_requirements, {texture}});
+            continue;
+        }
+        auto& combined = memory->requirements;
+        combined.size = std::max(combined.size, texture_requirements.size);
+        combined.alignment = std::max(
+            combined.alignment, texture_requirements.alignment
+        );
+        combined.memoryTypeBits &= texture_requirements.memoryTypeBits;
+        memory->textures.push_back(texture);
+    }
+
+    for (const auto& memory : shared) {
+        auto allocation = renderer.allocator->allocate(
+            memory.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true
+        );
+        this->memory.emplace_back(*renderer.allocator, allocation);
+        aliased_size += memory.requirements.size;
+        for (auto texture : memory.textures) {
+            check(vkBindImageMemory(
+                *current_device, textures[texture].image.get(),
+                allocation.memory, allocation.offset
+            ));
+        }
+    }
+
+    for (auto i : used) {
+        VkImageViewCreateInfo image_view_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = textures[i].image.get(),
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = vulkan_format(graph.textures[i].format),
+            .subresourceRange = color_subresources,
+        };
+        check(vkCreateImageView(
+            *current_device, &image_view_info, nullptr,
+            out_ptr(textures[i].view)
+        ));
+    }
+
+    auto buffer_count = graph.buffer_sizes.size();
+    for (size_t i = 0; i < buffer_count; i++) {
+        auto shared = concurrent(graph.shared_buffers[i]);
+        VkBufferCreateInfo buffer_info = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = graph.buffer_sizes[i],
+            .usage =
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = shared ?
+                VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = shared ? 2u : 1u,
+            .pQueueFamilyIndices = queue_families,
+        };
+        buffers.emplace_back();
+        check(vkCreateBuffer(
+            *current_device, &buffer_info, nullptr, out_ptr(buffers.back())
+        ));
+        buffer_memory.push_back(allocate_buffer_memory(
+            *renderer.allocator, buffers.back().get(),
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        ));
+    }
+
+    // persistent textures start out cleared, in the state between frames,
+    // either image of a swapped pair may hold the persistent one, as do
+    // buffers
+    std::vector<VkImageMemoryBarrier> clear_barriers, state_barriers;
+    for (auto i : used) {
+        auto persistent = graph.persistent[i] ? i : graph.swap_partners[i];
+        if (persistent == no_texture || !graph.persistent[persistent])
+            continue;
+        auto image = textures[i].image.get();
+        auto& state = graph.frame_states[persistent];
+        clear_barriers.push_back({
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = color_subresources,
+        });
+        state_barriers.push_back({
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = state.accesses,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = state.layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = color_subresources,
+        });
+    }
+    std::vector<VkBufferMemoryBarrier> buffer_barriers;
+    VkPipelineStageFlags state_stages = 0;
+    for (size_t i = 0; i < buffer_count; i++) {
+        auto& state = graph.buffer_frame_states[i];
+        state_stages |= state.stages;
+        buffer_barriers.push_back({
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = state.accesses,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = buffers[i].get(),
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+        });
+    }
+    if (clear_barriers.empty() && buffer_barriers.empty())
+        return;
+
+    unique_command_pool command_pool;
+    VkCommandPoolCreateInfo command_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queue_family_index,
+    };
+    check(vkCreateCommandPool(
+        *current_device, &command_pool_info, nullptr, out_ptr(command_pool)
+    ));
+    VkCommandBufferAllocateInfo command_buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool.get(),
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer command_buffer;
+    check(vkAllocateCommandBuffers(
+        *current_device, &command_buffer_info, &command_buffer
+    ));
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    check(vkBeginCommandBuffer(command_buffer, &begin_info));
+
+    vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(clear_barriers.size()), clear_barriers.data()
+    );
+    VkClearColorValue black = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    for (const auto& barrier : clear_barriers)
+        vkCmdClearColorImage(
+            command_buffer, barrier.image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black,
+            1, &color_subresources
+        );
+    for (const auto& buffer : buffers)
+        vkCmdFillBuffer(command_buffer, buffer.get(), 0, VK_WHOLE_SIZE, 0);
+    for (auto i : used)
+        if (graph.persistent[i])
+            state_stages |= graph.frame_states[i].stages;
+    vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, state_stages, 0,
+        0, nullptr,
+        static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+        static_cast<uint32_t>(state_barriers.size()), state_barriers.data()
+    );
+    check(vkEndCommandBuffer(command_buffer));
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+    };
+    check(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+    check(vkQueueWaitIdle(queue));
+}
+
+void render_targets::print_statistics(std::ostream& stream) const {
+    auto image_count = std::count_if(
+        textures.begin(), textures.end(),
+        [](const render_texture& texture) {
+            return texture.image.get() != VK_NULL_HANDLE;
+        }
+    );
+    stream <<
+        "textures: " << image_count << " in " << memory.size() <<
+        " allocations, " << unaliased_size << " bytes without aliasing, " <<
+        aliased_size << " bytes with aliasing, " << lazy_size <<
+        " bytes lazily allocated" << std::endl;
+}
+
+void record_barriers(
+    VkCommandBuffer command_buffer, const render_graph& graph,
+    size_t action_index, const render_targets& targets, unsigned parity,
+    VkImage output
+) {
+    auto barriers = graph.action_barriers[action_index];
+    auto buffer_barriers = graph.action_buffer_barriers[action_index];
+    if (barriers.count == 0 && buffer_barriers.count == 0)
+        return;
+
+    std::vector<VkImageMemoryBarrier> image_barriers;
+    VkPipelineStageFlags source_stages = 0, destination_stages = 0;
+    for (auto i = barriers.first; i < barriers.first + barriers.count; i++) {
+        auto& barrier = graph.barriers[i];
+        source_stages |= barrier.before.stages;
+        destination_stages |= barrier.after.stages;
+        image_barriers.push_back({
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            // only writes have to be made available
+            .srcAccessMask = barrier.before.accesses & write_accesses,
+            .dstAccessMask = barrier.after.accesses,
+            .oldLayout = barrier.before.layout,
+            .newLayout = barrier.after.layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = barrier.texture == built_in_window ?
+                output :
+                targets.textures[
+                    image_texture(graph, barrier.texture, parity)
+                ].image.get(),
+            .subresourceRange = color_subresources,
+        });
+    }
+    std::vector<VkBufferMemoryBarrier> memory_barriers;
+    for (
+        auto i = buffer_barriers.first;
+        i < buffer_barriers.first + buffer_barriers.count; i++
+    ) {
+        auto& barrier = graph.buffer_barriers[i];
+        source_stages |= barrier.before.stages;
+        destination_stages |= barrier.after.stages;
+        memory_barriers.push_back({
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = barrier.before.accesses & write_accesses,
+            .dstAccessMask = barrier.after.accesses,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = targets.buffers[barrier.buffer].get(),
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+        });
+    }
+    vkCmdPipelineBarrier(
+        command_buffer, source_stages, destination_stages, 0,
+        0, nullptr,
+        static_cast<uint32_t>(memory_barriers.size()), memory_barriers.data(),
+        static_cast<uint32_t>(image_barriers.size()), image_barriers.data()
+    );
+}
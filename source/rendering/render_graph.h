@@ -0,0 +1,190 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../data/document.h"
+#include "resources.h"
+#include "renderer.h"
+#include "memory.h"
+
+VkFormat vulkan_format(format format);
+
+// layout of a texture and how it was used since its last barrier
+struct texture_state {
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags accesses;
+};
+
+struct texture_barrier {
+    // index in document::textures or built_in_window
+    unsigned texture;
+    texture_state before, after;
+};
+
+// stages and accesses of a storage buffer since its last barrier
+struct buffer_state {
+    VkPipelineStageFlags stages;
+    VkAccessFlags accesses;
+};
+
+struct buffer_barrier {
+    // index in document::buffers
+    unsigned buffer;
+    buffer_state before, after;
+};
+
+// consecutive program actions rendered as the subpasses of one render pass
+struct graph_pass {
+    // view actions, all of them program actions
+    range actions;
+    // into render_graph::attachments
+    range attachments;
+};
+
+// texture uses of the view actions of a document, derived once per document
+// and independent of the resolution
+//
+// barriers are only placed where the layout changes or a write is involved,
+// textures whose content is read before it's written in a frame keep it
+// over frames, all others are transient and may share memory
+//
+// a program action joins the render pass of the action before it if it
+// writes one of its attachments and samples none of them, sampling the
+// result of a pass needs the barrier after it, textures only used inside
+// one pass are never stored to memory
+//
+// consecutive blits share their barriers unless one uses the result of
+// another, a blit that is the last use of both textures in a frame, with
+// the destination read before it, swaps their images for the next frame
+// instead of copying
+//
+// with async_compute, compute actions marked async that use nothing an
+// earlier graphics action uses run on the compute queue, the graphics queue
+// waits for it from the first action using its textures or buffers on
+struct render_graph {
+    render_graph() = default;
+    render_graph(
+        const document& document, VkImageLayout output_layout,
+        bool async_compute
+    );
+
+    std::vector<texture_definition> textures;
+    // view action indices of the first and last use of every texture,
+    // widened to whole passes, unused textures have their first use past
+    // their last
+    std::vector<uint32_t> first_uses, last_uses;
+    std::vector<bool> persistent;
+    // only used by the attachments of a single pass
+    std::vector<bool> pass_local;
+    // bound as storage image by a compute action
+    std::vector<bool> storage;
+    // texture whose image is exchanged with this one every other frame or
+    // no_texture
+    std::vector<unsigned> swap_partners;
+    // state of the textures between frames
+    std::vector<texture_state> frame_states;
+
+    std::vector<action> actions;
+    std::vector<graph_pass> passes;
+    // texture of each attachment, index in textures or built_in_window
+    std::vector<unsigned> attachments;
+    // the first write of a texture in a frame clears instead of loading,
+    // content nothing reads after the pass isn't stored
+    std::vector<bool> attachment_clears, attachment_stores;
+
+    blit_actions blits;
+    // per blit, swapped blits record nothing
+    std::vector<bool> blit_swaps;
+    compute_actions computes;
+
+    // per view action, runs on the compute queue
+    std::vector<bool> async_actions;
+    // the graphics actions from this one on wait for the compute queue,
+    // actions.size() if none uses what async actions use
+    uint32_t async_join;
+    // a graphics action before the join uses the window, so the frame
+    // waits for it to be acquired from the start
+    bool window_before_join;
+    // used on the compute queue, the graphics queue clears them and may use
+    // them too, so they are shared by both queue families
+    std::vector<bool> shared_textures, shared_buffers;
+
+    // storage buffers keep their content, this is their state between frames
+    std::vector<uint32_t> buffer_sizes;
+    std::vector<buffer_state> buffer_frame_states;
+
+    // per program
+    std::vector<uint32_t> program_passes, program_subpasses;
+    // per program, into references, which index the attachments of the pass
+    std::vector<range> program_outs;
+    std::vector<uint32_t> references;
+
+    // barriers before each view action, later actions of a pass or blits
+    // of a batch have none, the entry past the last action transitions the
+    // window to output_layout
+    // barriers of async actions leave out what the semaphores between the
+    // queues already wait for
+    std::vector<range> action_barriers;
+    std::vector<texture_barrier> barriers;
+    std::vector<range> action_buffer_barriers;
+    std::vector<buffer_barrier> buffer_barriers;
+};
+
+// texture whose image holds texture in frames of parity
+unsigned image_texture(
+    const render_graph& graph, unsigned texture, unsigned parity
+);
+
+// pipelines of the program in both graphs can be used with either pass
+bool compatible_passes(
+    const render_graph& a, const render_graph& b, uint32_t program
+);
+
+// attachments enter and leave the pass in COLOR_ATTACHMENT_OPTIMAL, the
+// barriers of the graph transition them
+unique_render_pass create_render_pass(
+    const render_graph& graph, uint32_t pass, VkFormat output_format
+);
+
+struct render_texture {
+    unique_image image;
+    unique_image_view view;
+    unsigned width, height;
+};
+
+// images of the textures of a render graph at one resolution, transient
+// textures whose lifetimes don't overlap share memory, and the storage
+// buffers, which are cleared along with the persistent textures
+struct render_targets {
+    render_targets() = default;
+    // persistent textures are cleared and transitioned to their state
+    // between frames on queue before returning
+    render_targets(
+        const render_graph& graph, const renderer& renderer,
+        unsigned window_width, unsigned window_height, VkQueue queue
+    );
+
+    void print_statistics(std::ostream& stream) const;
+
+    // per texture of the graph, unused textures have no image
+    std::vector<render_texture> textures;
+    std::vector<unique_allocation> memory;
+    // per buffer of the graph
+    std::vector<unique_buffer> buffers;
+    std::vector<unique_allocation> buffer_memory;
+    // memory the images need on their own and with aliasing, textures of a
+    // single pass get lazily allocated memory where available
+    VkDeviceSize unaliased_size = 0, aliased_size = 0, lazy_size = 0;
+};
+
+// records the barriers the graph places before the action, the index past
+// the last action records the transition of output at the end of the frame
+void record_barriers(
+    VkCommandBuffer command_buffer, const render_graph& graph,
+    size_t action_index, const render_targets& targets, unsigned parity,
+    VkImage output
+);
@@ -5,6 +5,19 @@ renderer::renderer() {
         shaderc_optimization_level_performance
     );
     compiler_options.SetAutoBindUniforms(true);
+    // the uniform block keeps binding 0 of the shared layout when a
+    // program also samples textures
+    compiler_options.SetBindingBase(shaderc_uniform_kind_texture, 1);
+    compiler_options.SetBindingBase(shaderc_uniform_kind_sampler, 1);
     compiler_options.SetAutoMapLocations(true);
     compiler_options.SetGenerateDebugInfo();
+    compiler_options_key =
+        "optimization=performance auto_bind_uniforms "
+        "texture_binding_base=1 sampler_binding_base=1 auto_map_locations "
+        "debug";
+}
+
+const shaderc::Compiler& thread_compiler() {
+    thread_local shaderc::Compiler compiler;
+    return compiler;
 }
@@ -2,23 +2,55 @@
 
 #include <string>
 #include <stdexcept>
+#include <memory>
 
 #include <vulkan/vulkan.h>
 #include <shaderc/shaderc.hpp>
 
 #include "resources.h"
+#include "shader_cache.h"
+#include "pipeline_cache.h"
+#include "memory.h"
 
 struct renderer {
     renderer();
 
-    // TODO: move compiler to application struct
-    shaderc::Compiler compiler;
+    // shaders are compiled on job threads, each of which has its own
+    // shaderc::Compiler, see thread_compiler
     shaderc::CompileOptions compiler_options;
+    // describes compiler_options for the shader cache key, as they are opaque
+    std::string compiler_options_key;
+    // optional, shaders are always compiled if this is null
+    std::unique_ptr<shader_cache> shader_binaries;
+
+    // used for all pipelines, loaded on startup and saved on shutdown
+    unique_pipeline_cache pipeline_cache;
+    // VK_EXT_pipeline_creation_feedback is enabled, so cache hits are known
+    bool pipeline_creation_feedback = false;
+    mutable pipeline_cache_statistics pipeline_statistics;
+
+    // all buffers and images take their memory from here
+    std::unique_ptr<device_allocator> allocator;
 
     uint32_t graphics_queue_family, present_queue_family;
+    // a family without graphics if the device has one, async compute
+    // actions run on it next to the graphics queue, otherwise the same as
+    // graphics_queue_family
+    uint32_t compute_queue_family;
+    // a family with only transfers if the device has one, it copies
+    // uploads next to the other queues, otherwise graphics_queue_family
+    uint32_t transfer_queue_family;
+    // timestampValidBits of the graphics and compute families, actions
+    // aren't timed on queues without timestamps
+    uint32_t graphics_timestamp_bits = 0, compute_timestamp_bits = 0;
+    VkPhysicalDevice physical_device;
+    VkPhysicalDeviceProperties physical_device_properties;
     VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
 };
 
+// compiler instance of the calling thread
+const shaderc::Compiler& thread_compiler();
+
 struct out_of_memory_error : public std::bad_alloc {
     out_of_memory_error() : std::bad_alloc() {}
 };
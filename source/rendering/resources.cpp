@@ -1,3 +1,16 @@
 #include "resources.h"
 
 VkDevice *current_device;
+
+void print_resource_counts(std::ostream& stream) {
+    stream <<
+        "shader modules: " << unique_shader_module::live_count << ", " <<
+        "pipelines: " << unique_pipeline::live_count << ", " <<
+        "pipeline layouts: " << unique_pipeline_layout::live_count << ", " <<
+        "render passes: " << unique_render_pass::live_count << ", " <<
+        "framebuffers: " << unique_framebuffer::live_count << ", " <<
+        "descriptor pools: " << unique_descriptor_pool::live_count << ", " <<
+        "buffers: " << unique_buffer::live_count << ", " <<
+        "device memory: " << unique_device_memory::live_count << ", " <<
+        "image views: " << unique_image_view::live_count << std::endl;
+}
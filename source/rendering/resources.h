@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <ostream>
+
 #include <vulkan/vulkan.h>
 
 extern VkDevice *current_device;
@@ -9,28 +12,40 @@ struct unique_vulkan_resource {
     typedef T pointer;
 
     unique_vulkan_resource() : value(VK_NULL_HANDLE) {}
-    unique_vulkan_resource(T value) : value(value) {}
+    unique_vulkan_resource(T value) : value(value) {
+        if (value != VK_NULL_HANDLE)
+            live_count++;
+    }
     unique_vulkan_resource(const unique_vulkan_resource&) = delete;
     unique_vulkan_resource(unique_vulkan_resource &&o) : value(o.value) {
         o.value = VK_NULL_HANDLE;
     }
     ~unique_vulkan_resource() {
-        if (value != VK_NULL_HANDLE)
-            Deleter(*current_device, value, nullptr);
+        reset();
     }
     unique_vulkan_resource& operator= (const unique_vulkan_resource&) = delete;
     unique_vulkan_resource& operator= (unique_vulkan_resource &&o) {
-        if (value != VK_NULL_HANDLE)
-            Deleter(*current_device, value, nullptr);
+        reset();
         value = o.value;
         o.value = VK_NULL_HANDLE;
         return *this;
     }
 
-    const T& get() {
+    const T& get() const {
         return value;
     };
 
+    void reset() {
+        if (value != VK_NULL_HANDLE) {
+            Deleter(*current_device, value, nullptr);
+            live_count--;
+        }
+        value = VK_NULL_HANDLE;
+    }
+
+    // number of currently alive objects of this type, for diagnostics
+    static inline std::atomic<unsigned> live_count{0};
+
 private:
     T value;
 };
@@ -44,11 +59,16 @@ typedef unique_vulkan_resource<VkFramebuffer, vkDestroyFramebuffer>
 typedef unique_vulkan_resource<VkPipeline, vkDestroyPipeline>
     unique_pipeline;
 
+typedef unique_vulkan_resource<VkPipelineCache, vkDestroyPipelineCache>
+    unique_pipeline_cache;
+
 typedef unique_vulkan_resource<VkImage, vkDestroyImage> unique_image;
 
 typedef unique_vulkan_resource<VkImageView, vkDestroyImageView>
     unique_image_view;
 
+typedef unique_vulkan_resource<VkSampler, vkDestroySampler> unique_sampler;
+
 typedef unique_vulkan_resource<VkPipelineLayout, vkDestroyPipelineLayout>
     unique_pipeline_layout;
 
@@ -79,6 +99,11 @@ typedef unique_vulkan_resource<VkDeviceMemory, vkFreeMemory>
 typedef unique_vulkan_resource<VkDescriptorPool, vkDestroyDescriptorPool>
     unique_descriptor_pool;
 
+typedef unique_vulkan_resource<VkQueryPool, vkDestroyQueryPool>
+    unique_query_pool;
+
+// prints the number of alive objects for the most expensive resource types
+void print_resource_counts(std::ostream& stream);
 
 template<class Smart, class Pointer>
 struct out_ptr_t {
@@ -8,11 +8,13 @@
 
 #include <shaderc/shaderc.hpp>
 #include "spirv_reflect.h"
+#include "../data/instrumentation.h"
 
 reflected_shader_module::reflected_shader_module(
     const renderer &renderer, VkDevice device, const char *file_name,
     shaderc_shader_kind kind
 ) {
+    INSTRUMENT_SCOPE("reflected_shader_module");
     std::ifstream file(file_name, std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
@@ -27,7 +29,34 @@ reflected_shader_module::reflected_shader_module(
     file.seekg(0);
     file.read(source.data(), size);
 
-    auto compilation = renderer.compiler.CompileGlslToSpv(
+    uint64_t cache_key = 0;
+    if (renderer.shader_binaries) {
+        cache_key = shader_cache::key(
+            {source.data(), source.size()}, file_name, kind,
+            renderer.compiler_options_key
+        );
+        if (auto cached = renderer.shader_binaries->load(cache_key)) {
+            descriptor_offsets = std::move(cached->descriptor_offsets);
+            descriptor_size = cached->descriptor_size;
+            bindings = std::move(cached->bindings);
+            std::copy(
+                cached->local_size, cached->local_size + 3, local_size
+            );
+            inputs = std::move(cached->inputs);
+
+            VkShaderModuleCreateInfo shader_info {
+                .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                .codeSize = cached->code_size,
+                .pCode = cached->code
+            };
+            check(vkCreateShaderModule(
+                device, &shader_info, nullptr, out_ptr(module)
+            ));
+            return;
+        }
+    }
+
+    auto compilation = thread_compiler().CompileGlslToSpv(
         source.data(), source.size(), kind,
         file_name, renderer.compiler_options
     );
@@ -85,11 +114,57 @@ reflected_shader_module::reflected_shader_module(
                     );
                 }
             }
+            // blocks without an instance name are known by their type, the
+            // reflected types have the values of VkDescriptorType
+            std::string name = binding->name ? binding->name : "";
+            if (
+                name.empty() && binding->type_description &&
+                binding->type_description->type_name
+            )
+                name = binding->type_description->type_name;
+            bindings.push_back({
+                name, binding->set, binding->binding,
+                static_cast<uint32_t>(binding->descriptor_type),
+            });
+        }
+    }
+
+    if (
+        kind == shaderc_glsl_compute_shader &&
+        reflect_shader.entry_point_count > 0
+    ) {
+        auto& size = reflect_shader.entry_points[0].local_size;
+        local_size[0] = size.x;
+        local_size[1] = size.y;
+        local_size[2] = size.z;
+    }
+
+    if (kind == shaderc_glsl_vertex_shader) {
+        uint32_t input_count;
+        spvReflectEnumerateInputVariables(
+            &reflect_shader, &input_count, nullptr
+        );
+        std::vector<SpvReflectInterfaceVariable*> reflect_inputs(input_count);
+        spvReflectEnumerateInputVariables(
+            &reflect_shader, &input_count, reflect_inputs.data()
+        );
+        for (auto input : reflect_inputs) {
+            if (input->decoration_flags & SPV_REFLECT_DECORATION_BUILT_IN)
+                continue;
+            inputs.push_back({input->name ? input->name : "", input->location});
         }
     }
 
     spvReflectDestroyShaderModule(&reflect_shader);
 
+    if (renderer.shader_binaries) {
+        renderer.shader_binaries->store(
+            cache_key, binary.data(), binary.size() * 4,
+            descriptor_offsets, descriptor_size, bindings, local_size,
+            inputs
+        );
+    }
+
     VkShaderModuleCreateInfo shader_info {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
         .codeSize = binary.size() * 4,
@@ -2,6 +2,7 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "resources.h"
 #include "renderer.h"
@@ -15,4 +16,10 @@ struct reflected_shader_module {
     unique_shader_module module;
     std::unordered_map<std::string, uint32_t> descriptor_offsets;
     unsigned descriptor_size;
+    // all descriptors, including the uniform block
+    std::vector<reflected_binding> bindings;
+    // workgroup size, 1 for other than compute shaders
+    uint32_t local_size[3] = {1, 1, 1};
+    // only of vertex shaders
+    std::vector<reflected_input> inputs;
 };
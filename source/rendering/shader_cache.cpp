@@ -0,0 +1,300 @@
+#include "shader_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const uint32_t cache_magic = 0x4353454d; // "MESC"
+static const uint32_t cache_version = 3;
+
+struct cache_header {
+    uint32_t magic, version;
+    uint32_t descriptor_size;
+    uint32_t offset_count;
+    uint32_t binding_count;
+    uint32_t input_count;
+    uint32_t local_size[3];
+    uint32_t code_size;
+};
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static size_t padded(size_t size) {
+    return (size + 3) & ~size_t(3);
+}
+
+shader_cache::shader_cache(fs::path directory, std::uintmax_t maximum_size) :
+    directory(directory), maximum_size(maximum_size), size(0)
+{
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    for (auto& entry : fs::directory_iterator(directory, error)) {
+        if (entry.is_regular_file(error))
+            size += entry.file_size(error);
+    }
+}
+
+uint64_t shader_cache::key(
+    std::string_view source, std::string_view file_name,
+    shaderc_shader_kind kind, std::string_view compiler_options
+) {
+    // the file name is part of the key because it ends up in the debug info
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = fnv1a(hash, &cache_version, sizeof(cache_version));
+    hash = fnv1a(hash, source.data(), source.size());
+    hash = fnv1a(hash, file_name.data(), file_name.size());
+    hash = fnv1a(hash, &kind, sizeof(kind));
+    hash = fnv1a(hash, compiler_options.data(), compiler_options.size());
+    return hash;
+}
+
+fs::path shader_cache::path(uint64_t key) const {
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".spv";
+    return directory / name.str();
+}
+
+std::optional<cached_shader> shader_cache::load(uint64_t key) {
+    auto file_path = path(key);
+    std::error_code error;
+    if (!fs::exists(file_path, error)) {
+        misses++;
+        return std::nullopt;
+    }
+
+    cached_shader shader;
+    try {
+        shader.file = mapped_file(file_path.string().c_str());
+    } catch (const std::runtime_error&) {
+        misses++;
+        return std::nullopt;
+    }
+
+    auto data = shader.file.data();
+    auto end = data + shader.file.size();
+    auto invalid = [&]() {
+        shader.file = {};
+        fs::remove(file_path, error);
+        misses++;
+        return std::nullopt;
+    };
+
+    cache_header header;
+    if (static_cast<size_t>(end - data) < sizeof(header))
+        return invalid();
+    memcpy(&header, data, sizeof(header));
+    data += sizeof(header);
+    if (header.magic != cache_magic || header.version != cache_version)
+        return invalid();
+
+    shader.descriptor_size = header.descriptor_size;
+    for (auto i = 0u; i < header.offset_count; i++) {
+        uint32_t offset[2]; // descriptor offset and name length
+        if (static_cast<size_t>(end - data) < sizeof(offset))
+            return invalid();
+        memcpy(offset, data, sizeof(offset));
+        data += sizeof(offset);
+        if (static_cast<size_t>(end - data) < padded(offset[1]))
+            return invalid();
+        shader.descriptor_offsets.insert({
+            std::string(reinterpret_cast<const char*>(data), offset[1]),
+            offset[0]
+        });
+        data += padded(offset[1]);
+    }
+
+    std::copy(
+        header.local_size, header.local_size + 3, shader.local_size
+    );
+    for (auto i = 0u; i < header.binding_count; i++) {
+        uint32_t binding[4]; // set, binding, type and name length
+        if (static_cast<size_t>(end - data) < sizeof(binding))
+            return invalid();
+        memcpy(binding, data, sizeof(binding));
+        data += sizeof(binding);
+        if (static_cast<size_t>(end - data) < padded(binding[3]))
+            return invalid();
+        shader.bindings.push_back({
+            std::string(reinterpret_cast<const char*>(data), binding[3]),
+            binding[0], binding[1], binding[2]
+        });
+        data += padded(binding[3]);
+    }
+    for (auto i = 0u; i < header.input_count; i++) {
+        uint32_t input[2]; // location and name length
+        if (static_cast<size_t>(end - data) < sizeof(input))
+            return invalid();
+        memcpy(input, data, sizeof(input));
+        data += sizeof(input);
+        if (static_cast<size_t>(end - data) < padded(input[1]))
+            return invalid();
+        shader.inputs.push_back({
+            std::string(reinterpret_cast<const char*>(data), input[1]),
+            input[0]
+        });
+        data += padded(input[1]);
+    }
+
+    if (
+        static_cast<size_t>(end - data) != header.code_size ||
+        header.code_size % 4 != 0
+    )
+        return invalid();
+    shader.code = reinterpret_cast<const uint32_t*>(data);
+    shader.code_size = header.code_size;
+
+    // modification time is used as access time for eviction
+    fs::last_write_time(file_path, fs::file_time_type::clock::now(), error);
+
+    hits++;
+    return shader;
+}
+
+void shader_cache::store(
+    uint64_t key, const uint32_t* code, size_t code_size,
+    const std::unordered_map<std::string, uint32_t>& descriptor_offsets,
+    unsigned descriptor_size, const std::vector<reflected_binding>& bindings,
+    const uint32_t local_size[3], const std::vector<reflected_input>& inputs
+) {
+    cache_header header{
+        .magic = cache_magic,
+        .version = cache_version,
+        .descriptor_size = descriptor_size,
+        .offset_count = static_cast<uint32_t>(descriptor_offsets.size()),
+        .binding_count = static_cast<uint32_t>(bindings.size()),
+        .input_count = static_cast<uint32_t>(inputs.size()),
+        .local_size = {local_size[0], local_size[1], local_size[2]},
+        .code_size = static_cast<uint32_t>(code_size),
+    };
+
+    std::vector<char> content(
+        reinterpret_cast<const char*>(&header),
+        reinterpret_cast<const char*>(&header) + sizeof(header)
+    );
+    for (const auto& offset : descriptor_offsets) {
+        uint32_t fields[2] = {
+            offset.second, static_cast<uint32_t>(offset.first.size())
+        };
+        content.insert(
+            content.end(), reinterpret_cast<const char*>(fields),
+            reinterpret_cast<const char*>(fields) + sizeof(fields)
+        );
+        content.insert(
+            content.end(), offset.first.begin(), offset.first.end()
+        );
+        content.resize(padded(content.size()));
+    }
+    for (const auto& binding : bindings) {
+        uint32_t fields[4] = {
+            binding.set, binding.binding, binding.type,
+            static_cast<uint32_t>(binding.name.size())
+        };
+        content.insert(
+            content.end(), reinterpret_cast<const char*>(fields),
+            reinterpret_cast<const char*>(fields) + sizeof(fields)
+        );
+        content.insert(
+            content.end(), binding.name.begin(), binding.name.end()
+        );
+        content.resize(padded(content.size()));
+    }
+    for (const auto& input : inputs) {
+        uint32_t fields[2] = {
+            input.location, static_cast<uint32_t>(input.name.size())
+        };
+        content.insert(
+            content.end(), reinterpret_cast<const char*>(fields),
+            reinterpret_cast<const char*>(fields) + sizeof(fields)
+        );
+        content.insert(content.end(), input.name.begin(), input.name.end());
+        content.resize(padded(content.size()));
+    }
+    content.insert(
+        content.end(), reinterpret_cast<const char*>(code),
+        reinterpret_cast<const char*>(code) + code_size
+    );
+
+    // write to a temporary file first so readers never see partial entries
+    auto file_path = path(key);
+    std::stringstream temporary_name;
+    temporary_name << std::this_thread::get_id();
+    auto temporary_path = file_path;
+    temporary_path += "." + temporary_name.str() + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary);
+        if (!file.write(content.data(), content.size()))
+            return;
+    }
+
+    // a replaced entry no longer counts, the lock keeps stores of the same
+    // key from both subtracting it
+    std::lock_guard lock(mutex);
+    std::error_code error;
+    auto replaced_size = fs::file_size(file_path, error);
+    if (error)
+        replaced_size = 0;
+    fs::rename(temporary_path, file_path, error);
+    if (error) {
+        fs::remove(temporary_path, error);
+        return;
+    }
+
+    size += content.size();
+    size -= std::min(size, replaced_size);
+    if (size > maximum_size)
+        evict();
+}
+
+void shader_cache::evict() {
+    struct entry {
+        fs::file_time_type time;
+        std::uintmax_t size;
+        fs::path path;
+    };
+    std::vector<entry> entries;
+
+    std::error_code error;
+    size = 0;
+    for (auto& file : fs::directory_iterator(directory, error)) {
+        if (!file.is_regular_file(error))
+            continue;
+        entries.push_back({
+            file.last_write_time(error), file.file_size(error), file.path()
+        });
+        size += entries.back().size;
+    }
+
+    std::sort(
+        entries.begin(), entries.end(),
+        [](const entry& a, const entry& b) { return a.time < b.time; }
+    );
+
+    for (const auto& entry : entries) {
+        if (size <= maximum_size)
+            break;
+        if (fs::remove(entry.path, error)) {
+            size -= entry.size;
+            evictions++;
+        }
+    }
+}
+
+void shader_cache::print_statistics(std::ostream& stream) const {
+    stream <<
+        "shader cache hits: " << hits << ", misses: " << misses <<
+        ", evictions: " << evictions << std::endl;
+}
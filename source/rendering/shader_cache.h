@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <shaderc/shaderc.hpp>
+
+#include "../data/mapped_file.h"
+
+// descriptor of a shader, type is a VkDescriptorType
+struct reflected_binding {
+    std::string name;
+    uint32_t set, binding, type;
+};
+
+// input of a vertex shader, built-ins are left out
+struct reflected_input {
+    std::string name;
+    uint32_t location;
+};
+
+// compiled SPIR-V with its reflection data, the code points into the mapping
+struct cached_shader {
+    mapped_file file;
+    const uint32_t* code;
+    size_t code_size; // in bytes
+    std::unordered_map<std::string, uint32_t> descriptor_offsets;
+    unsigned descriptor_size;
+    std::vector<reflected_binding> bindings;
+    // workgroup size of compute shaders
+    uint32_t local_size[3];
+    std::vector<reflected_input> inputs;
+};
+
+// content-addressed on-disk cache of compiled shaders
+// entries are evicted least recently used first when maximum_size is exceeded
+struct shader_cache {
+    shader_cache(std::filesystem::path directory, std::uintmax_t maximum_size);
+
+    static uint64_t key(
+        std::string_view source, std::string_view file_name,
+        shaderc_shader_kind kind, std::string_view compiler_options
+    );
+
+    std::optional<cached_shader> load(uint64_t key);
+    void store(
+        uint64_t key, const uint32_t* code, size_t code_size,
+        const std::unordered_map<std::string, uint32_t>& descriptor_offsets,
+        unsigned descriptor_size,
+        const std::vector<reflected_binding>& bindings,
+        const uint32_t local_size[3],
+        const std::vector<reflected_input>& inputs
+    );
+
+    void print_statistics(std::ostream& stream) const;
+
+    std::atomic<unsigned> hits{0}, misses{0}, evictions{0};
+
+private:
+    std::filesystem::path path(uint64_t key) const;
+    void evict();
+
+    std::filesystem::path directory;
+    std::uintmax_t maximum_size;
+
+    std::mutex mutex;
+    std::uintmax_t size;
+};
@@ -0,0 +1,196 @@
+#include "upload.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+upload_queue::upload_queue(
+    const renderer& renderer, VkQueue queue, VkDeviceSize ring_size,
+    VkDeviceSize batch_size
+) :
+    queue(queue),
+    graphics(renderer.transfer_queue_family == renderer.graphics_queue_family),
+    ring_size(ring_size), batch_size(batch_size)
+{
+    VkCommandPoolCreateInfo command_pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags =
+            VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = renderer.transfer_queue_family,
+    };
+    check(vkCreateCommandPool(
+        *current_device, &command_pool_info, nullptr, out_ptr(command_pool)
+    ));
+
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = ring_size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    check(vkCreateBuffer(
+        *current_device, &buffer_info, nullptr, out_ptr(ring)
+    ));
+    ring_memory = allocate_buffer_memory(
+        *renderer.allocator, ring.get(),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+    mapped = static_cast<std::byte*>(ring_memory.get().mapped);
+}
+
+upload_queue::~upload_queue() {
+    for (auto& batch : in_flight) {
+        auto fence = batch.fence.get();
+        vkWaitForFences(*current_device, 1, &fence, VK_TRUE, -1ul);
+    }
+}
+
+uint64_t upload_queue::enqueue(
+    VkBuffer buffer, VkDeviceSize offset, std::vector<std::byte> data
+) {
+    if (data.empty())
+        return enqueued;
+    if (enqueued == ring_tail)
+        busy_since = std::chrono::steady_clock::now();
+    enqueued += data.size();
+    pending.push_back({buffer, offset, std::move(data), 0});
+    return enqueued;
+}
+
+void upload_queue::retire() {
+    while (
+        !in_flight.empty() &&
+        vkGetFenceStatus(*current_device, in_flight.front().fence.get()) ==
+        VK_SUCCESS
+    ) {
+        auto& batch = in_flight.front();
+        ring_tail = batch.end;
+        auto fence = batch.fence.get();
+        check(vkResetFences(*current_device, 1, &fence));
+        free_batches.push_back(std::move(batch));
+        in_flight.pop_front();
+        if (ring_tail == enqueued)
+            busy_time += std::chrono::steady_clock::now() - busy_since;
+    }
+}
+
+void upload_queue::submit() {
+    retire();
+
+    // pieces of copies end where the ring wraps around
+    struct piece {
+        VkBuffer buffer;
+        VkBufferCopy region;
+    };
+    std::vector<piece> pieces;
+    for (auto budget = batch_size; !pending.empty() && budget > 0;) {
+        auto& copy = pending.front();
+        auto position = ring_head % ring_size;
+        auto size = std::min({
+            copy.data.size() - copy.staged, budget,
+            ring_size - (ring_head - ring_tail), ring_size - position,
+        });
+        if (size == 0)
+            break;
+        memcpy(mapped + position, copy.data.data() + copy.staged, size);
+        pieces.push_back({
+            copy.buffer, {position, copy.offset + copy.staged, size}
+        });
+        ring_head += size;
+        budget -= size;
+        copy.staged += size;
+        if (copy.staged == copy.data.size())
+            pending.pop_front();
+    }
+    if (pieces.empty())
+        return;
+
+    if (free_batches.empty()) {
+        batch batch;
+        VkFenceCreateInfo fence_info = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        };
+        check(vkCreateFence(
+            *current_device, &fence_info, nullptr, out_ptr(batch.fence)
+        ));
+        VkCommandBufferAllocateInfo command_buffer_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = command_pool.get(),
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        check(vkAllocateCommandBuffers(
+            *current_device, &command_buffer_info, &batch.command_buffer
+        ));
+        free_batches.push_back(std::move(batch));
+    }
+    auto batch = std::move(free_batches.back());
+    free_batches.pop_back();
+    batch.end = ring_head;
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    check(vkBeginCommandBuffer(batch.command_buffer, &begin_info));
+    // one command per run of pieces into the same buffer
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        regions.push_back(pieces[i].region);
+        if (
+            i + 1 < pieces.size() &&
+            pieces[i + 1].buffer == pieces[i].buffer
+        )
+            continue;
+        vkCmdCopyBuffer(
+            batch.command_buffer, ring.get(), pieces[i].buffer,
+            static_cast<uint32_t>(regions.size()), regions.data()
+        );
+        regions.clear();
+    }
+    if (graphics) {
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            batch.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier,
+            0, nullptr, 0, nullptr
+        );
+    }
+    check(vkEndCommandBuffer(batch.command_buffer));
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch.command_buffer,
+    };
+    check(vkQueueSubmit(queue, 1, &submit_info, batch.fence.get()));
+    in_flight.push_back(std::move(batch));
+    batch_count++;
+}
+
+bool upload_queue::finished(uint64_t ticket) {
+    retire();
+    return ring_tail >= ticket;
+}
+
+void upload_queue::wait(uint64_t ticket) {
+    while (!finished(ticket)) {
+        submit();
+        auto fence = in_flight.front().fence.get();
+        check(vkWaitForFences(*current_device, 1, &fence, VK_TRUE, -1ul));
+    }
+}
+
+void upload_queue::print_statistics(std::ostream& stream) const {
+    auto seconds = std::chrono::duration<double>(busy_time).count();
+    stream <<
+        "uploaded " << ring_tail / 1024 << " KiB in " << batch_count <<
+        " batches, " << (seconds > 0.0 ? ring_tail / seconds / 1e6 : 0.0) <<
+        " MB/s" << std::endl;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "resources.h"
+#include "renderer.h"
+#include "memory.h"
+
+// copies host data into buffers on the transfer queue through a ring of
+// persistently mapped staging memory, the copies staged by one submit are
+// recorded into one command buffer, whose fence frees their part of the
+// ring again
+// copies run in the order they were enqueued, tickets are the number of
+// bytes enqueued up to the end of a copy, so a ticket finished once all
+// copies before it did
+// buffers written on another queue family than graphics have to be shared
+// with it, they can be used by later submits once their ticket finished
+struct upload_queue {
+    // the ring is allocated up front, a submit stages batch_size bytes at
+    // most to bound the time it takes
+    upload_queue(
+        const renderer& renderer, VkQueue queue,
+        VkDeviceSize ring_size = 32 * 1024 * 1024,
+        VkDeviceSize batch_size = 8 * 1024 * 1024
+    );
+    upload_queue(const upload_queue&) = delete;
+    upload_queue& operator= (const upload_queue&) = delete;
+    // waits for the copies in flight, the queued ones are dropped
+    ~upload_queue();
+
+    // queues a copy of data to buffer at offset, the buffer has to stay
+    // alive until the returned ticket finished
+    uint64_t enqueue(
+        VkBuffer buffer, VkDeviceSize offset, std::vector<std::byte> data
+    );
+    // stages as much of the queued copies as fits into the free part of
+    // the ring and submits them, never waits for the device
+    void submit();
+    // true once the copies up to ticket finished
+    bool finished(uint64_t ticket);
+    // submits and waits until the copies up to ticket finished
+    void wait(uint64_t ticket);
+
+    // bytes copied over the time copies were queued or in flight
+    void print_statistics(std::ostream& stream) const;
+
+private:
+    struct pending_copy {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        std::vector<std::byte> data;
+        // bytes of data already staged
+        VkDeviceSize staged;
+    };
+    struct batch {
+        unique_fence fence;
+        VkCommandBuffer command_buffer;
+        // ring position after the copies of the batch
+        uint64_t end;
+    };
+
+    // frees the ring space of finished batches
+    void retire();
+
+    VkQueue queue;
+    // other queues hand their copies over through the fences
+    bool graphics;
+    unique_command_pool command_pool;
+    unique_buffer ring;
+    unique_allocation ring_memory;
+    std::byte* mapped;
+    VkDeviceSize ring_size, batch_size;
+    // bytes staged into and freed from the ring since creation, the ring
+    // holds the ones in between, the tail is the last finished ticket
+    uint64_t ring_head = 0, ring_tail = 0, enqueued = 0;
+    std::deque<pending_copy> pending;
+    // oldest first, finished batches are reused
+    std::deque<batch> in_flight;
+    std::vector<batch> free_batches;
+
+    // while there are unfinished copies
+    std::chrono::steady_clock::time_point busy_since;
+    std::chrono::steady_clock::duration busy_time{};
+    unsigned batch_count = 0;
+};
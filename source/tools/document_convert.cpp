@@ -0,0 +1,32 @@
+// converts documents between JSON and the binary format, the direction is
+// picked from the input file
+
+#include <iostream>
+#include <stdexcept>
+
+#include "../data/document.h"
+#include "../data/binary_document.h"
+#include "../data/mapped_file.h"
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " input output" << std::endl;
+        return 1;
+    }
+
+    try {
+        bool binary = is_binary_document(mapped_file(argv[1]));
+        auto document = from_file(argv[1]);
+        if (binary)
+            to_json_file(document, argv[2]);
+        else
+            to_binary_file(document, argv[2]);
+        std::cout <<
+            "converted " << document.view_actions.size() << " actions to " <<
+            (binary ? "JSON" : "binary") << std::endl;
+    } catch (const std::exception& exception) {
+        std::cerr << exception.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}